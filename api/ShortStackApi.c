@@ -39,6 +39,56 @@
 #define EXPMSG  (PSICB->ExplicitMessage)
 #define NVMSG   (PSICB->NvMessage)
 
+/*
+ * LON_EVENT_BATCHES enables the LonEventHandlerEx() API. The API requires the
+ * driver's optional LdvGetMsgs(), LdvReleaseMsgs() and LdvGetTimestamp() APIs,
+ * so define this as non-zero in your project settings or makefile only when
+ * your driver provides these.
+ */
+#ifndef LON_EVENT_BATCHES
+#   define LON_EVENT_BATCHES   0
+#endif  /* LON_EVENT_BATCHES */
+
+#if LON_EVENT_BATCHES
+/*
+ * LON_EVENT_BATCH_SIZE is the maximum number of messages LonEventHandlerEx()
+ * retrieves from the driver in one operation. The batch is held on the stack.
+ */
+#ifndef LON_EVENT_BATCH_SIZE
+#   define LON_EVENT_BATCH_SIZE    8
+#endif  /* LON_EVENT_BATCH_SIZE */
+#endif  /* LON_EVENT_BATCHES */
+
+/*
+ * LON_TX_CONGESTION enables the LonTxCongestion() callback. The callback
+ * requires the driver's optional LdvGetCongestion() API, so define this as
+ * non-zero in your project settings or makefile only when your driver
+ * implements that API.
+ */
+#ifndef LON_TX_CONGESTION
+#   define LON_TX_CONGESTION   0
+#endif  /* LON_TX_CONGESTION */
+
+/*
+ * LON_DRIVER_STATISTICS enables the LonGetDriverStatistics() API. The API
+ * requires the driver's optional LdvGetStatistics() API and LdvStatistics
+ * type, so define this as non-zero in your project settings or makefile
+ * only when your driver implements these.
+ */
+#ifndef LON_DRIVER_STATISTICS
+#   define LON_DRIVER_STATISTICS   0
+#endif  /* LON_DRIVER_STATISTICS */
+
+/*
+ * LON_DRIVER_EVENTS enables the LonWaitForEvent() and LonGetEventFd() APIs.
+ * These require the driver's optional LdvWaitForEvent() and LdvGetEventFd()
+ * APIs, so define this as non-zero in your project settings or makefile
+ * only when your driver implements these.
+ */
+#ifndef LON_DRIVER_EVENTS
+#   define LON_DRIVER_EVENTS   0
+#endif  /* LON_DRIVER_EVENTS */
+
 /*
  * Following is the reset message buffer. Any uplink reset message will be copied
  * into this buffer, which serves as a source for validation of various indices
@@ -58,6 +108,14 @@ static volatile LonResetNotification lastResetNotification;
  */
 static unsigned resetCounter;
 
+#if LON_TX_CONGESTION
+/*
+ * The downlink congestion state last reported to the application with the
+ * LonTxCongestion() callback.
+ */
+static LonBool txCongested;
+#endif  /* LON_TX_CONGESTION */
+
 /*
  * A global array to hold the message response data.
  * Make no assumptions about the previous contents while using it.
@@ -223,6 +281,9 @@ const LonApiError LonInit(LdvCtrl* ctrl)
     /* Clear the information obtained from the last reset notification message */
     memset((void*) &lastResetNotification, 0, sizeof(LonResetNotification));
     CurrentNmNdStatus = NO_NM_ND_PENDING;
+#if LON_TX_CONGESTION
+    txCongested = FALSE;
+#endif  /* LON_TX_CONGESTION */
 
     if (result == LonApiNoError) {
     	result = LonReinit();
@@ -274,581 +335,624 @@ const LonApiError LonExit(void)
 
 
 /*
- * Function: LonEventHandler
- * Periodic service to the ShortStack LonTalk Compact API.
- *
- * Remarks:
- * This function must be called periodically by the application.  This
- * function processes any messages that have been received from the Micro Server.
- * The application can call this function as part of the idle loop, or from a
- * dedicated timer-based thread or interrupt service routine. All API callback
- * functions occur within this function's context. Note that the application is
- * responsible for correct context management and thread synchronization, as
- * (and if) required by the hosting platform.
- *
- * This function must be called at least once every 10 ms.  Use the following
- * formula to determine the minimum call rate:
- *  rate = MaxPacketRate / (InputBufferCount - 1)
- * where MaxPacketRate is the maximum number of packets per second arriving for
- * the device and InputBufferCount is the number of input buffers defined for
- * the application.
+ * ProcessUplinkMessage() dispatches one message received from the Micro
+ * Server. The function returns TRUE if the Micro Server must be
+ * re-initialized once the message buffer has been released.
  */
-void LonEventHandler(void)
+static LonBool ProcessUplinkMessage(LonSmipMsg* pSmipMsg)
 {
-    LonSmipMsg* pSmipMsg = NULL;
     LonBool requestReinit = FALSE;
-
-    if (LdvGetMsg(ldv_handle, &pSmipMsg) == LonApiNoError) {
-        /* A message has been retrieved from driver's receive buffer    */
-        LonCorrelator correlator = {0};
-
-        /* Make correlation structure    */
-        LON_SET_ATTRIBUTE(correlator, LON_CORRELATOR_PRIORITY, LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_PRIORITY));
-        LON_SET_ATTRIBUTE(correlator, LON_CORRELATOR_TAG, LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_TAG));
-        LON_SET_ATTRIBUTE(correlator, LON_CORRELATOR_SERVICE, LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_SERVICE));
-
-        switch (pSmipMsg->Header.Command) {
-        case ((LonByte) LonNiComm | (LonByte) LonNiIncoming): {
-            /* Is an incoming message    */
-            LonBool bFailure = FALSE;
-
-            if (LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_MSGTYPE) == LonMessageNv) {
-                /* Process NV messages */
-                if (LON_GET_ATTRIBUTE(NVMSG, LON_NVMSG_NVPOLL)) {
-                    /* Process NV poll message */
-                    bFailure = (SendNvPollResponse(pSmipMsg) != LonApiNoError);
-                } else {
-                    if (VerifyNvIndex(NVMSG.Index) == LonApiNoError) {
-                        if (WriteNvLocal(NVMSG.Index, NVMSG.NvData, NVMSG.Length) == LonApiNoError) {
-                            /* Process NV update message */
+    LonCorrelator correlator = {0};
+
+    /* Make correlation structure    */
+    LON_SET_ATTRIBUTE(correlator, LON_CORRELATOR_PRIORITY, LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_PRIORITY));
+    LON_SET_ATTRIBUTE(correlator, LON_CORRELATOR_TAG, LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_TAG));
+    LON_SET_ATTRIBUTE(correlator, LON_CORRELATOR_SERVICE, LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_SERVICE));
+
+    switch (pSmipMsg->Header.Command) {
+    case ((LonByte) LonNiComm | (LonByte) LonNiIncoming): {
+        /* Is an incoming message    */
+        LonBool bFailure = FALSE;
+
+        if (LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_MSGTYPE) == LonMessageNv) {
+            /* Process NV messages */
+            if (LON_GET_ATTRIBUTE(NVMSG, LON_NVMSG_NVPOLL)) {
+                /* Process NV poll message */
+                bFailure = (SendNvPollResponse(pSmipMsg) != LonApiNoError);
+            } else {
+                if (VerifyNvIndex(NVMSG.Index) == LonApiNoError) {
+                    if (WriteNvLocal(NVMSG.Index, NVMSG.NvData, NVMSG.Length) == LonApiNoError) {
+                        /* Process NV update message */
 #if LON_EXPLICIT_ADDRESSING
-                            LonNvUpdateOccurred(NVMSG.Index, &(EXPMSG.Address.Receive));
+                        LonNvUpdateOccurred(NVMSG.Index, &(EXPMSG.Address.Receive));
 #else
-                            LonNvUpdateOccurred(NVMSG.Index, NULL);
+                        LonNvUpdateOccurred(NVMSG.Index, NULL);
 #endif /* LON_EXPLICIT_ADDRESSING */
-                        } else {
-                            bFailure = TRUE;
-                        }
                     } else {
                         bFailure = TRUE;
                     }
+                } else {
+                    bFailure = TRUE;
                 }
-            } else {
-                /* Process explicit messages */
-                switch (EXPMSG.Code) {
-                case LonNmSetNodeMode:
-
-                    /* Process Set Node Mode network management message    */
-                    switch(EXPMSG.Data.NodeMode.Mode) {
-                    case LonApplicationOffLine:
-                        LonOffline();
-                        SendLocal(LonNiOffLine, NULL, 0);
-                        break;
-
-                    case LonApplicationOnLine:
-                        LonOnline();
-                        SendLocal(LonNiOnLine, NULL, 0);
-                        break;
+            }
+        } else {
+            /* Process explicit messages */
+            switch (EXPMSG.Code) {
+            case LonNmSetNodeMode:
+
+                /* Process Set Node Mode network management message    */
+                switch(EXPMSG.Data.NodeMode.Mode) {
+                case LonApplicationOffLine:
+                    LonOffline();
+                    SendLocal(LonNiOffLine, NULL, 0);
+                    break;
 
-                    default:
-                        bFailure = TRUE;
-                        break;
-                    }
+                case LonApplicationOnLine:
+                    LonOnline();
+                    SendLocal(LonNiOnLine, NULL, 0);
+                    break;
 
+                default:
+                    bFailure = TRUE;
                     break;
+                }
+
+                break;
 
-                case LonNmNvFetch:
+            case LonNmNvFetch:
 
-                    /* Process Nv Fetch network management message        */
-                    if (EXPMSG.Data.NvFetch.Index == 0xFF)
-                        /* This is the escape index which means that the true index is
-                           255 or greater and is in the following two bytes.
-                           ShortStack doesn't support NV's with index greater than 254. */
-                    {
+                /* Process Nv Fetch network management message        */
+                if (EXPMSG.Data.NvFetch.Index == 0xFF)
+                    /* This is the escape index which means that the true index is
+                       255 or greater and is in the following two bytes.
+                       ShortStack doesn't support NV's with index greater than 254. */
+                {
+                    bFailure = TRUE;
+                } else {
+                    const unsigned nvIndex = EXPMSG.Data.NvFetch.Index;
+                    /* Send NV response to the network.           */
+                    const LonNvDescription* const nvDescription = LonGetNvDescription(nvIndex);
+                    unsigned nvLength = LonGetTruncatedNvLength(nvIndex, nvDescription);
+
+                    if (VerifyNvIndex(nvIndex) != LonApiNoError) {
                         bFailure = TRUE;
                     } else {
-                        const unsigned nvIndex = EXPMSG.Data.NvFetch.Index;
-                        /* Send NV response to the network.           */
-                        const LonNvDescription* const nvDescription = LonGetNvDescription(nvIndex);
-                        unsigned nvLength = LonGetTruncatedNvLength(nvIndex, nvDescription);
-
-                        if (VerifyNvIndex(nvIndex) != LonApiNoError) {
-                            bFailure = TRUE;
-                        } else {
-                            void* transmitData = (void*)nvDescription->pData;
-                            unsigned transmitLength = nvLength;
-                            LonApiError error = LonApiNoError;
+                        void* transmitData = (void*)nvDescription->pData;
+                        unsigned transmitLength = nvLength;
+                        LonApiError error = LonApiNoError;
 
-                            ResponseData[0] = (LonByte) nvIndex;
+                        ResponseData[0] = (LonByte) nvIndex;
 
 #ifdef LON_NVDESC_ENCRYPT_MASK
 
-                            if (nvDescription->Attributes & LON_NVDESC_ENCRYPT_MASK) {
-                                error = LonEncrypt(nvIndex,
-                                            nvLength, (void const*)nvDescription->pData,
-                                            &transmitLength, &transmitData
-                                        );
-                            }
+                        if (nvDescription->Attributes & LON_NVDESC_ENCRYPT_MASK) {
+                            error = LonEncrypt(nvIndex,
+                                        nvLength, (void const*)nvDescription->pData,
+                                        &transmitLength, &transmitData
+                                    );
+                        }
 
 #endif  /* LON_NVDESC_ENCRYPT_MASK */
 
-                            if ((error != LonApiNoError)
-                            || (transmitLength > sizeof(ResponseData) - 1)) {
-                                bFailure = TRUE;
-                            } else {
-                                memcpy(&ResponseData[1], transmitData, transmitLength);
-                                error = LonSendResponse(
-                                            correlator,
-                                            LON_NM_SUCCESS(LonNmNvFetch),
-                                            ResponseData,
-                                            transmitLength + 1
-                                        );
-                                bFailure = error != LonApiNoError;
-                            }
+                        if ((error != LonApiNoError)
+                        || (transmitLength > sizeof(ResponseData) - 1)) {
+                            bFailure = TRUE;
+                        } else {
+                            memcpy(&ResponseData[1], transmitData, transmitLength);
+                            error = LonSendResponse(
+                                        correlator,
+                                        LON_NM_SUCCESS(LonNmNvFetch),
+                                        ResponseData,
+                                        transmitLength + 1
+                                    );
+                            bFailure = error != LonApiNoError;
                         }
                     }
+                }
 
-                    break;
+                break;
 
 #if     LON_DMF_ENABLED
 
-                case LonNmReadMemory:
-
-                    /* Process Read Memory network management message        */
-                    bFailure = EXPMSG.Data.ReadMemory.Mode != LonAbsoluteMemory
-                             || LonMemoryRead(
-                                    LON_GET_UNSIGNED_WORD(EXPMSG.Data.ReadMemory.Address),
-                                    EXPMSG.Data.ReadMemory.Count,
-                                    &ResponseData[0]
-                                )
-                             || LonSendResponse(
-                                    correlator,
-                                    LON_NM_SUCCESS(LonNmReadMemory),
-                                    &ResponseData[0],
-                                    EXPMSG.Data.ReadMemory.Count
-                                );
-                    break;
-
-                case LonNmWriteMemory:
+            case LonNmReadMemory:
+
+                /* Process Read Memory network management message        */
+                bFailure = EXPMSG.Data.ReadMemory.Mode != LonAbsoluteMemory
+                         || LonMemoryRead(
+                                LON_GET_UNSIGNED_WORD(EXPMSG.Data.ReadMemory.Address),
+                                EXPMSG.Data.ReadMemory.Count,
+                                &ResponseData[0]
+                            )
+                         || LonSendResponse(
+                                correlator,
+                                LON_NM_SUCCESS(LonNmReadMemory),
+                                &ResponseData[0],
+                                EXPMSG.Data.ReadMemory.Count
+                            );
+                break;
 
-                    /* Process Write Memory network management message        */
-                    bFailure = EXPMSG.Data.WriteMemory.Mode != LonAbsoluteMemory
-                            || LonMemoryWrite(
-                                   LON_GET_UNSIGNED_WORD(EXPMSG.Data.WriteMemory.Address),
-                                   EXPMSG.Data.WriteMemory.Count,
-                                   ((LonByte*) &EXPMSG.Data.WriteMemory.Form) + 1
-                               )
-                            || LonSendResponse(
-                                   correlator,
-                                   LON_NM_SUCCESS(LonNmWriteMemory),
-                                   NULL,
-                                   0
-                               );
-                    break;
+            case LonNmWriteMemory:
+
+                /* Process Write Memory network management message        */
+                bFailure = EXPMSG.Data.WriteMemory.Mode != LonAbsoluteMemory
+                        || LonMemoryWrite(
+                               LON_GET_UNSIGNED_WORD(EXPMSG.Data.WriteMemory.Address),
+                               EXPMSG.Data.WriteMemory.Count,
+                               ((LonByte*) &EXPMSG.Data.WriteMemory.Form) + 1
+                           )
+                        || LonSendResponse(
+                               correlator,
+                               LON_NM_SUCCESS(LonNmWriteMemory),
+                               NULL,
+                               0
+                           );
+                break;
 #endif      /* LON_DMF_ENABLED */
 
-                case LonNmQuerySiData: {
-                    unsigned offset = LON_GET_UNSIGNED_WORD(EXPMSG.Data.QuerySiDataRequest.Offset);
-                    unsigned siDataLength = 0;
-                    const LonByte* pSiData = LonGetSiData(&siDataLength);
+            case LonNmQuerySiData: {
+                unsigned offset = LON_GET_UNSIGNED_WORD(EXPMSG.Data.QuerySiDataRequest.Offset);
+                unsigned siDataLength = 0;
+                const LonByte* pSiData = LonGetSiData(&siDataLength);
 
-                    if ((EXPMSG.Data.QuerySiDataRequest.Count > LON_MAX_MSG_DATA)
-                    || (offset + EXPMSG.Data.QuerySiDataRequest.Count > siDataLength)
-                    || (EXPMSG.Data.QuerySiDataRequest.Count > sizeof(ResponseData))) {
-                        bFailure = TRUE;
-                    } else {
-                        memcpy(&ResponseData[0], pSiData + offset, EXPMSG.Data.QuerySiDataRequest.Count);
-                        bFailure = LonSendResponse(
-                                       correlator,
-                                       LON_NM_SUCCESS(LonNmQuerySiData),
-                                       &ResponseData[0],
-                                       EXPMSG.Data.QuerySiDataRequest.Count
-                                   ) != LonApiNoError;
-                    }
+                if ((EXPMSG.Data.QuerySiDataRequest.Count > LON_MAX_MSG_DATA)
+                || (offset + EXPMSG.Data.QuerySiDataRequest.Count > siDataLength)
+                || (EXPMSG.Data.QuerySiDataRequest.Count > sizeof(ResponseData))) {
+                    bFailure = TRUE;
+                } else {
+                    memcpy(&ResponseData[0], pSiData + offset, EXPMSG.Data.QuerySiDataRequest.Count);
+                    bFailure = LonSendResponse(
+                                   correlator,
+                                   LON_NM_SUCCESS(LonNmQuerySiData),
+                                   &ResponseData[0],
+                                   EXPMSG.Data.QuerySiDataRequest.Count
+                               ) != LonApiNoError;
                 }
-                break;
+            }
+            break;
 
-                case LonNmWink:
-                    /* Process wink network management message        */
-                    LonWink();
-                    break;
+            case LonNmWink:
+                /* Process wink network management message        */
+                LonWink();
+                break;
 
-                default:
-                    /* Process explicit application messages here.   */
+            default:
+                /* Process explicit application messages here.   */
 #if    LON_APPLICATION_MESSAGES
 #if    LON_EXPLICIT_ADDRESSING
-                    LonMsgArrived(
-                        &(EXPMSG.Address.Receive), correlator,
-                        (LonBool) LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_PRIORITY),
-                        (LonServiceType) LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_SERVICE),
-                        (LonBool) LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_AUTHENTICATED),
-                        (LonApplicationMessageCode) EXPMSG.Code,
-                        EXPMSG.Data.Data,
-                        (LonByte)(EXPMSG.Length - 1)
-                    );
+                LonMsgArrived(
+                    &(EXPMSG.Address.Receive), correlator,
+                    (LonBool) LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_PRIORITY),
+                    (LonServiceType) LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_SERVICE),
+                    (LonBool) LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_AUTHENTICATED),
+                    (LonApplicationMessageCode) EXPMSG.Code,
+                    EXPMSG.Data.Data,
+                    (LonByte)(EXPMSG.Length - 1)
+                );
 #else    /* ifndef(LON_EXPLICIT_ADDRESSING)    */
-                    LonMsgArrived(
-                        NULL,
-                        correlator,
-                        (LonBool) LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_PRIORITY),
-                        (LonServiceType) LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_SERVICE),
-                        (LonBool) LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_AUTHENTICATED),
-                        (LonApplicationMessageCode) EXPMSG.Code,
-                        EXPMSG.Data.Data,
-                        (LonByte)(EXPMSG.Length - 1)
-                    );
+                LonMsgArrived(
+                    NULL,
+                    correlator,
+                    (LonBool) LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_PRIORITY),
+                    (LonServiceType) LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_SERVICE),
+                    (LonBool) LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_AUTHENTICATED),
+                    (LonApplicationMessageCode) EXPMSG.Code,
+                    EXPMSG.Data.Data,
+                    (LonByte)(EXPMSG.Length - 1)
+                );
 #endif    /* LON_EXPLICIT_ADDRESSING            */
 #else     /* ifndef(LON_APPLICATION_MESSAGES)    */
-                    bFailure = TRUE;
+                bFailure = TRUE;
 #endif    /* LON_APPLICATION_MESSAGES            */
-                    break;
-                }
-            }
-
-            if (bFailure) {
-                /* Indicates that the receiving network management message   */
-                /* or explicit message is not supported by the ShortStack,   */
-                /* or that it failed to execute that message.                */
-                LonSendResponse(
-                    correlator,
-                    (LonByte)LON_NM_FAILURE(EXPMSG.Code),
-                    NULL,
-                    0
-                );
+                break;
             }
+        }
 
-            break;
+        if (bFailure) {
+            /* Indicates that the receiving network management message   */
+            /* or explicit message is not supported by the ShortStack,   */
+            /* or that it failed to execute that message.                */
+            LonSendResponse(
+                correlator,
+                (LonByte)LON_NM_FAILURE(EXPMSG.Code),
+                NULL,
+                0
+            );
         }
 
-        case ((LonByte) LonNiComm | (LonByte) LonNiResponse): {
-            if (LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_COMPLETIONCODE)) {
-                /* Process completion event generated by the ShortStack Micro Server */
-                if (LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_MSGTYPE) == LonMessageNv) {
-                    LonNvUpdateCompleted(
-                        NVMSG.Index,
-                        (LonBool)(LON_GET_ATTRIBUTE(NVMSG, LON_NVMSG_COMPLETIONCODE) == LonCompletionSuccess)
-                    );
-                } else {
+        break;
+    }
+
+    case ((LonByte) LonNiComm | (LonByte) LonNiResponse): {
+        if (LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_COMPLETIONCODE)) {
+            /* Process completion event generated by the ShortStack Micro Server */
+            if (LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_MSGTYPE) == LonMessageNv) {
+                LonNvUpdateCompleted(
+                    NVMSG.Index,
+                    (LonBool)(LON_GET_ATTRIBUTE(NVMSG, LON_NVMSG_COMPLETIONCODE) == LonCompletionSuccess)
+                );
+            } else {
 #if    LON_APPLICATION_MESSAGES
-                    LonMsgCompleted(
-                        LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_TAG),
-                        (LonBool)(LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_COMPLETIONCODE) == LonCompletionSuccess)
-                    );
+                LonMsgCompleted(
+                    LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_TAG),
+                    (LonBool)(LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_COMPLETIONCODE) == LonCompletionSuccess)
+                );
 #endif    /* LON_APPLICATION_MESSAGES */
-                }
-            } else {
-                /* Process response from the network. */
-                if (LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_MSGTYPE) == LonMessageNv) {
-                    /* NV poll response.  Handle same as NV update.
-                     * (An offline node will return an NV update with length 0 to
-                     * indicate this fact. If all NV updates are returned this way
-                     * then a failure completion event is received).
-                     */
+            }
+        } else {
+            /* Process response from the network. */
+            if (LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_MSGTYPE) == LonMessageNv) {
+                /* NV poll response.  Handle same as NV update.
+                 * (An offline node will return an NV update with length 0 to
+                 * indicate this fact. If all NV updates are returned this way
+                 * then a failure completion event is received).
+                 */
 
-                    if (VerifyNvIndex(NVMSG.Index) == LonApiNoError) {
-                        if (WriteNvLocal(NVMSG.Index, NVMSG.NvData, NVMSG.Length) == LonApiNoError)
+                if (VerifyNvIndex(NVMSG.Index) == LonApiNoError) {
+                    if (WriteNvLocal(NVMSG.Index, NVMSG.NvData, NVMSG.Length) == LonApiNoError)
 #if LON_EXPLICIT_ADDRESSING
-                            LonNvUpdateOccurred(NVMSG.Index, &(EXPMSG.Address.Receive));
+                        LonNvUpdateOccurred(NVMSG.Index, &(EXPMSG.Address.Receive));
 #else
-                            LonNvUpdateOccurred(NVMSG.Index, NULL);
+                        LonNvUpdateOccurred(NVMSG.Index, NULL);
 #endif
-                    }
-                } else {
-                    /* Message response. This could be a response to a local NM/ND
-                     * message or an explicit message. If the message tag of the
-                     * response is NM_ND_TAG, it is the response to the local
-                     * NM/ND message.
-                     */
-                    if (LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_TAG) == NM_ND_TAG) {
+                }
+            } else {
+                /* Message response. This could be a response to a local NM/ND
+                 * message or an explicit message. If the message tag of the
+                 * response is NM_ND_TAG, it is the response to the local
+                 * NM/ND message.
+                 */
+                if (LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_TAG) == NM_ND_TAG) {
 #if LON_NM_QUERY_FUNCTIONS
 
-                        if (CurrentNmNdStatus == NM_PENDING) {
-                            /* Process the response to a local NM/ND message    */
-                            switch ((EXPMSG.Code & LON_NM_OPCODE_MASK) | LON_NM_OPCODE_BASE) {
-                            case LonNmQueryDomain:
-                                /* Query Domain response    */
-                                LonDomainConfigReceived(
-                                    (LonDomain*) &(EXPMSG.Data),
-                                    (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNmQueryDomain))
-                                );
-                                break;
-
-                            case LonNmQueryNvConfig:
-
-                                /* Query Nv Config response    */
-                                if (EXPMSG.Length == sizeof(EXPMSG.Code) + sizeof(LonNvConfigNonEat)) {
-                                    LonNvConfig nvConfig;
-                                    LonNvConfigNonEat* nvConfigNonEat = (LonNvConfigNonEat*) & (EXPMSG.Data);
+                    if (CurrentNmNdStatus == NM_PENDING) {
+                        /* Process the response to a local NM/ND message    */
+                        switch ((EXPMSG.Code & LON_NM_OPCODE_MASK) | LON_NM_OPCODE_BASE) {
+                        case LonNmQueryDomain:
+                            /* Query Domain response    */
+                            LonDomainConfigReceived(
+                                (LonDomain*) &(EXPMSG.Data),
+                                (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNmQueryDomain))
+                            );
+                            break;
 
-                                    memset(&nvConfig, 0, sizeof(nvConfig));
-                                    memcpy(&nvConfig, nvConfigNonEat, sizeof(LonNvConfigNonEat));
+                        case LonNmQueryNvConfig:
 
-                                    if ((nvConfig.LON_NV_ADDRESS_FIELD & LON_NV_ADDRESS_MASK) == LON_NV_ADDRESS_MASK) {
-                                        nvConfig.LON_NV_ADDRHIGH_FIELD = LON_NV_ADDRHIGH_MASK;
-                                    }
+                            /* Query Nv Config response    */
+                            if (EXPMSG.Length == sizeof(EXPMSG.Code) + sizeof(LonNvConfigNonEat)) {
+                                LonNvConfig nvConfig;
+                                LonNvConfigNonEat* nvConfigNonEat = (LonNvConfigNonEat*) & (EXPMSG.Data);
 
-                                    LonNvConfigReceived(
-                                        &nvConfig,
-                                        (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNmQueryNvConfig))
-                                    );
-                                } else {
-                                    LonAliasConfig aliasConfig;
-                                    LonAliasConfigNonEat* aliasConfigNonEat = (LonAliasConfigNonEat *) & (EXPMSG.Data);
+                                memset(&nvConfig, 0, sizeof(nvConfig));
+                                memcpy(&nvConfig, nvConfigNonEat, sizeof(LonNvConfigNonEat));
 
-                                    memset(&aliasConfig, 0, sizeof(aliasConfig));
-                                    memcpy(&aliasConfig.Alias, &aliasConfigNonEat->Alias, sizeof(LonNvConfigNonEat));
+                                if ((nvConfig.LON_NV_ADDRESS_FIELD & LON_NV_ADDRESS_MASK) == LON_NV_ADDRESS_MASK) {
+                                    nvConfig.LON_NV_ADDRHIGH_FIELD = LON_NV_ADDRHIGH_MASK;
+                                }
 
-                                    if ((aliasConfig.Alias.LON_NV_ADDRESS_FIELD & LON_NV_ADDRESS_MASK) == LON_NV_ADDRESS_MASK) {
-                                        aliasConfig.Alias.LON_NV_ADDRHIGH_FIELD = LON_NV_ADDRHIGH_MASK;
-                                    }
+                                LonNvConfigReceived(
+                                    &nvConfig,
+                                    (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNmQueryNvConfig))
+                                );
+                            } else {
+                                LonAliasConfig aliasConfig;
+                                LonAliasConfigNonEat* aliasConfigNonEat = (LonAliasConfigNonEat *) & (EXPMSG.Data);
 
-                                    aliasConfig.Primary = aliasConfigNonEat->Primary;
-                                    LON_SET_UNSIGNED_WORD(aliasConfig.HostPrimary, 0xFFFF);
+                                memset(&aliasConfig, 0, sizeof(aliasConfig));
+                                memcpy(&aliasConfig.Alias, &aliasConfigNonEat->Alias, sizeof(LonNvConfigNonEat));
 
-                                    LonAliasConfigReceived(
-                                        &aliasConfig,
-                                        (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNmQueryNvConfig))
-                                    );
+                                if ((aliasConfig.Alias.LON_NV_ADDRESS_FIELD & LON_NV_ADDRESS_MASK) == LON_NV_ADDRESS_MASK) {
+                                    aliasConfig.Alias.LON_NV_ADDRHIGH_FIELD = LON_NV_ADDRHIGH_MASK;
                                 }
 
-                                break;
+                                aliasConfig.Primary = aliasConfigNonEat->Primary;
+                                LON_SET_UNSIGNED_WORD(aliasConfig.HostPrimary, 0xFFFF);
 
-                            case LonNmQueryAddr:
-                                /* Query Address response    */
-                                LonAddressConfigReceived(
-                                    (LonAddress*) &(EXPMSG.Data),
-                                    (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNmQueryAddr))
+                                LonAliasConfigReceived(
+                                    &aliasConfig,
+                                    (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNmQueryNvConfig))
                                 );
-                                break;
+                            }
 
-                            case LonNmReadMemory:
-                                /* Read of configuration data response    */
-                                LonConfigDataReceived(
-                                    (const LonConfigData * const) &(EXPMSG.Data.Data),
-                                    (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNmReadMemory))
-                                );
-                                break;
+                            break;
 
-                            case LonNmExpanded:
-                                switch (EXPMSG.Data.Data[0]) {
-                                case LonExpQueryNvConfig: {
-                                    LonNmQueryNvConfigResponseExp* response = (LonNmQueryNvConfigResponseExp*) &(EXPMSG.Data);
+                        case LonNmQueryAddr:
+                            /* Query Address response    */
+                            LonAddressConfigReceived(
+                                (LonAddress*) &(EXPMSG.Data),
+                                (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNmQueryAddr))
+                            );
+                            break;
 
-                                    LonNvConfigReceived(
-                                        &response->Config,
-                                        (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNmExpanded))
-                                    );
-                                }
-                                break;
-
-                                case LonExpQueryAliasConfig: {
-                                    /* Data type translation required. The LonAliasConfig structure
-                                     * includes the short and long primary indices, but this response
-                                     * only carries the long primary index.
-                                     */
-                                    LonAliasConfig alias;
-                                    LonNmQueryAliasConfigResponseExp* response = (LonNmQueryAliasConfigResponseExp*) &(EXPMSG.Data);
-
-                                    memset(&alias, 0, sizeof(alias));
-                                    memcpy(&alias.Alias, &response->Alias, sizeof(alias.Alias));
-                                    alias.Primary = response->Primary.lsb;
-                                    alias.HostPrimary = response->Primary;
-                                    LonAliasConfigReceived(
-                                        &alias,
-                                        (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNmExpanded))
-                                    );
-                                }
-                                break;
-                                }
+                        case LonNmReadMemory:
+                            /* Read of configuration data response    */
+                            LonConfigDataReceived(
+                                (const LonConfigData * const) &(EXPMSG.Data.Data),
+                                (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNmReadMemory))
+                            );
+                            break;
 
-                                break;
+                        case LonNmExpanded:
+                            switch (EXPMSG.Data.Data[0]) {
+                            case LonExpQueryNvConfig: {
+                                LonNmQueryNvConfigResponseExp* response = (LonNmQueryNvConfigResponseExp*) &(EXPMSG.Data);
 
-                            default:
-                                break;
+                                LonNvConfigReceived(
+                                    &response->Config,
+                                    (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNmExpanded))
+                                );
                             }
-                        } else if (CurrentNmNdStatus == ND_PENDING) {
-                            /* Process the response to a local NM/ND message    */
-                            switch ((EXPMSG.Code & LON_ND_OPCODE_MASK) | LON_ND_OPCODE_BASE) {
-                            case LonNdQueryStatus:
-                                /* Query Status response */
-                                LonStatusReceived(
-                                    &(EXPMSG.Data.QueryStatusResponse.Status),
-                                    (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNdQueryStatus))
+                            break;
+
+                            case LonExpQueryAliasConfig: {
+                                /* Data type translation required. The LonAliasConfig structure
+                                 * includes the short and long primary indices, but this response
+                                 * only carries the long primary index.
+                                 */
+                                LonAliasConfig alias;
+                                LonNmQueryAliasConfigResponseExp* response = (LonNmQueryAliasConfigResponseExp*) &(EXPMSG.Data);
+
+                                memset(&alias, 0, sizeof(alias));
+                                memcpy(&alias.Alias, &response->Alias, sizeof(alias.Alias));
+                                alias.Primary = response->Primary.lsb;
+                                alias.HostPrimary = response->Primary;
+                                LonAliasConfigReceived(
+                                    &alias,
+                                    (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNmExpanded))
                                 );
-                                break;
+                            }
+                            break;
+                            }
 
-                            case LonNdQueryXcvr:
-                                /* Query Transceiver Status response */
-                                LonTransceiverStatusReceived(
-                                    (const LonTransceiverParameters * const) & (EXPMSG.Data.QueryXcvrStatusResponse.Status),
-                                    (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNdQueryXcvr))
-                                );
-                                break;
+                            break;
 
-                            default:
-                                break;
-                            }
+                        default:
+                            break;
+                        }
+                    } else if (CurrentNmNdStatus == ND_PENDING) {
+                        /* Process the response to a local NM/ND message    */
+                        switch ((EXPMSG.Code & LON_ND_OPCODE_MASK) | LON_ND_OPCODE_BASE) {
+                        case LonNdQueryStatus:
+                            /* Query Status response */
+                            LonStatusReceived(
+                                &(EXPMSG.Data.QueryStatusResponse.Status),
+                                (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNdQueryStatus))
+                            );
+                            break;
+
+                        case LonNdQueryXcvr:
+                            /* Query Transceiver Status response */
+                            LonTransceiverStatusReceived(
+                                (const LonTransceiverParameters * const) & (EXPMSG.Data.QueryXcvrStatusResponse.Status),
+                                (LonBool)(EXPMSG.Code == LON_NM_SUCCESS(LonNdQueryXcvr))
+                            );
+                            break;
+
+                        default:
+                            break;
                         }
+                    }
 
 #endif  /* LON_NM_QUERY_FUNCTIONS */
-                        CurrentNmNdStatus = NO_NM_ND_PENDING;
-                    } else {
-                        /* Explicit message response. */
+                    CurrentNmNdStatus = NO_NM_ND_PENDING;
+                } else {
+                    /* Explicit message response. */
 #if    LON_APPLICATION_MESSAGES
 #if    LON_EXPLICIT_ADDRESSING
-                        LonResponseArrived(
-                            &(EXPMSG.Address.Response),
-                            LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_TAG),
-                            (LonApplicationMessageCode) EXPMSG.Code,
-                            EXPMSG.Data.Data,
-                            (LonByte)(EXPMSG.Length - 1)
-                        );
+                    LonResponseArrived(
+                        &(EXPMSG.Address.Response),
+                        LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_TAG),
+                        (LonApplicationMessageCode) EXPMSG.Code,
+                        EXPMSG.Data.Data,
+                        (LonByte)(EXPMSG.Length - 1)
+                    );
 #else
-                        LonResponseArrived(
-                            NULL,
-                            LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_TAG),
-                            (LonApplicationMessageCode) EXPMSG.Code,
-                            EXPMSG.Data.Data,
-                            (LonByte)(EXPMSG.Length - 1)
-                        );
+                    LonResponseArrived(
+                        NULL,
+                        LON_GET_ATTRIBUTE(EXPMSG, LON_EXPMSG_TAG),
+                        (LonApplicationMessageCode) EXPMSG.Code,
+                        EXPMSG.Data.Data,
+                        (LonByte)(EXPMSG.Length - 1)
+                    );
 #endif
 #endif    /* LON_APPLICATION_MESSAGES    */
-                    }
                 }
             }
-
-            break;
         }
 
-        case LonNiReset:
-            /* The ShortStack Micro Server resets.    */
-            /* Reset the serial driver to get back in sync. */
-            ++resetCounter;
-            LdvReset(ldv_handle);
-            CurrentNmNdStatus = NO_NM_ND_PENDING;
-            memcpy(
-                (void*)&lastResetNotification,
-                (LonResetNotification *) pSmipMsg,
-                sizeof(lastResetNotification)
-            );
+        break;
+    }
 
-            if (LON_GET_ATTRIBUTE(lastResetNotification, LON_RESET_INITIALIZED)) {
-                /*
-                 * The Micro Server is initialized. Such a reset occurs
-                 * when the device is being commissioned (or reset for
-                 * diagnostics). Other possible causes for such a reset
-                 * include fatal error conditions, including watchdog
-                 * timer resets due to excessive noise on the network.
-                 */
-                LonResetOccurred((LonResetNotification *) pSmipMsg);
-            } else {
-                /*
-                 * The Micro Server is not initialized. Such a reset
-                 * occurs when the Micro Server firmware has been
-                 * reloaded. In this event, the Micro Server is in
-                 * quiet mode and ignores all network communication
-                 * until it has been initialized. We'll do this
-                 * right here, but complete the processing of this
-                 * uplink notification first in order to free the
-                 * buffer used by this transaction before allocating
-                 * more buffers for the (re-)initialization.
-                 * The application will receive a LonResetOccurred()
-                 * event at the end of the (re-)initialization,
-                 * because this process always concludes with an explicit
-                 * reset request.
-                 *
-                 * Note that the entire device will enter the
-                 * unconfigured state after the Micro Server has been
-                 * reinitialized in this manner. This is required to
-                 * prevent a possibly fatal network misconfiguration.
-                 */
-                requestReinit = TRUE;
-            }
+    case LonNiReset:
+        /* The ShortStack Micro Server resets.    */
+        /* Reset the serial driver to get back in sync. */
+        ++resetCounter;
+        LdvReset(ldv_handle);
+        CurrentNmNdStatus = NO_NM_ND_PENDING;
+        memcpy(
+            (void*)&lastResetNotification,
+            (LonResetNotification *) pSmipMsg,
+            sizeof(lastResetNotification)
+        );
+
+        if (LON_GET_ATTRIBUTE(lastResetNotification, LON_RESET_INITIALIZED)) {
+            /*
+             * The Micro Server is initialized. Such a reset occurs
+             * when the device is being commissioned (or reset for
+             * diagnostics). Other possible causes for such a reset
+             * include fatal error conditions, including watchdog
+             * timer resets due to excessive noise on the network.
+             */
+            LonResetOccurred((LonResetNotification *) pSmipMsg);
+        } else {
+            /*
+             * The Micro Server is not initialized. Such a reset
+             * occurs when the Micro Server firmware has been
+             * reloaded. In this event, the Micro Server is in
+             * quiet mode and ignores all network communication
+             * until it has been initialized. We'll do this
+             * right here, but complete the processing of this
+             * uplink notification first in order to free the
+             * buffer used by this transaction before allocating
+             * more buffers for the (re-)initialization.
+             * The application will receive a LonResetOccurred()
+             * event at the end of the (re-)initialization,
+             * because this process always concludes with an explicit
+             * reset request.
+             *
+             * Note that the entire device will enter the
+             * unconfigured state after the Micro Server has been
+             * reinitialized in this manner. This is required to
+             * prevent a possibly fatal network misconfiguration.
+             */
+            requestReinit = TRUE;
+        }
 
-            break;
+        break;
 
-        case LonNiService:
-            /* Service pin was  pressed.*/
-            LonServicePinPressed();
-            break;
+    case LonNiService:
+        /* Service pin was  pressed.*/
+        LonServicePinPressed();
+        break;
 
-        case LonNiServiceHeld:
-            /* Service pin has been held longer than a configurable period of time. */
-            /* See ShortStack User's Guide on how to set the period.                */
-            LonServicePinHeld();
-            break;
+    case LonNiServiceHeld:
+        /* Service pin has been held longer than a configurable period of time. */
+        /* See ShortStack User's Guide on how to set the period.                */
+        LonServicePinHeld();
+        break;
 
 #if LON_UTILITY_FUNCTIONS
 
-        case LonNiUsop:
-
-            /* A response to one of the utility functions has arrived. */
-            switch (pSmipMsg->Payload[0]) {
-            case LonUsopPing:
-                LonPingReceived();
-                break;
+    case LonNiUsop:
 
-            case LonUsopNvIsBound:
-                LonNvIsBoundReceived(pSmipMsg->Payload[1], (LonBool) pSmipMsg->Payload[2]);
-                break;
+        /* A response to one of the utility functions has arrived. */
+        switch (pSmipMsg->Payload[0]) {
+        case LonUsopPing:
+            LonPingReceived();
+            break;
 
-            case LonUsopMtIsBound:
-                LonMtIsBoundReceived(pSmipMsg->Payload[1], (LonBool) pSmipMsg->Payload[2]);
-                break;
+        case LonUsopNvIsBound:
+            LonNvIsBoundReceived(pSmipMsg->Payload[1], (LonBool) pSmipMsg->Payload[2]);
+            break;
 
-            case LonUsopGoUcfg:
-                LonGoUnconfiguredReceived();
-                break;
+        case LonUsopMtIsBound:
+            LonMtIsBoundReceived(pSmipMsg->Payload[1], (LonBool) pSmipMsg->Payload[2]);
+            break;
 
-            case LonUsopGoCfg:
-                LonGoConfiguredReceived();
-                break;
+        case LonUsopGoUcfg:
+            LonGoUnconfiguredReceived();
+            break;
 
-            case LonUsopQueryAppSignature: {
-                LonWord appSignature;
-                appSignature.msb = pSmipMsg->Payload[1];
-                appSignature.lsb = pSmipMsg->Payload[2];
-                LonAppSignatureReceived(appSignature);
-                break;
-            }
+        case LonUsopGoCfg:
+            LonGoConfiguredReceived();
+            break;
 
-            case LonUsopVersion:
-                LonVersionReceived(
-                    pSmipMsg->Payload[1],
-                    pSmipMsg->Payload[2],
-                    pSmipMsg->Payload[3],
-                    pSmipMsg->Payload[4],
-                    pSmipMsg->Payload[5],
-                    pSmipMsg->Payload[6]
-                );
-                break;
+        case LonUsopQueryAppSignature: {
+            LonWord appSignature;
+            appSignature.msb = pSmipMsg->Payload[1];
+            appSignature.lsb = pSmipMsg->Payload[2];
+            LonAppSignatureReceived(appSignature);
+            break;
+        }
 
-            case LonUsopEcho:
-                LonEchoReceived(&pSmipMsg->Payload[1]);
-                break;
-            }
+        case LonUsopVersion:
+            LonVersionReceived(
+                pSmipMsg->Payload[1],
+                pSmipMsg->Payload[2],
+                pSmipMsg->Payload[3],
+                pSmipMsg->Payload[4],
+                pSmipMsg->Payload[5],
+                pSmipMsg->Payload[6]
+            );
+            break;
 
+        case LonUsopEcho:
+            LonEchoReceived(&pSmipMsg->Payload[1]);
             break;
+        }
+
+        break;
 #endif /* LON_UTILITY_FUNCTIONS */
 
 #if LON_ISI_ENABLED
 
-        case LonIsiNack:
-            /* Received a Nack from the Micro Server regarding the Downlink Rpc.*/
-            HandleUplinkRpcAck((IsiRpcMessage*) pSmipMsg, FALSE);
-            break;
+    case LonIsiNack:
+        /* Received a Nack from the Micro Server regarding the Downlink Rpc.*/
+        HandleUplinkRpcAck((IsiRpcMessage*) pSmipMsg, FALSE);
+        break;
 
-        case LonIsiAck:
-            /* Received an Ack from the Micro Server regarding the Downlink Rpc.*/
-            HandleUplinkRpcAck((IsiRpcMessage*) pSmipMsg, TRUE);
-            break;
+    case LonIsiAck:
+        /* Received an Ack from the Micro Server regarding the Downlink Rpc.*/
+        HandleUplinkRpcAck((IsiRpcMessage*) pSmipMsg, TRUE);
+        break;
 
-        case LonIsiCmd:
-            /* Received an uplink Rpc from the Micro Server. */
-            HandleUplinkRpc((IsiRpcMessage*) pSmipMsg);
-            break;
+    case LonIsiCmd:
+        /* Received an uplink Rpc from the Micro Server. */
+        HandleUplinkRpc((IsiRpcMessage*) pSmipMsg);
+        break;
 #endif /* LON_ISI_ENABLED */
-        }
+    }
+
+    return requestReinit;
+}
+
+#if LON_TX_CONGESTION
+/*
+ * CheckTxCongestion() obtains the driver's downlink congestion state, if
+ * supported, and reports each change with the LonTxCongestion() callback.
+ */
+static void CheckTxCongestion(void)
+{
+    LonBool congested = FALSE;
+
+    if (LdvGetCongestion(ldv_handle, &congested) == LonApiNoError
+        && congested != txCongested) {
+        txCongested = congested;
+        LonTxCongestion(congested);
+    }
+}
+#endif  /* LON_TX_CONGESTION */
+
+/*
+ * Function: LonEventHandler
+ * Periodic service to the ShortStack LonTalk Compact API.
+ *
+ * Remarks:
+ * This function must be called periodically by the application.  This
+ * function processes any messages that have been received from the Micro Server.
+ * The application can call this function as part of the idle loop, or from a
+ * dedicated timer-based thread or interrupt service routine. All API callback
+ * functions occur within this function's context. Note that the application is
+ * responsible for correct context management and thread synchronization, as
+ * (and if) required by the hosting platform.
+ *
+ * Unless the application waits for the driver's event as described below,
+ * this function must be called at least once every 10 ms.  Use the following
+ * formula to determine the minimum call rate:
+ *  rate = MaxPacketRate / (InputBufferCount - 1)
+ * where MaxPacketRate is the maximum number of packets per second arriving for
+ * the device and InputBufferCount is the number of input buffers defined for
+ * the application.
+ *
+ * When built with LON_DRIVER_EVENTS defined as non-zero, the application may
+ * instead sleep until <LonWaitForEvent>() returns, or until the descriptor
+ * reported by <LonGetEventFd>() becomes readable, and call this function
+ * then. The driver signals its event while incoming messages remain, and this
+ * function has no timer-driven work, so no message waits for a periodic call.
+ * The start of transmit congestion (see LON_TX_CONGESTION) is reported on the
+ * next call after it occurs; its end is signalled by the driver's event.
+ */
+void LonEventHandler(void)
+{
+    LonSmipMsg* pSmipMsg = NULL;
+    LonBool requestReinit = FALSE;
+
+#if LON_TX_CONGESTION
+    CheckTxCongestion();
+#endif  /* LON_TX_CONGESTION */
+
+    if (LdvGetMsg(ldv_handle, &pSmipMsg) == LonApiNoError) {
+        /* A message has been retrieved from driver's receive buffer    */
+        requestReinit = ProcessUplinkMessage(pSmipMsg);
 
         /* Release the receive buffer back to the serial driver. */
         LdvReleaseMsg(ldv_handle, pSmipMsg);
@@ -859,6 +963,99 @@ void LonEventHandler(void)
     }
 }
 
+#if LON_EVENT_BATCHES
+/*
+ * Function: LonEventHandlerEx
+ * Periodic service to the ShortStack LonTalk Compact API, processing several
+ * messages per call.
+ *
+ * Remarks:
+ * See <LonEventHandler> for details. Messages are retrieved from the driver
+ * and released to the driver in batches, using the driver's optional
+ * LdvGetMsgs() and LdvReleaseMsgs() API where available.
+ */
+unsigned LonEventHandlerEx(unsigned maxFrames, unsigned budgetMicros)
+{
+    LonSmipMsg* frames[LON_EVENT_BATCH_SIZE];
+    unsigned long start = 0;
+    unsigned processed = 0;
+    LonBool requestReinit = FALSE;
+    LonBool more = TRUE;
+    LonBool timed = budgetMicros
+                    && LdvGetTimestamp(ldv_handle, &start) == LonApiNoError;
+
+#if LON_TX_CONGESTION
+    CheckTxCongestion();
+#endif  /* LON_TX_CONGESTION */
+
+    while (more && !requestReinit && (maxFrames == 0 || processed < maxFrames)) {
+        unsigned wanted = LON_EVENT_BATCH_SIZE;
+        unsigned count = 0;
+        unsigned i = 0;
+        LonApiError error = LonApiNoError;
+
+        if (maxFrames && maxFrames - processed < wanted) {
+            wanted = maxFrames - processed;
+        }
+
+        error = LdvGetMsgs(ldv_handle, frames, wanted, &count);
+
+        if (error == LonApiNotSupported) {
+            /* Fill the batch one message at a time. */
+            count = 0;
+
+            while (count < wanted
+                   && LdvGetMsg(ldv_handle, &frames[count]) == LonApiNoError) {
+                ++count;
+            }
+
+            error = count ? LonApiNoError : LonApiRxMsgNotAvailable;
+        }
+
+        if (error != LonApiNoError || count == 0) {
+            break;
+        }
+
+        /*
+         * Process the entire batch, even if a message requests the Micro
+         * Server's re-initialization: those messages have already been
+         * taken from the driver. Re-initialization occurs once all buffers
+         * have been released.
+         */
+        for (i = 0; i < count; ++i) {
+            if (ProcessUplinkMessage(frames[i])) {
+                requestReinit = TRUE;
+            }
+        }
+
+        processed += count;
+
+        /* Release the receive buffers back to the serial driver. */
+        if (LdvReleaseMsgs(ldv_handle, frames, count) == LonApiNotSupported) {
+            for (i = 0; i < count; ++i) {
+                LdvReleaseMsg(ldv_handle, frames[i]);
+            }
+        }
+
+        /* A short batch indicates that the driver has been drained. */
+        more = count == wanted;
+
+        if (more && timed) {
+            unsigned long now = start;
+
+            more = LdvGetTimestamp(ldv_handle, &now) == LonApiNoError
+                   && now - start < budgetMicros;
+        }
+    }
+
+    if (requestReinit) {
+        (void)InitMicroServer();
+    }
+
+    return processed;
+}
+#endif  /* LON_EVENT_BATCHES */
+
 /*
  * Function: LonPollNv
  * Polls a bound, polling, input network variable.
@@ -2421,3 +2618,22 @@ const LonApiError LonSuspend(unsigned mode, unsigned timeout)
 {
     return LdvSuspend(ldv_handle, mode, timeout);
 }
+
+#if LON_DRIVER_STATISTICS
+const LonApiError LonGetDriverStatistics(LdvStatistics* const pStatistics)
+{
+    return LdvGetStatistics(ldv_handle, pStatistics);
+}
+#endif  /* LON_DRIVER_STATISTICS */
+
+#if LON_DRIVER_EVENTS
+const LonApiError LonWaitForEvent(unsigned timeout)
+{
+    return LdvWaitForEvent(ldv_handle, timeout);
+}
+
+const LonApiError LonGetEventFd(int* const pFd)
+{
+    return LdvGetEventFd(ldv_handle, pFd);
+}
+#endif  /* LON_DRIVER_EVENTS */
@@ -102,15 +102,56 @@ extern const LonApiError LonExit(void);
  * responsible for correct context management and thread synchronization, as
  * (and if) required by the hosting platform.
  *
- * This function must be called at least once every 10 ms.  Use the following
+ * Unless the application waits for the driver's event as described below,
+ * this function must be called at least once every 10 ms.  Use the following
  * formula to determine the minimum call rate:
  *  rate = MaxPacketRate / (InputBufferCount - 1)
  * where MaxPacketRate is the maximum number of packets per second arriving for
  * the device and InputBufferCount is the number of input buffers defined for
  * the application.
+ *
+ * When built with LON_DRIVER_EVENTS defined as non-zero, the application may
+ * instead sleep until <LonWaitForEvent>() returns, or until the descriptor
+ * reported by <LonGetEventFd>() becomes readable, and call this function
+ * then. The driver signals its event while incoming messages remain, and this
+ * function has no timer-driven work, so no message waits for a periodic call.
+ * The start of transmit congestion (see LON_TX_CONGESTION) is reported on the
+ * next call after it occurs; its end is signalled by the driver's event.
  */
 extern void LonEventHandler(void);
 
+/*
+ * Function: LonEventHandlerEx
+ * Periodic service to the ShortStack LonTalk Compact API, processing several
+ * messages per call.
+ *
+ * Parameters:
+ * maxFrames - the maximum number of messages to process, 0 for no limit
+ * budgetMicros - the time budget in microseconds, 0 for no limit
+ *
+ * Returns:
+ * The number of messages processed.
+ *
+ * Remarks:
+ * This function can be used in place of <LonEventHandler>. It processes
+ * messages received from the Micro Server until the driver has no more
+ * messages, 'maxFrames' messages have been processed, or the time budget
+ * has been used, whichever comes first. The function processes at least one
+ * batch of messages per call, even with a very small budget. The time budget
+ * requires the driver's optional LdvGetTimestamp() API and is ignored when
+ * the driver does not support it.
+ *
+ * Applications can use the result to adapt their scheduling: a result equal
+ * to 'maxFrames' indicates that more messages may be pending.
+ *
+ * The function is only available when the ShortStack API is built with the
+ * LON_EVENT_BATCHES symbol defined as non-zero, for a driver which provides
+ * the LdvGetMsgs(), LdvReleaseMsgs() and LdvGetTimestamp() APIs.
+ */
+#if LON_EVENT_BATCHES
+extern unsigned LonEventHandlerEx(unsigned maxFrames, unsigned budgetMicros);
+#endif  /* LON_EVENT_BATCHES */
+
 /*
  * Function: LonPollNv
  * Polls a bound, polling, input network variable.
@@ -959,6 +1000,24 @@ extern void LonServicePinHeld(void);
  */
 extern void LonServicePinEvent(LonBool held);
 
+/*
+ * Callback: LonTxCongestion
+ * Occurs when the driver's downlink buffers become congested, and again
+ * when the congestion ends.
+ *
+ * Parameters:
+ * congested - TRUE when congestion begins, FALSE when it ends
+ *
+ * Remarks:
+ * Applications which send many messages or network variable updates in a
+ * row can use this callback to slow down before the driver runs out of
+ * buffers, rather than failing with LonApiTxBufIsFull. The congestion
+ * thresholds are defined by the driver. This callback requires the driver's
+ * optional LdvGetCongestion() API, and occurs only when the ShortStack API
+ * is built with the LON_TX_CONGESTION symbol defined as non-zero.
+ */
+extern void LonTxCongestion(LonBool congested);
+
 /*
  * Callback: LonNvUpdateOccurred
  * Occurs when new input network variable data has arrived.
@@ -1580,4 +1639,67 @@ extern const LonApiError LonResume();
  */
 extern const LonApiError LonSuspend(unsigned mode, unsigned timeout);
 
+/*
+ * Function: LonGetDriverStatistics
+ * Reports link layer driver statistics.
+ *
+ * Parameters:
+ * pStatistics - output parameter, pointer to the driver's statistics structure
+ *
+ * Remarks:
+ * The LonGetDriverStatistics() function passes the request to the driver's
+ * optional LdvGetStatistics() API. The <LdvStatistics> type and its content
+ * are defined by the driver implementation.
+ *
+ * The function is only available when the ShortStack API is built with the
+ * LON_DRIVER_STATISTICS symbol defined as non-zero, for a driver which
+ * implements the LdvGetStatistics() API.
+ */
+#if LON_DRIVER_STATISTICS
+extern const LonApiError LonGetDriverStatistics(LdvStatistics* const pStatistics);
+#endif  /* LON_DRIVER_STATISTICS */
+
+/*
+ * Function: LonWaitForEvent
+ * Waits until the link layer driver has an incoming message for the event
+ * handler.
+ *
+ * Parameters:
+ * timeout - implementation-specific timeout, zero can wait indefinitely
+ *
+ * Remarks:
+ * The LonWaitForEvent() function passes the request to the driver's optional
+ * LdvWaitForEvent() API. Applications can call this function instead of
+ * polling <LonEventHandler>() continuously, and call <LonEventHandler>() when
+ * LonWaitForEvent() returns. The event handler has no timer-driven work, so
+ * applications need not call <LonEventHandler>() when the function times out;
+ * see <LonEventHandler>() for details.
+ *
+ * The function is only available when the ShortStack API is built with the
+ * LON_DRIVER_EVENTS symbol defined as non-zero, for a driver which
+ * implements the LdvWaitForEvent() API.
+ */
+#if LON_DRIVER_EVENTS
+extern const LonApiError LonWaitForEvent(unsigned timeout);
+
+/*
+ * Function: LonGetEventFd
+ * Reports a pollable file descriptor for the link layer driver.
+ *
+ * Parameters:
+ * pFd - output parameter, pointer to the file descriptor
+ *
+ * Remarks:
+ * The LonGetEventFd() function passes the request to the driver's optional
+ * LdvGetEventFd() API. The descriptor becomes readable when the driver has an
+ * incoming message for <LonEventHandler>(). Applications can add it to their
+ * own select() or poll() loop, but must not read from or close it.
+ *
+ * The function is only available when the ShortStack API is built with the
+ * LON_DRIVER_EVENTS symbol defined as non-zero, for a driver which
+ * implements the LdvGetEventFd() API.
+ */
+extern const LonApiError LonGetEventFd(int* const pFd);
+#endif  /* LON_DRIVER_EVENTS */
+
 #endif /* _SHORTSTACK_API_H */
@@ -220,6 +220,33 @@ void LonServicePinHeld(void)
 }
 #endif  /* LON_FRAMEWORK_TYPE_III */
 
+/*
+ * Callback: LonTxCongestion
+ * Occurs when the driver's downlink buffers become congested, and again
+ * when the congestion ends.
+ *
+ * Parameters:
+ * congested - TRUE when congestion begins, FALSE when it ends
+ *
+ * Remarks:
+ * Applications which send many messages or network variable updates in a
+ * row can use this callback to slow down before the driver runs out of
+ * buffers.
+ *
+ * Declare LONTXCONGESTION_HANDLED if you provide a compatible
+ * implementation of this event handler elsewhere.
+ */
+#ifndef LONTXCONGESTION_HANDLED
+void LonTxCongestion(LonBool congested)
+{
+	(void)congested;
+
+	/*
+	 * TO DO
+	 */
+}
+#endif	/* LONTXCONGESTION_HANDLED */
+
 /*
  * Callback: LonNvUpdateOccurred
  * Occurs when new input network variable data has arrived.
@@ -60,6 +60,45 @@
  * 6. A new LdvClose() API has been added to support application termination
  *    and orderly shutdown.
  *
+ * 7. An optional LdvGetStatistics() API has been added. Drivers may use
+ *    this to report counters and measurements to the application. The
+ *    API is only declared, and only used by the ShortStack API, when built
+ *    with the LON_DRIVER_STATISTICS symbol defined as non-zero. Drivers
+ *    which do not implement this API need not provide it, nor define the
+ *    LdvStatistics type.
+ *
+ * 8. Optional LdvWaitForEvent() and LdvGetEventFd() APIs have been added.
+ *    Applications may use these to block until the driver has work for
+ *    the event handler, rather than polling the driver continuously. The
+ *    APIs are only declared, and only used by the ShortStack API, when
+ *    built with the LON_DRIVER_EVENTS symbol defined as non-zero. Drivers
+ *    which do not implement these APIs need not provide them.
+ *
+ * 9. Optional LdvGetMsgs(), LdvReleaseMsgs() and LdvGetTimestamp() APIs
+ *    have been added. The ShortStack API uses these to process incoming
+ *    messages in batches; see LonEventHandlerEx(). The APIs are only
+ *    declared, and only used by the ShortStack API, when built with the
+ *    LON_EVENT_BATCHES symbol defined as non-zero. Drivers which do not
+ *    implement these APIs need not provide them. Drivers built with the
+ *    symbol may implement each as a stub which returns LonApiNotSupported;
+ *    the ShortStack API then uses LdvGetMsg() and LdvReleaseMsg(), and
+ *    ignores the time budget.
+ *
+ * 10. An optional LdvGetCongestion() API has been added. The ShortStack
+ *    API uses this to report downlink congestion to the application with
+ *    the LonTxCongestion() callback, but only when built with the
+ *    LON_TX_CONGESTION symbol defined as non-zero. Drivers which do not
+ *    implement this API need not provide it otherwise.
+ *
+ * 11. Optional LdvAllocateMsgs() and LdvPutMsgs() APIs have been added.
+ *    Applications may use these to allocate and submit a burst of
+ *    downlink messages in one operation. The ShortStack API does not
+ *    require or use these APIs.
+ *
+ * 12. An optional LdvDumpLog() API has been added. Applications may use
+ *    this to write the driver's frame log to a file for later analysis.
+ *    The ShortStack API does not require or use this API.
+ *
  * License:
  * Use of the source code contained in this file is subject to the terms
  * of the Echelon Example Software License Agreement which is available at
@@ -156,6 +195,49 @@ extern LonApiError LdvAllocateMsgWait(LdvHandle handle, LonSmipMsg** pFrame);
  */
 extern LonApiError LdvPutMsg(LdvHandle handle, LonSmipMsg* pFrame);
 
+/*
+ * Function: LdvAllocateMsgs
+ *
+ * LdvAllocateMsgs() allocates 'count' transmit buffers in one operation,
+ * like <LdvAllocateMsg>. The operation succeeds or fails as a whole; on
+ * failure, no buffer remains allocated.
+ *
+ * This is an optional feature; drivers not supporting this
+ * operation may do nothing but return LonApiNotSupported.
+ *
+ * Parameters:
+ * handle - the driver handle obtained from <LdvOpen>.
+ * pFrames - output parameter, array of at least 'count' frame pointers.
+ * count - the number of buffers to allocate.
+ *
+ * Result:
+ * <LonApiError>.
+ */
+extern LonApiError LdvAllocateMsgs(LdvHandle handle, LonSmipMsg* pFrames[],
+                                   unsigned count);
+
+/*
+ * Function: LdvPutMsgs
+ *
+ * LdvPutMsgs() submits several messages for downlink transfer in one
+ * operation, in array order. Submission stops with the first message which
+ * fails. The driver sets each submitted entry to NULL; the remaining
+ * entries still belong to the caller when the function fails.
+ *
+ * This is an optional feature; drivers not supporting this
+ * operation may do nothing but return LonApiNotSupported.
+ *
+ * Parameters:
+ * handle - the driver handle obtained from <LdvOpen>.
+ * pFrames - array of frame pointers. The driver modifies the array.
+ * count - the number of frame pointers in the array.
+ *
+ * Result:
+ * <LonApiError>.
+ */
+extern LonApiError LdvPutMsgs(LdvHandle handle, LonSmipMsg* pFrames[],
+                              unsigned count);
+
 /*
  * Function: LdvGetMsg
  *
@@ -187,6 +269,76 @@ extern LonApiError LdvGetMsg(LdvHandle handle, LonSmipMsg** pFrame);
  */
 extern LonApiError LdvReleaseMsg(LdvHandle handle, LonSmipMsg* pFrame);
 
+#if LON_EVENT_BATCHES
+/*
+ * Function: LdvGetMsgs
+ *
+ * LdvGetMsgs() retrieves up to 'count' incoming messages in one operation,
+ * in the order of arrival. When successful, the caller is responsible for
+ * returning each frame buffer to the pool with <LdvReleaseMsg> or
+ * <LdvReleaseMsgs>.
+ *
+ * This is an optional feature. The function is only declared, and only
+ * used by <LonEventHandlerEx>, when built with LON_EVENT_BATCHES defined
+ * as non-zero. Drivers built with this symbol but not supporting this
+ * operation may do nothing but return LonApiNotSupported.
+ *
+ * Parameters:
+ * handle - the driver handle obtained from <LdvOpen>.
+ * pFrames - output parameter, array of at least 'count' frame pointers.
+ * count - the maximum number of messages to retrieve.
+ * pCount - output parameter, the number of messages retrieved.
+ *
+ * Result:
+ * <LonApiError>. LonApiRxMsgNotAvailable if no message is available.
+ */
+extern LonApiError LdvGetMsgs(LdvHandle handle, LonSmipMsg* pFrames[],
+                              unsigned count, unsigned* pCount);
+
+/*
+ * Function: LdvReleaseMsgs
+ *
+ * LdvReleaseMsgs() releases several message buffers after processing is
+ * complete. NULL pointers in the array are ignored.
+ *
+ * This is an optional feature. The function is only declared, and only
+ * used by <LonEventHandlerEx>, when built with LON_EVENT_BATCHES defined
+ * as non-zero. Drivers built with this symbol but not supporting this
+ * operation may do nothing but return LonApiNotSupported.
+ *
+ * Parameters:
+ * handle - the driver handle obtained from <LdvOpen>.
+ * pFrames - array of frame pointers. The driver may modify the array.
+ * count - the number of frame pointers in the array.
+ *
+ * Result:
+ * <LonApiError>.
+ */
+extern LonApiError LdvReleaseMsgs(LdvHandle handle, LonSmipMsg* pFrames[],
+                                  unsigned count);
+
+/*
+ * Function: LdvGetTimestamp
+ *
+ * LdvGetTimestamp() reports a free-running timestamp in microseconds. The
+ * timestamp has no defined origin and may wrap around; callers use the
+ * difference between two timestamps only.
+ *
+ * This is an optional feature. The function is only declared, and only
+ * used by <LonEventHandlerEx>, when built with LON_EVENT_BATCHES defined
+ * as non-zero. Drivers built with this symbol but not supporting this
+ * operation may do nothing but return LonApiNotSupported.
+ *
+ * Parameters:
+ * handle - the driver handle obtained from <LdvOpen>.
+ * pMicroseconds - output parameter, the current timestamp.
+ *
+ * Result:
+ * <LonApiError>.
+ */
+extern LonApiError LdvGetTimestamp(LdvHandle handle, unsigned long* pMicroseconds);
+#endif  /* LON_EVENT_BATCHES */
+
 /*
  * Function: LdvReset
  *
@@ -261,4 +413,128 @@ extern LonApiError LdvSuspend(LdvHandle handle, unsigned mode, unsigned timeout)
  */
 extern LonApiError LdvResume(LdvHandle handle);
 
+/*
+ * Function: LdvGetStatistics
+ *
+ * LdvGetStatistics() reports driver statistics in a driver-specific
+ * <LdvStatistics> structure, defined in ldvTypes.h.
+ *
+ * This is an optional feature. The function is only declared, and the
+ * ShortStack API only provides its pass-through <LonGetDriverStatistics>
+ * API, when built with LON_DRIVER_STATISTICS defined as non-zero. Define
+ * this symbol only for drivers whose ldvTypes.h defines <LdvStatistics>.
+ *
+ * Parameters:
+ * handle - the driver handle obtained from <LdvOpen>.
+ * stats - output parameter, pointer to the statistics structure.
+ *
+ * Result:
+ * <LonApiError>.
+ */
+#if LON_DRIVER_STATISTICS
+extern LonApiError LdvGetStatistics(LdvHandle handle, LdvStatistics* stats);
+#endif  /* LON_DRIVER_STATISTICS */
+
+/*
+ * Function: LdvWaitForEvent
+ *
+ * LdvWaitForEvent() blocks the caller until an incoming message is
+ * available through <LdvGetMsg>, or until the timeout expires.
+ *
+ * The function returns at once if a message is already available. It does
+ * not consume the event; the caller drains the driver with <LdvGetMsg>
+ * (normally through <LonEventHandler>) after this function returns.
+ *
+ * This is an optional feature. The function is only declared, and the
+ * ShortStack API only provides its pass-through <LonWaitForEvent> API,
+ * when built with LON_DRIVER_EVENTS defined as non-zero.
+ *
+ * The driver implementation also defines the timeout units. This example
+ * implementation supports a timeout in milliseconds. A timeout value of
+ * zero can block indefinitely.
+ *
+ * Parameters:
+ * handle - the driver handle obtained from <LdvOpen>.
+ * timeout - the maximum time to wait.
+ *
+ * Result:
+ * <LonApiError>. LonApiTimeout when no message became available in time.
+ */
+#if LON_DRIVER_EVENTS
+extern LonApiError LdvWaitForEvent(LdvHandle handle, unsigned timeout);
+
+/*
+ * Function: LdvGetEventFd
+ *
+ * LdvGetEventFd() reports a file descriptor which becomes readable when
+ * an incoming message is available through <LdvGetMsg>, and remains
+ * readable while any incoming message remains available. Applications can
+ * add this descriptor to their own select(), poll() or epoll() loop, and
+ * call <LonEventHandler> when it becomes readable.
+ *
+ * The descriptor is owned by the driver. Applications must not read from,
+ * write to, or close it.
+ *
+ * This is an optional feature. The function is only declared, and the
+ * ShortStack API only provides its pass-through <LonGetEventFd> API,
+ * when built with LON_DRIVER_EVENTS defined as non-zero.
+ *
+ * Parameters:
+ * handle - the driver handle obtained from <LdvOpen>.
+ * fd - output parameter, pointer to the file descriptor.
+ *
+ * Result:
+ * <LonApiError>.
+ */
+extern LonApiError LdvGetEventFd(LdvHandle handle, int* fd);
+#endif  /* LON_DRIVER_EVENTS */
+
+/*
+ * Function: LdvGetCongestion
+ *
+ * LdvGetCongestion() reports whether the driver's downlink buffers are
+ * congested. The driver typically reports congestion once the number of
+ * buffers in use reaches a high watermark, and continues to do so until
+ * the number falls to a low watermark. Applications use this to slow down
+ * before <LdvAllocateMsg> fails.
+ *
+ * Drivers which support <LdvGetEventFd> make the event descriptor readable
+ * when congestion ends, so that applications waiting for the descriptor
+ * learn of the change.
+ *
+ * This is an optional feature; drivers not supporting this
+ * operation may do nothing but return LonApiNotSupported.
+ *
+ * When built with LON_TX_CONGESTION defined as non-zero, the ShortStack
+ * API calls this function from <LonEventHandler>, and reports each change
+ * with the LonTxCongestion() callback.
+ *
+ * Parameters:
+ * handle - the driver handle obtained from <LdvOpen>.
+ * pCongested - output parameter, TRUE while the downlink is congested.
+ *
+ * Result:
+ * <LonApiError>.
+ */
+extern LonApiError LdvGetCongestion(LdvHandle handle, LonBool* pCongested);
+
+/*
+ * Function: LdvDumpLog
+ *
+ * LdvDumpLog() writes the frames most recently transferred by the driver
+ * to a file, in a driver-specific binary format. Drivers record frames in
+ * this form so that logging does not change the timing of the link.
+ *
+ * This is an optional feature; drivers not supporting this
+ * operation may do nothing but return LonApiNotSupported.
+ *
+ * Parameters:
+ * handle - the driver handle obtained from <LdvOpen>.
+ * fd - the file descriptor to write to.
+ *
+ * Result:
+ * <LonApiError>.
+ */
+extern LonApiError LdvDumpLog(LdvHandle handle, int fd);
+
 #endif  /*  IZOT_SHORTSTACK_LDV_H */
@@ -18,6 +18,62 @@
 
 #include <stdint.h>
 
+/*
+ * Enumeration: LdvOverflow
+ *
+ * LdvOverflow selects the driver's response when a frame queue is full:
+ *
+ * LdvOverflowDefault - uplink: as LdvOverflowBlock, downlink: as
+ * LdvOverflowDropNewest.
+ *
+ * LdvOverflowBlock - uplink: the driver holds the new frame until the
+ * application has released a frame. Data received meanwhile collects in
+ * the spill buffer. Downlink: <LdvAllocateMsg> waits until the driver has
+ * released a frame.
+ *
+ * LdvOverflowDropNewest - the new frame is discarded. For the downlink,
+ * this means that <LdvAllocateMsg> fails with LonApiTxBufIsFull.
+ *
+ * LdvOverflowDropOldest - the oldest queued frame of ordinary network
+ * traffic is discarded, and its buffer re-used. Local network interface
+ * commands, ISI messages and priority messages are never discarded. When
+ * no other frame is queued, the driver behaves as with the default policy.
+ * Note that a discarded downlink message receives no completion event.
+ */
+typedef enum {
+    LdvOverflowDefault = 0,
+    LdvOverflowBlock = 1,
+    LdvOverflowDropNewest = 2,
+    LdvOverflowDropOldest = 3
+} LdvOverflow;
+
+/*
+ * Enumeration: LdvGpio
+ *
+ * LdvGpio selects the interface used to drive the RTS, CTS and HRDY pins:
+ *
+ * LdvGpioSysfs - the legacy sysfs interface in /sys/class/gpio.
+ *
+ * LdvGpioChardev - the GPIO character device (/dev/gpiochipN) with line
+ * requests, available with Linux 5.10 and later. This requires fewer system
+ * calls per handshake, provides kernel timestamps for CTS edges, and avoids
+ * the delay of exporting pins through sysfs.
+ *
+ * LdvGpioMock - in-memory pins without hardware, for testing. See
+ * GpioMockSet() and GpioMockGet() in io.h.
+ *
+ * LdvGpioModem - the modem control lines of the serial port: RTS for RTS,
+ * CTS for CTS, and DTR for HRDY. No GPIO is used, which suits USB serial
+ * adapters. The port numbers in <LdvCtrl> are ignored, except that a zero
+ * HRDY port disables the HRDY signal.
+ */
+typedef enum {
+    LdvGpioSysfs = 0,
+    LdvGpioChardev = 1,
+    LdvGpioMock = 2,
+    LdvGpioModem = 3
+} LdvGpio;
+
 /*
  * Typedef: LdvCtrl
  *
@@ -57,10 +113,20 @@ typedef struct {
 #define LDVCTRL_DEFAULT_GPIO_CTS    9
 #define LDVCTRL_DEFAULT_GPIO_HRDY   11
 
+    /*
+     * gpio.backend selects the GPIO interface, see <LdvGpio>. gpio.chip
+     * names the GPIO character device used with LdvGpioChardev, where the
+     * port numbers are line offsets of this chip. NULL selects the default
+     * chip.
+     */
+#define LDVCTRL_DEFAULT_GPIO_CHIP   "/dev/gpiochip0"
+
     struct {
         int rts;
         int cts;
         int hrdy;
+        LdvGpio backend;
+        const char* chip;
     } gpio;
 
     /*
@@ -70,8 +136,288 @@ typedef struct {
      * the lifetime of the driver (from <LdvOpen> to <LdvClose>).
      */
     int (*trace)(const char* fmt, ...);
+
+    /*
+     * 'watermark' configures congestion reporting for the downlink frame
+     * pool. The driver reports congestion once 'high' frames are allocated,
+     * and reports the end of congestion once no more than 'low' frames
+     * remain allocated. See <LdvGetCongestion>. Zero selects the driver's
+     * default for either value.
+     */
+    struct {
+        unsigned high;
+        unsigned low;
+    } watermark;
+
+    /*
+     * 'uplink' and 'downlink' configure the frame queue for each direction.
+     * 'capacity' is the number of frame buffers, 'overflow' the policy
+     * applied when all are in use. 'spill' is the size in bytes of the
+     * buffer which holds uplink data not yet assembled into frames. Zero
+     * selects the driver's default for any of these values.
+     *
+     * A non-zero uplink 'resync' validates the command and length of each
+     * uplink frame header. When the header is not valid, the driver discards
+     * one byte and examines the next, rather than waiting for the data of an
+     * invalid frame until the uplink timeout discards it.
+     */
+    struct {
+        unsigned capacity;
+        LdvOverflow overflow;
+        unsigned spill;
+        int resync;
+    } uplink;
+
+    struct {
+        unsigned capacity;
+        LdvOverflow overflow;
+    } downlink;
+
+    /*
+     * 'thread' configures the driver's serial I/O thread. A non-zero
+     * 'priority' selects the SCHED_FIFO policy with this priority (1..99).
+     * 'cpus' is a mask of the CPUs on which the thread may run (bit 0 for
+     * CPU 0), zero for all. A non-zero 'lock' locks all current and future
+     * memory of the process into RAM with mlockall(), and has the thread
+     * prefault its stack.
+     *
+     * Real-time priority and memory locking require suitable privileges.
+     * The driver reports failure through the trace function, if any, and
+     * continues without these options. The rtbench tool measures the
+     * effect of these options on the handshake latency under load.
+     */
+    struct {
+        int priority;
+        unsigned long cpus;
+        int lock;
+    } thread;
+
+    /*
+     * 'latency' configures the serial link for low latency. A non-zero
+     * 'lowLatency' requests the serial driver's low latency mode
+     * (ASYNC_LOW_LATENCY, which also selects the shortest latency timer
+     * with FTDI USB adapters) where supported, and has the driver wait for
+     * the remainder of each longer uplink frame in one read rather than byte by
+     * byte. A non-zero 'spin' is the time in microseconds for which the
+     * driver polls the CTS input after asserting RTS, before it waits for
+     * the CTS edge event. Zero disables either option.
+     */
+    struct {
+        int lowLatency;
+        unsigned spin;
+    } latency;
+
+    /*
+     * 'recovery' configures link-level recovery of stalled downlink
+     * transfers, without a reset of the Micro Server. A non-zero 'stall'
+     * is the time in milliseconds after which the driver suspects a stalled
+     * handshake. It then reads the CTS input to detect a missed CTS edge,
+     * and re-asserts RTS if the Micro Server has not responded. Choose
+     * a value well above the Micro Server's normal response time; zero
+     * disables recovery.
+     *
+     * With recovery enabled, a frame whose handshake times out is
+     * transmitted again from its first segment, up to 'retries' times
+     * (zero selects the driver's default), before it is discarded.
+     */
+    struct {
+        unsigned stall;
+        unsigned retries;
+    } recovery;
+
+    /*
+     * 'adaptive' derives the handshake and uplink data timeouts from the
+     * latencies observed at runtime, rather than using the fixed defaults.
+     * A non-zero 'multiple' enables this: each timeout becomes 'multiple'
+     * times the 99th percentile of the related latency, limited to the
+     * range from 'floor' to 'ceiling' milliseconds. Zero selects the fixed
+     * default timeout as the ceiling.
+     *
+     * Each timeout also has a lower limit derived from the protocol's
+     * timing, which 'floor' may raise but not lower: the handshake timeouts
+     * are never shorter than the Micro Server's 840ms watchdog interval,
+     * and the uplink data timeout allows for the transfer of a few bytes at
+     * the configured bit rate. <LdvOpen> fails if 'floor' exceeds a
+     * non-zero 'ceiling'.
+     *
+     * Shorter timeouts detect a failed Micro Server sooner, but a frame
+     * whose handshake takes longer than the timeout is discarded (or sent
+     * again, see 'recovery'). Choose a floor which allows for the longest
+     * legitimate delay, such as a Micro Server waiting for output buffers.
+     */
+    struct {
+        unsigned multiple;
+        unsigned floor;
+        unsigned ceiling;
+    } adaptive;
+
+    /*
+     * 'frameLog' selects the binary frame log. A non-zero 'records' is the
+     * number of most recent frame log records which the driver keeps in
+     * memory, rather than reporting each frame through the trace function
+     * as text. Write the log to a file with <LdvDumpLog>, and render it with
+     * the ldvdecode tool. Other trace output is not affected.
+     */
+    struct {
+        unsigned records;
+    } frameLog;
 } LdvCtrl;
 
+/*
+ * Typedef: LdvQueueStatistics
+ *
+ * LdvQueueStatistics reports the allocation counters for the frame buffers
+ * of one queue. The driver maintains one queue and frame buffer pool for
+ * each direction.
+ *
+ * A driver which pre-allocates its frame buffers makes all of its heap
+ * allocations when the driver is opened. The 'heap' counter remains
+ * constant after that time in this case.
+ */
+typedef struct {
+    unsigned capacity;          /* maximum number of frames, 0: unlimited */
+    unsigned allocated;         /* number of frames currently allocated */
+    unsigned highWater;         /* most frames ever allocated at one time */
+    unsigned long allocations;  /* number of successful allocations */
+    unsigned long failures;     /* number of failed allocations */
+    unsigned long heap;         /* number of heap allocations */
+} LdvQueueStatistics;
+
+/*
+ * Typedef: LdvLaneStatistics
+ *
+ * LdvLaneStatistics reports the depth counters of one queue, or lane. The
+ * driver sorts frames into several lanes for each direction, and serves the
+ * most urgent non-empty lane first.
+ */
+typedef struct {
+    unsigned depth;             /* number of frames currently queued */
+    unsigned highWater;         /* most frames ever queued at one time */
+    unsigned long frames;       /* number of frames queued */
+} LdvLaneStatistics;
+
+/*
+ * Uplink lanes, in order of priority: local network interface commands and
+ * ISI, and all other messages.
+ */
+#define LDV_UPLINK_LANES    2
+
+/*
+ * Downlink lanes, in order of priority: local network interface commands
+ * and ISI, priority messages, and all other messages.
+ */
+#define LDV_DOWNLINK_LANES  3
+
+/*
+ * Latency histogram buckets. Bucket 0 counts responses within 1us, bucket
+ * n counts responses within [2^(n-1), 2^n) us, and the last bucket counts
+ * all slower responses.
+ */
+#define LDV_LATENCY_BUCKETS 20
+
+/*
+ * VMIN settings reported in the uplink statistics: VMIN one, and VMIN
+ * tuned to the remainder of a frame (see LdvCtrl.latency).
+ */
+#define LDV_VMIN_SETTINGS   2
+
+/*
+ * Downlink profile classes and segments. The downlink profile is kept for
+ * each class of network interface command: local commands (including ISI),
+ * LonNiComm, LonNiNetManagement and LonNiNv, and for each segment of a
+ * frame: the header, the extended header and the payload.
+ */
+#define LDV_PROFILE_CLASSES     4
+#define LDV_PROFILE_SEGMENTS    3
+
+/*
+ * Typedef: LdvSegmentProfile
+ *
+ * LdvSegmentProfile reports the handshake timing of one kind of downlink
+ * segment in latency histograms (see LDV_LATENCY_BUCKETS). 'ctsDeassert'
+ * is the time spent waiting for the Micro Server to de-assert CTS before
+ * RTS can be asserted; no time is recorded when CTS was already clear.
+ * 'ctsAssert' is the time from the RTS assertion to the CTS response, and
+ * 'write' the time spent writing the segment to the serial port.
+ *
+ * Long CTS waits point at the Micro Server (or the network) as the
+ * bottleneck, long writes at the host.
+ */
+typedef struct {
+    unsigned long segments;                             /* segments sent */
+    unsigned long ctsDeassert[LDV_LATENCY_BUCKETS];
+    unsigned long ctsAssert[LDV_LATENCY_BUCKETS];
+    unsigned long write[LDV_LATENCY_BUCKETS];
+} LdvSegmentProfile;
+
+/*
+ * Typedef: LdvStatistics
+ *
+ * LdvStatistics reports driver statistics, obtained with
+ * <LdvGetStatistics>. The ShortStack API imposes no meaning on the
+ * content of this structure, it merely passes it through from your driver
+ * to your application with <LonGetDriverStatistics>, when built with the
+ * LON_DRIVER_STATISTICS symbol defined as non-zero.
+ */
+typedef struct {
+    struct {
+        LdvQueueStatistics queue;
+        unsigned long timeouts;     /* incomplete frames discarded */
+        unsigned long dropped;      /* frames discarded by the overflow policy */
+        LdvLaneStatistics lanes[LDV_UPLINK_LANES];
+        unsigned long resyncs;      /* invalid headers found, see LdvCtrl.uplink */
+        unsigned long skipped;      /* bytes discarded to resynchronize */
+        /*
+         * 'segments' reports the time from one read of a partial frame to
+         * the next, in latency histograms for each VMIN setting in effect
+         * during the wait: [0] for VMIN one, [1] for a tuned VMIN.
+         * 'vminChanges' counts the changes of the VMIN setting.
+         */
+        unsigned long segments[LDV_VMIN_SETTINGS][LDV_LATENCY_BUCKETS];
+        unsigned long vminChanges;
+    } uplink;
+    struct {
+        LdvQueueStatistics queue;
+        unsigned long timeouts;     /* frames abandoned by the handshake */
+        unsigned long dropped;      /* frames discarded by the overflow policy */
+        LdvLaneStatistics lanes[LDV_DOWNLINK_LANES];
+        unsigned long congestions;  /* times the high watermark was reached */
+        int congested;              /* currently above the high watermark */
+        unsigned long latency[LDV_LATENCY_BUCKETS]; /* RTS to CTS, per segment */
+        unsigned long spins;        /* CTS responses found by polling */
+        struct {
+            unsigned long stalls;       /* handshake stalls detected */
+            unsigned long edges;        /* missed CTS edges found */
+            unsigned long resyncs;      /* RTS re-assertions */
+            unsigned long retransmits;  /* frames transmitted again */
+            unsigned long recovered;    /* stalls resolved */
+            unsigned long time;         /* total time stalled, in us */
+            unsigned long longest;      /* longest time stalled, in us */
+        } recovery;                     /* see LdvCtrl.recovery */
+        LdvSegmentProfile profile[LDV_PROFILE_CLASSES][LDV_PROFILE_SEGMENTS];
+    } downlink;
+    /*
+     * 'timeouts' reports the timeouts currently in use, in milliseconds.
+     * These are the fixed defaults unless LdvCtrl.adaptive is enabled.
+     */
+    struct {
+        unsigned ctsDeassert;
+        unsigned ctsAssert;
+        unsigned uplinkData;
+    } timeouts;
+    /*
+     * 'startup' reports the cold-start times in microseconds: the time spent
+     * in <LdvOpen>, and the time from the call to <LdvOpen> until the first
+     * uplink frame was received. The first uplink frame is normally the
+     * Micro Server's reset notification, which the API reports with
+     * LonResetOccurred(). 'ready' remains zero until then.
+     */
+    struct {
+        unsigned long open;
+        unsigned long ready;
+    } startup;
+} LdvStatistics;
+
 /*
  * Typedef: LdvHandle
  *
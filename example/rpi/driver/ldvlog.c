@@ -0,0 +1,229 @@
+/*
+ * IzoT ShortStack for Raspberry Pi Simple Example
+ *
+ * ldvlog.c implements the binary frame log for use with the example driver
+ * for Raspberry Pi. See ldvlog.h for general comments, and see below for
+ * specific comments about this implementation.
+ *
+ * Formatting each frame as text within the driver's I/O thread, and
+ * passing the text through the application's trace function, takes long
+ * enough to change the timing of the serial link noticeably. This log
+ * therefore records the raw frame data in a ring of fixed-size records.
+ * Writing a record takes a copy of the frame data and a few atomic stores,
+ * and renders no text.
+ *
+ * The ring has exactly one writer. Each record carries a sequence number,
+ * which the writer clears before it modifies the record and sets after it
+ * has completed the record. A reader copies the record and accepts the copy
+ * only if the sequence number is the expected one before and after the copy,
+ * so that the writer never waits for a reader.
+ *
+ * License:
+ * Use of the source code contained in this file is subject to the terms
+ * of the Echelon Example Software License Agreement which is available at
+ * www.echelon.com/license/examplesoftware/.
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ldvlog.h"
+
+/*
+ * LogCtrl is the structure used for LdvLogHandle. 'head' counts the
+ * records committed; only the writer modifies it.
+ */
+typedef struct {
+    unsigned capacity;  /* A power of two */
+    unsigned head;
+    LdvLogRecord records[];
+} LogCtrl;
+
+/*
+ * Write() writes all of the given data, or fails.
+ */
+static int Write(int fd, const void* data, size_t size)
+{
+    const uint8_t* next = (const uint8_t*) data;
+
+    while (size) {
+        ssize_t written = write(fd, next, size);
+
+        if (written == -1 && errno != EINTR) {
+            return -1;
+        } else if (written > 0) {
+            next += written;
+            size -= written;
+        }
+    }
+
+    return 0;
+}
+
+LdvLogHandle LdvLogOpen(unsigned records)
+{
+    LogCtrl* log = NULL;
+    unsigned capacity = 1;
+
+    while (capacity && capacity < records) {
+        capacity <<= 1;
+    }
+
+    if (records && capacity >= records) {
+        log = calloc(1, sizeof(LogCtrl) + capacity * sizeof(LdvLogRecord));
+    }
+
+    if (log) {
+        log->capacity = capacity;
+    }
+
+    return (LdvLogHandle) log;
+}
+
+void LdvLogClose(LdvLogHandle handle)
+{
+    free((LogCtrl*) handle);
+}
+
+LdvLogRecord* LdvLogNext(LdvLogHandle handle)
+{
+    LogCtrl* log = (LogCtrl*) handle;
+    LdvLogRecord* record = &log->records[log->head & (log->capacity - 1)];
+
+    /*
+     * Invalidate the record before it is modified. The release fence orders
+     * this store before the writer's stores to the record.
+     */
+    __atomic_store_n(&record->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    return record;
+}
+
+void LdvLogCommit(LdvLogHandle handle)
+{
+    LogCtrl* log = (LogCtrl*) handle;
+    const unsigned head = log->head;
+    LdvLogRecord* record = &log->records[head & (log->capacity - 1)];
+
+    __atomic_store_n(&record->sequence, head + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&log->head, head + 1, __ATOMIC_RELEASE);
+}
+
+int LdvLogDump(LdvLogHandle handle, int fd)
+{
+    LogCtrl* log = (LogCtrl*) handle;
+    LdvLogFileHeader header;
+    LdvLogRecord* copy = NULL;
+    int result = -1;
+
+    if (log) {
+        copy = malloc(log->capacity * sizeof(LdvLogRecord));
+    }
+
+    if (copy) {
+        const unsigned head = __atomic_load_n(&log->head, __ATOMIC_ACQUIRE);
+        const unsigned first = head > log->capacity ? head - log->capacity : 0;
+        unsigned count = 0;
+
+        for (unsigned index = first; index != head; ++index) {
+            const LdvLogRecord* record = &log->records[index & (log->capacity - 1)];
+
+            if (__atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE) == index + 1) {
+                memcpy(&copy[count], record, sizeof(LdvLogRecord));
+
+                /*
+                 * Accept the copy only if the writer has not begun to
+                 * overwrite the record meanwhile.
+                 */
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+                if (__atomic_load_n(&record->sequence, __ATOMIC_RELAXED) == index + 1) {
+                    copy[count].sequence = index + 1;
+                    ++count;
+                }
+            }
+        }
+
+        memset(&header, 0, sizeof(header));
+        header.magic = LDV_LOG_MAGIC;
+        header.version = LDV_LOG_VERSION;
+        header.size = sizeof(LdvLogRecord);
+        header.count = count;
+        header.lost = head - count;
+
+        if (Write(fd, &header, sizeof(header)) == 0
+            && Write(fd, copy, count * sizeof(LdvLogRecord)) == 0) {
+            result = 0;
+        }
+
+        free(copy);
+    } else {
+        errno = log ? ENOMEM : EINVAL;
+    }
+
+    return result;
+}
+
+/*
+ * Hex() appends a byte as two hexadecimal digits.
+ */
+static char* Hex(char* text, uint8_t value)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    *text++ = digits[value >> 4];
+    *text++ = digits[value & 0x0F];
+
+    return text;
+}
+
+size_t LdvLogFormat(const LdvLogRecord* record, char* buffer)
+{
+    const uint8_t length = record->data[0];
+    const uint8_t index = record->data[2];
+    char* text = buffer;
+    unsigned id = record->id;
+
+    memcpy(text, record->direction == LDV_LOG_UP ? "UP." : "DN.", 3);
+    text += 3;
+
+    for (int digit = 4; digit >= 0; --digit) {
+        text[digit] = '0' + id % 10;
+        id /= 10;
+    }
+
+    text += 5;
+
+    memcpy(text, " H:0x", 5);
+    text = Hex(text + 5, record->data[0]);
+    *text++ = '.';
+    text = Hex(text, record->data[1]);
+
+    if (index
+    && (record->segment == LDV_LOG_EXTHDR || record->segment == LDV_LOG_PAYLOAD)) {
+        memcpy(text, " X:0x", 5);
+        text = Hex(text + 5, record->data[2]);
+        *text++ = '.';
+        text = Hex(text, record->data[3]);
+    }
+
+    if (length
+    && (record->segment == LDV_LOG_FRAME || record->segment == LDV_LOG_PAYLOAD)) {
+        memcpy(text, " P:0x", 5);
+        text += 5;
+
+        for (int i = 0; i < length && 4 + i < LDV_LOG_DATA; ++i) {
+            text = Hex(text, record->data[4 + i]);
+            *text++ = '.';
+        }
+
+        /* Remove the trailing '.' */
+        --text;
+    }
+
+    *text = '\0';
+
+    return (size_t) (text - buffer);
+}
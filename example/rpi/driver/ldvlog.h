@@ -0,0 +1,198 @@
+/*
+ * IzoT ShortStack for Raspberry Pi Simple Example
+ *
+ * ldvlog.h defines a binary frame log implemented in ldvlog.c.
+ *
+ * The driver records each frame it transfers into a ring of fixed-size
+ * binary records, rather than formatting the frame as text while the frame
+ * is being transferred. The log can be written to a file with <LdvLogDump>,
+ * and rendered as text with <LdvLogFormat> later, for example with the
+ * ldvdecode tool.
+ *
+ * This header does not depend on the ShortStack API, so that tools which
+ * read log files can use it without a ShortStack configuration.
+ *
+ * License:
+ * Use of the source code contained in this file is subject to the terms
+ * of the Echelon Example Software License Agreement which is available at
+ * www.echelon.com/license/examplesoftware/.
+ */
+#if !defined(IZOT_SHORTSTACK_LDVLOG_H)
+#   define IZOT_SHORTSTACK_LDVLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Macro: LDV_LOG_UP, LDV_LOG_DOWN
+ *
+ * The direction of a logged frame, see <LdvLogRecord>.
+ */
+#define LDV_LOG_UP      0
+#define LDV_LOG_DOWN    1
+
+/*
+ * Macro: LDV_LOG_HEADER, LDV_LOG_EXTHDR, LDV_LOG_PAYLOAD, LDV_LOG_FRAME
+ *
+ * The segment of a logged frame, see <LdvLogRecord>. Downlink frames are
+ * logged once for each segment transferred, uplink frames are logged once
+ * as a whole.
+ */
+#define LDV_LOG_HEADER  0
+#define LDV_LOG_EXTHDR  1
+#define LDV_LOG_PAYLOAD 2
+#define LDV_LOG_FRAME   0xFF
+
+/*
+ * Macro: LDV_LOG_DATA
+ *
+ * The size of the data in a <LdvLogRecord>: the header, the extended
+ * header and up to 255 bytes of payload, rounded up.
+ */
+#define LDV_LOG_DATA    260
+
+/*
+ * Macro: LDV_LOG_TEXT
+ *
+ * The size of a buffer large enough for any record rendered by
+ * <LdvLogFormat>, including the terminating zero.
+ */
+#define LDV_LOG_TEXT    (32 + LDV_LOG_DATA * 3)
+
+/*
+ * Typedef: LdvLogRecord
+ *
+ * LdvLogRecord holds one logged frame or segment. 'timestamp' is the time
+ * of the record in microseconds of CLOCK_MONOTONIC. 'sequence' numbers the
+ * records of one log, starting with one. 'id' is the frame's Id.
+ *
+ * 'data' holds the frame's header (length and command), its extended
+ * header (index and reserved) and its payload, in this order. The payload
+ * is only recorded for the segments which include it, LDV_LOG_PAYLOAD and
+ * LDV_LOG_FRAME.
+ */
+typedef struct {
+    uint64_t timestamp;
+    uint32_t sequence;
+    uint16_t id;
+    uint8_t direction;
+    uint8_t segment;
+    uint8_t data[LDV_LOG_DATA];
+} LdvLogRecord;
+
+/*
+ * Typedef: LdvLogFileHeader
+ *
+ * LdvLogFileHeader starts a log file written with <LdvLogDump>. 'count'
+ * records of 'size' bytes follow, oldest first. 'lost' is the number of
+ * records which were overwritten before the log was written.
+ */
+#define LDV_LOG_MAGIC   0x4C56444Cu     /* "LDVL" */
+#define LDV_LOG_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    uint32_t count;
+    uint32_t lost;
+} LdvLogFileHeader;
+
+/*
+ * Typedef: LdvLogHandle
+ *
+ * This type is used to identify a given log. It is returned from
+ * <LdvLogOpen> and used when calling all other LdvLog* API.
+ */
+typedef unsigned long LdvLogHandle;
+
+/*
+ * Function: LdvLogOpen
+ *
+ * LdvLogOpen() creates a log with room for the given number of records,
+ * rounded up to the next power of two. When the log is full, each new
+ * record overwrites the oldest.
+ *
+ * A log has exactly one writer thread, which calls <LdvLogNext> and
+ * <LdvLogCommit>. Writing a record takes no lock and makes no system call.
+ * Any thread may call <LdvLogDump> at any time.
+ *
+ * Parameters:
+ * records - the minimum number of records the log can hold.
+ *
+ * Result:
+ * <LdvLogHandle>, or 0 in case of failure.
+ */
+extern LdvLogHandle LdvLogOpen(unsigned records);
+
+/*
+ * Function: LdvLogClose
+ *
+ * When done, call LdvLogClose(). The handle may not be used after this.
+ *
+ * Parameters:
+ * handle - log handle, as obtained from <LdvLogOpen>.
+ */
+extern void LdvLogClose(LdvLogHandle handle);
+
+/*
+ * Function: LdvLogNext
+ *
+ * LdvLogNext() returns the record to fill in next. The writer fills in all
+ * fields except the 'sequence', then publishes the record with
+ * <LdvLogCommit>.
+ *
+ * Parameters:
+ * handle - log handle, as obtained from <LdvLogOpen>.
+ *
+ * Returns:
+ * A pointer to the <LdvLogRecord>.
+ */
+extern LdvLogRecord* LdvLogNext(LdvLogHandle handle);
+
+/*
+ * Function: LdvLogCommit
+ *
+ * LdvLogCommit() publishes the record most recently returned by
+ * <LdvLogNext>.
+ *
+ * Parameters:
+ * handle - log handle, as obtained from <LdvLogOpen>.
+ */
+extern void LdvLogCommit(LdvLogHandle handle);
+
+/*
+ * Function: LdvLogDump
+ *
+ * LdvLogDump() writes the records currently held by the log to a file, as
+ * a <LdvLogFileHeader> followed by the records. Records which the writer
+ * overwrites while they are copied are omitted.
+ *
+ * Parameters:
+ * handle - log handle, as obtained from <LdvLogOpen>.
+ * fd - the file descriptor to write to.
+ *
+ * Returns:
+ * Zero on success, -1 with errno set in case of failure.
+ */
+extern int LdvLogDump(LdvLogHandle handle, int fd);
+
+/*
+ * Function: LdvLogFormat
+ *
+ * LdvLogFormat() renders a record as text, in the format of the driver's
+ * frame trace: the direction (UP or DN), the frame Id, the header (H:),
+ * the extended header (X:) if the segment includes it and the payload
+ * (P:) if the segment includes it, for example
+ * "DN.00012 H:0x02.12 P:0x01.02". No newline is appended.
+ *
+ * Parameters:
+ * record - the record.
+ * buffer - output parameter, at least LDV_LOG_TEXT bytes.
+ *
+ * Returns:
+ * The length of the text.
+ */
+extern size_t LdvLogFormat(const LdvLogRecord* record, char* buffer);
+
+#endif  // IZOT_SHORTSTACK_LDVLOG_H
@@ -22,6 +22,26 @@
  * implementation allocates frame buffers off the heap and therefore has
  * virtually unlimited buffers in either direction.
  *
+ * Queues created with LdvqOpenRing() use a different strategy: a bounded
+ * ring of frame pointers, shared by exactly one producer and one consumer
+ * thread. The ring indices are maintained with atomic operations only, so
+ * that pushing, popping and testing the queue requires neither a mutex
+ * nor a heap allocation. This suits a driver's uplink and downlink queues,
+ * which connect the driver's I/O thread with the thread that runs the
+ * ShortStack event handler.
+ *
+ * The producer may also pop frames off a ring queue, for example to make
+ * room by discarding the oldest frame. The head index is therefore advanced
+ * with a compare-and-swap operation, which settles the race between the
+ * producer and the consumer for the same frame.
+ *
+ * Each ring queue also owns a slab of frame buffers, one per ring slot,
+ * which is allocated when the queue is opened. LdvqAlloc() and LdvqFree()
+ * take frames from and return frames to a lock-free free list within this
+ * slab, so that a ring queue makes no heap allocations after LdvqOpenRing()
+ * returns. The counters reported by LdvqGetStatistics() can be used to
+ * confirm this.
+ *
  * Some implementations may wish to use the heap but limit the number of
  * frame buffers to a configured maximum. This example supports such a
  * configuration with the MAX_FRAMES definition, below.
@@ -34,11 +54,19 @@
  * available buffer space adn may need to re-attempt the sending of output
  * values or application messages later in time.
  *
+ * LdvqAllocWait() blocks the caller until a frame becomes available. The
+ * waiting threads form a FIFO list, protected by the queue's mutex, and
+ * sleep on a condition variable which the releasing thread signals. The
+ * releasing thread takes the mutex only while a thread is waiting, so
+ * that LdvqFree() remains lock-free for ring queues otherwise.
+ *
  * License:
  * Use of the source code contained in this file is subject to the terms
  * of the Echelon Example Software License Agreement which is available at
  * www.echelon.com/license/examplesoftware/.
  */
+#include <errno.h>
+#include <limits.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -46,6 +74,7 @@
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "ldvq.h"
@@ -54,7 +83,8 @@
  * Macro: MAX_FRAMES
  *
  * Set to 0 for unlimited use of the heap, set to N to limit the number of
- * frame buffers per queue to N.
+ * frame buffers per queue to N. Queues created with LdvqOpenRing() are
+ * limited by their capacity instead.
  * When all configured buffers are in use, further API invocations which
  * require a buffer fail with an appropriate error code.
  * Typical driver implementations require two queues, one for each direction.
@@ -69,20 +99,302 @@ typedef struct QItem {
     LonSmipMsg* data;
 } QItem;
 
+/*
+ * Waiter represents one thread blocked in LdvqAllocWait(). It lives on the
+ * waiting thread's stack.
+ */
+typedef struct Waiter {
+    struct Waiter* next;
+} Waiter;
+
+/*
+ * Macro: CACHE_LINE
+ *
+ * The ring's producer and consumer indices are kept in separate cache lines
+ * so that the two threads do not compete for the same line with every push
+ * and pop.
+ */
+#define CACHE_LINE  64
+
 /*
  * QCtrl is the queue control data. The queue handle obtained from LdvqOpen
  * is a pointer to this structure, cast to a suitable scalar base type
  * (<LdvqHandle>) to isolate this definition from the calling layers.
  */
-typedef struct {
+typedef struct QCtrl {
     QItem* head;
     QItem* tail;
     pthread_mutex_t mutex;
-#if MAX_FRAMES
-    unsigned allocated;
-#endif
+
+    /*
+     * The queue which owns the frame pool. This is the queue itself, unless
+     * the queue is a lane created with LdvqOpenLane(). All allocation and
+     * release operations are directed to the owner.
+     */
+    struct QCtrl* owner;
+
+    /*
+     * Queue depth counters, reported with LdvqGetLaneStatistics(). The
+     * depth of a list queue is maintained with the list; the depth of a
+     * ring queue is derived from its indices.
+     */
+    struct {
+        unsigned depth;
+        unsigned highWater;
+        unsigned long frames;
+    } lane;
+
+    /*
+     * Allocation counters, reported with LdvqGetStatistics(). The number of
+     * frames allocated is updated by the allocating and the releasing
+     * thread, and always with atomic operations.
+     */
+    LdvQueueStatistics stats;
+
+    /*
+     * The ring is used by queues created with LdvqOpenRing(). The capacity
+     * is a power of two, and zero for linked-list queues. The indices run
+     * freely and are masked with (capacity - 1) when used. The tail is
+     * only written by the producer. The head is advanced by the consumer,
+     * and also by the producer when it pops the oldest frame of a full
+     * ring to discard it. Both advance the head with a compare-and-swap,
+     * and a frame read from a slot belongs to the thread whose exchange
+     * succeeds; see LdvqPop().
+     */
+    struct {
+        LonSmipMsg** slot;
+        unsigned capacity;
+        unsigned head __attribute__((aligned(CACHE_LINE)));
+        unsigned tail __attribute__((aligned(CACHE_LINE)));
+    } ring;
+
+    /*
+     * The frame pool of a ring queue. The free list is a stack of indices
+     * into the slab, linked through the 'next' array. The top of the stack
+     * holds the index of the first free frame plus one (zero when the pool
+     * is exhausted) in its lower 32 bits, and a modification count in its
+     * upper 32 bits. The modification count protects the compare-and-swap
+     * operations from the ABA problem.
+     */
+    struct {
+        LonSmipMsg* slab;
+        unsigned* next;
+        uint64_t top __attribute__((aligned(CACHE_LINE)));
+    } pool;
+
+    /*
+     * An optional event file descriptor, signalled when a push operation
+     * makes the queue non-empty. See LdvqNotify(). -1 if not used.
+     */
+    int notify;
+
+    /*
+     * The threads blocked in LdvqAllocWait(), oldest first. The list and
+     * the signal count are protected by the queue's mutex. 'count' is the
+     * number of waiters; releasing threads test it without the mutex. The
+     * signal count is incremented whenever waiters are woken, so that a
+     * waiter can detect a release which occurred after its last attempt.
+     */
+    struct {
+        Waiter* head;
+        Waiter* tail;
+        pthread_cond_t cond;
+        unsigned count;
+        unsigned long signals;
+    } wait;
 } QCtrl;
 
+#define IS_RING(q)  ((q)->ring.capacity != 0)
+
+/*
+ * FRAME_LIMIT yields the maximum number of frames which may be allocated
+ * for a given queue at any one time. Ring queues are always limited to
+ * their capacity.
+ */
+#if MAX_FRAMES
+#   define FRAME_LIMIT(q)  (IS_RING(q) ? (q)->ring.capacity : MAX_FRAMES)
+#else
+#   define FRAME_LIMIT(q)  (IS_RING(q) ? (q)->ring.capacity : UINT_MAX)
+#endif  // MAX_FRAMES
+
+/*
+ * Signal() signals the queue's event file descriptor.
+ */
+static void Signal(QCtrl* q)
+{
+    const uint64_t increment = 1;
+    (void) write(q->notify, &increment, sizeof(increment));
+}
+
+/*
+ * PoolTop() composes a new value for the top of the free list stack from
+ * the previous value and the index (plus one) of the new top element.
+ */
+static uint64_t PoolTop(uint64_t previous, unsigned index)
+{
+    return (((previous >> 32) + 1) << 32) | index;
+}
+
+/*
+ * PoolGet() takes a frame off the free list, or returns NULL if the pool
+ * is exhausted.
+ */
+static LonSmipMsg* PoolGet(QCtrl* q)
+{
+    LonSmipMsg* result = NULL;
+    uint64_t top = __atomic_load_n(&q->pool.top, __ATOMIC_ACQUIRE);
+    unsigned index = (unsigned) top;
+
+    while (index && result == NULL) {
+        unsigned next = __atomic_load_n(&q->pool.next[index - 1], __ATOMIC_RELAXED);
+
+        if (__atomic_compare_exchange_n(
+                &q->pool.top, &top, PoolTop(top, next), 1,
+                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            result = &q->pool.slab[index - 1];
+        } else {
+            index = (unsigned) top;
+        }
+    }
+
+    return result;
+}
+
+/*
+ * PoolPut() returns a frame to the free list.
+ */
+static void PoolPut(QCtrl* q, LonSmipMsg* frame)
+{
+    unsigned index = (unsigned)(frame - q->pool.slab) + 1;
+    uint64_t top = __atomic_load_n(&q->pool.top, __ATOMIC_RELAXED);
+
+    do {
+        __atomic_store_n(&q->pool.next[index - 1], (unsigned) top, __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(
+                 &q->pool.top, &top, PoolTop(top, index), 1,
+                 __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*
+ * PoolPutMany() returns several frames to the free list. The frames are
+ * chained together first, so that the list's top is updated only once.
+ */
+static void PoolPutMany(QCtrl* q, LonSmipMsg* frames[], unsigned count)
+{
+    unsigned first = (unsigned)(frames[0] - q->pool.slab) + 1;
+    unsigned last = first;
+    unsigned i;
+    uint64_t top;
+
+    for (i = 1; i < count; ++i) {
+        unsigned index = (unsigned)(frames[i] - q->pool.slab) + 1;
+        __atomic_store_n(&q->pool.next[last - 1], index, __ATOMIC_RELAXED);
+        last = index;
+    }
+
+    top = __atomic_load_n(&q->pool.top, __ATOMIC_RELAXED);
+
+    do {
+        __atomic_store_n(&q->pool.next[last - 1], (unsigned) top, __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(
+                 &q->pool.top, &top, PoolTop(top, first), 1,
+                 __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*
+ * CountRelease() maintains the allocation counter after 'count' frames
+ * have been released.
+ */
+static void CountRelease(QCtrl* q, unsigned count)
+{
+    /*
+     * This should be balanced but we cannot allow an underflow in
+     * any circumstances.
+     */
+    unsigned allocated = __atomic_load_n(&q->stats.allocated, __ATOMIC_RELAXED);
+
+    while (allocated
+    && !__atomic_compare_exchange_n(
+            &q->stats.allocated, &allocated,
+            allocated > count ? allocated - count : 0, 1,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        /* allocated has been reloaded; try again. */
+    }
+}
+
+/*
+ * CountAllocation() maintains the allocation counters after a successful
+ * allocation. 'allocated' is the number of frames now allocated.
+ */
+static void CountAllocation(QCtrl* q, unsigned allocated)
+{
+    unsigned high_water = __atomic_load_n(&q->stats.highWater, __ATOMIC_RELAXED);
+
+    while (allocated > high_water
+    && !__atomic_compare_exchange_n(
+            &q->stats.highWater, &high_water, allocated, 1,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        /* high_water has been reloaded; try again. */
+    }
+
+    __atomic_add_fetch(&q->stats.allocations, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Take() allocates a frame without initializing it, and maintains the
+ * allocation counters. Take() returns NULL if no frame is available, but
+ * does not count this as a failure.
+ */
+static LonSmipMsg* Take(QCtrl* q)
+{
+    LonSmipMsg* new_frame = NULL;
+    unsigned allocated = 0;
+
+    if (IS_RING(q)) {
+        new_frame = PoolGet(q);
+
+        if (new_frame) {
+            allocated = __atomic_add_fetch(&q->stats.allocated, 1, __ATOMIC_RELAXED);
+        }
+    } else {
+        pthread_mutex_lock(&q->mutex);
+
+        if (q->stats.allocated < FRAME_LIMIT(q)) {
+            new_frame = (LonSmipMsg*) malloc(sizeof(LonSmipMsg));
+        }
+
+        if (new_frame) {
+            q->stats.heap += 1;
+            allocated = __atomic_add_fetch(&q->stats.allocated, 1, __ATOMIC_RELAXED);
+        }
+
+        pthread_mutex_unlock(&q->mutex);
+    }
+
+    if (new_frame) {
+        CountAllocation(q, allocated);
+    }
+
+    return new_frame;
+}
+
+/*
+ * Wake() wakes the threads waiting in LdvqAllocWait(), if any, after frames
+ * have been released. The fence orders the release before the test for
+ * waiters; LdvqAllocWait() registers a waiter before it tests for a frame.
+ */
+static void Wake(QCtrl* q)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&q->wait.count, __ATOMIC_RELAXED)) {
+        pthread_mutex_lock(&q->mutex);
+        q->wait.signals += 1;
+        pthread_cond_broadcast(&q->wait.cond);
+        pthread_mutex_unlock(&q->mutex);
+    }
+}
+
 /*
  * To use this simple queue, create one with LdvqOpen() and keep the handle
  * returned. LdvqOpen() returns 0 for failure.
@@ -92,13 +404,100 @@ LdvqHandle LdvqOpen(void)
     QCtrl* q = (QCtrl*) malloc(sizeof(QCtrl));
 
     if (q) {
+        pthread_condattr_t attributes;
+
         memset(q, 0, sizeof(QCtrl));
         pthread_mutex_init(&q->mutex, NULL);
+        pthread_condattr_init(&attributes);
+        pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+        pthread_cond_init(&q->wait.cond, &attributes);
+        pthread_condattr_destroy(&attributes);
+        q->owner = q;
+        q->notify = -1;
+        q->stats.capacity = MAX_FRAMES;
+        q->stats.heap = 1;
     }
 
     return (LdvqHandle) q;
 }   // LdvqOpen
 
+/*
+ * LdvqOpenRing() creates a bounded single-producer, single-consumer queue
+ * with room for at least 'capacity' frames, and the pool of frames for use
+ * with this queue. Because the pool holds no more frames than the ring,
+ * pushing an allocated frame can never fail for lack of space.
+ */
+LdvqHandle LdvqOpenRing(unsigned capacity)
+{
+    QCtrl* q = (QCtrl*) LdvqOpen();
+
+    if (q) {
+        unsigned size = 1;
+
+        /* The size becomes zero if no power of two fits an unsigned. */
+        while (size && size < capacity) {
+            size <<= 1;
+        }
+
+        q->ring.slot = (LonSmipMsg**) calloc(size, sizeof(LonSmipMsg*));
+        q->pool.slab = (LonSmipMsg*) calloc(size, sizeof(LonSmipMsg));
+        q->pool.next = (unsigned*) calloc(size, sizeof(unsigned));
+        q->stats.heap += 3;
+
+        if (size && q->ring.slot && q->pool.slab && q->pool.next) {
+            q->ring.capacity = size;
+            q->stats.capacity = size;
+
+            for (unsigned i = 0; i < size; ++i) {
+                PoolPut(q, &q->pool.slab[i]);
+            }
+        } else {
+            LdvqClose((LdvqHandle) q);
+            q = NULL;
+        }
+    }
+
+    return (LdvqHandle) q;
+}   // LdvqOpenRing
+
+/*
+ * LdvqOpenLane() creates another ring queue which uses the frame pool of
+ * an existing ring queue. Frames allocated from either queue may be pushed
+ * to either queue; both queues must be served by the same producer and
+ * the same consumer thread.
+ */
+LdvqHandle LdvqOpenLane(LdvqHandle owner, unsigned capacity)
+{
+    QCtrl* pool = (QCtrl*) owner;
+    QCtrl* q = NULL;
+
+    if (pool && IS_RING(pool)) {
+        q = (QCtrl*) LdvqOpen();
+    }
+
+    if (q) {
+        unsigned size = 1;
+
+        /* The size becomes zero if no power of two fits an unsigned. */
+        while (size && size < capacity) {
+            size <<= 1;
+        }
+
+        q->ring.slot = (LonSmipMsg**) calloc(size, sizeof(LonSmipMsg*));
+        q->stats.heap += 1;
+
+        if (size && q->ring.slot) {
+            q->ring.capacity = size;
+            q->owner = pool->owner;
+        } else {
+            LdvqClose((LdvqHandle) q);
+            q = NULL;
+        }
+    }
+
+    return (LdvqHandle) q;
+}   // LdvqOpenLane
+
 /*
  * When done, call LdvqClose(). The handle may not be used after this.
  * Because the function destroys the queue (and any remaining data),
@@ -119,6 +518,10 @@ void LdvqClose(LdvqHandle handle)
             current = next;
         }
 
+        free(q->ring.slot);
+        free(q->pool.slab);
+        free(q->pool.next);
+        pthread_cond_destroy(&q->wait.cond);
         pthread_mutex_destroy(&q->mutex);
     }
 
@@ -134,15 +537,62 @@ LonApiError LdvqPush(LdvqHandle handle, LonSmipMsg* data)
     LonApiError result = LonApiNoError;
     QCtrl* q = (QCtrl*) handle;
 
-    if (q) {
+    if (q && IS_RING(q)) {
+        /*
+         * Only the producer writes the tail, so a relaxed load is enough.
+         * The acquire load of the head pairs with the consumer's release
+         * store, which guarantees that the consumer is done with the slot
+         * before it is overwritten here.
+         */
+        unsigned tail = __atomic_load_n(&q->ring.tail, __ATOMIC_RELAXED);
+        unsigned head = __atomic_load_n(&q->ring.head, __ATOMIC_ACQUIRE);
+
+        if (tail - head < q->ring.capacity) {
+            __atomic_store_n(&q->ring.slot[tail & (q->ring.capacity - 1)], data, __ATOMIC_RELAXED);
+            __atomic_store_n(&q->ring.tail, tail + 1, __ATOMIC_RELEASE);
+
+            /* Only the producer writes the depth counters. */
+            if (tail + 1 - head > q->lane.highWater) {
+                __atomic_store_n(&q->lane.highWater, tail + 1 - head, __ATOMIC_RELAXED);
+            }
+
+            __atomic_store_n(&q->lane.frames, q->lane.frames + 1, __ATOMIC_RELAXED);
+
+            if (q->notify != -1) {
+                /*
+                 * Determine whether this push made the queue non-empty.
+                 * The full fence orders the tail store before the head
+                 * load, and pairs with the fence in LdvqEmpty(): either the
+                 * consumer sees this frame, or this producer sees that the
+                 * consumer has taken all frames before this one and signals.
+                 */
+                __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+                if (__atomic_load_n(&q->ring.head, __ATOMIC_RELAXED) == tail) {
+                    Signal(q);
+                }
+            }
+        } else {
+            result = LonApiTxBufIsFull;
+        }
+    } else if (q) {
         QItem* item = (QItem*) malloc(sizeof(QItem));
 
         if (item) {
+            int signal = FALSE;
 
             pthread_mutex_lock(&q->mutex);
 
             item->data = data;
             item->next = NULL;
+            q->stats.heap += 1;
+
+            q->lane.depth += 1;
+            q->lane.frames += 1;
+
+            if (q->lane.depth > q->lane.highWater) {
+                q->lane.highWater = q->lane.depth;
+            }
 
             if (q->tail) {
                 q->tail->next = item;
@@ -152,9 +602,14 @@ LonApiError LdvqPush(LdvqHandle handle, LonSmipMsg* data)
 
             if (q->head == NULL) {
                 q->head = item;
+                signal = q->notify != -1;
             }
 
             pthread_mutex_unlock(&q->mutex);
+
+            if (signal) {
+                Signal(q);
+            }
         } else {
             result = LonApiTxBufIsFull;
         }
@@ -172,7 +627,7 @@ LonApiError LdvqPush(LdvqHandle handle, LonSmipMsg* data)
 LonApiError LdvqCopy(LdvqHandle handle, LonSmipMsg* data)
 {
     LonSmipMsg* duplicate = NULL;
-    LonApiError result = LdvqAlloc(handle, &duplicate);
+    LonApiError result = LdvqAllocRaw(handle, &duplicate);
 
     if (result == LonApiNoError) {
         memcpy(duplicate, data, sizeof(LonSmipMsg));
@@ -190,7 +645,25 @@ LonSmipMsg* LdvqPop(LdvqHandle handle)
     LonSmipMsg* result = NULL;
     QCtrl* q = (QCtrl*) handle;
 
-    if (q) {
+    if (q && IS_RING(q)) {
+        unsigned head = __atomic_load_n(&q->ring.head, __ATOMIC_ACQUIRE);
+
+        while (head != __atomic_load_n(&q->ring.tail, __ATOMIC_ACQUIRE)) {
+            /*
+             * The slot is only ours if the head is still unchanged; if not,
+             * another thread has taken the frame and the head is reloaded.
+             */
+            result = __atomic_load_n(&q->ring.slot[head & (q->ring.capacity - 1)], __ATOMIC_RELAXED);
+
+            if (__atomic_compare_exchange_n(
+                    &q->ring.head, &head, head + 1, 1,
+                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+
+            result = NULL;
+        }
+    } else if (q) {
         QItem* item = NULL;
 
         pthread_mutex_lock(&q->mutex);
@@ -198,6 +671,7 @@ LonSmipMsg* LdvqPop(LdvqHandle handle)
 
         if (item) {
             q->head = item->next;
+            q->lane.depth -= 1;
 
             if (q->tail == item) {
                 q->tail = NULL;
@@ -213,54 +687,246 @@ LonSmipMsg* LdvqPop(LdvqHandle handle)
     return result;
 }   // LdvqPop
 
+/*
+ * Use LdvqPopMany() to pop up to 'count' frames off the head of the queue.
+ * A ring queue reads the producer's index and advances its head once for
+ * the entire batch; a list queue takes its mutex once.
+ */
+unsigned LdvqPopMany(LdvqHandle handle, LonSmipMsg* frames[], unsigned count)
+{
+    unsigned result = 0;
+    QCtrl* q = (QCtrl*) handle;
+
+    if (q && IS_RING(q)) {
+        unsigned head = __atomic_load_n(&q->ring.head, __ATOMIC_ACQUIRE);
+        int taken = FALSE;
+
+        while (!taken) {
+            unsigned tail = __atomic_load_n(&q->ring.tail, __ATOMIC_ACQUIRE);
+
+            for (result = 0; result < count && head + result != tail; ++result) {
+                frames[result] = __atomic_load_n(
+                                     &q->ring.slot[(head + result) & (q->ring.capacity - 1)],
+                                     __ATOMIC_RELAXED);
+            }
+
+            /* As in LdvqPop(), the frames are only ours if the head is unchanged. */
+            taken = result == 0
+                    || __atomic_compare_exchange_n(
+                        &q->ring.head, &head, head + result, 1,
+                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+        }
+    } else if (q) {
+        pthread_mutex_lock(&q->mutex);
+
+        while (result < count && q->head) {
+            QItem* item = q->head;
+
+            q->head = item->next;
+            q->lane.depth -= 1;
+            frames[result++] = item->data;
+            free(item);
+        }
+
+        if (q->head == NULL) {
+            q->tail = NULL;
+        }
+
+        pthread_mutex_unlock(&q->mutex);
+    }
+
+    return result;
+}   // LdvqPopMany
+
 /*
  * Use LdvqEmpty to determine whether the queue is empty.
  */
 int LdvqEmpty(LdvqHandle handle)
 {
-    int result = 0;
+    int result = 1;
     QCtrl* q = (QCtrl*) handle;
 
-    if (q) {
+    if (q && IS_RING(q)) {
+        /* See LdvqPush() for the purpose of this fence. */
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        result = __atomic_load_n(&q->ring.head, __ATOMIC_ACQUIRE)
+                 == __atomic_load_n(&q->ring.tail, __ATOMIC_ACQUIRE);
+    } else if (q) {
         pthread_mutex_lock(&q->mutex);
-        result = q->head != NULL;
+        result = q->head == NULL;
         pthread_mutex_unlock(&q->mutex);
     }
 
     return result;
 }   // LdvqEmpty
 
-LonApiError LdvqAlloc(LdvqHandle handle, LonSmipMsg** frame_pointer)
+/*
+ * LdvqAllocRaw() allocates a frame buffer like LdvqAlloc(), but does not
+ * initialize its contents. This is used when the caller overwrites the
+ * entire frame anyway.
+ */
+LonApiError LdvqAllocRaw(LdvqHandle handle, LonSmipMsg** frame_pointer)
 {
-    static uint16_t frame_number = 0;
     LonApiError result = LonApiNoError;
-
-#if MAX_FRAMES
     LonSmipMsg* new_frame = NULL;
-    QCtrl* q = (QCtrl*) handle;
+    QCtrl* q = handle ? ((QCtrl*) handle)->owner : NULL;
 
     if (q) {
+        new_frame = Take(q);
+    }
+
+    if (new_frame) {
+        *frame_pointer = new_frame;
+    } else {
+        if (q) {
+            __atomic_add_fetch(&q->stats.failures, 1, __ATOMIC_RELAXED);
+        }
+
+        result = LonApiTxBufIsFull;
+    }
+
+    return result;
+}
+
+/*
+ * NextFrameNumber() yields the quasi-unique Id for a new frame.
+ */
+static uint16_t NextFrameNumber(void)
+{
+    static uint16_t frame_number = 0;
+    return ++frame_number;
+}
+
+LonApiError LdvqAlloc(LdvqHandle handle, LonSmipMsg** frame_pointer)
+{
+    LonApiError result = LdvqAllocRaw(handle, frame_pointer);
+
+    if (result == LonApiNoError) {
+        memset(*frame_pointer, 0, sizeof(LonSmipMsg));
+        (*frame_pointer)->Id = NextFrameNumber();
+    }
+
+    return result;
+}
+
+/*
+ * LdvqAllocWait() allocates a frame buffer like LdvqAlloc(), waiting up to
+ * 'timeout' milliseconds for a frame to be released if necessary. A new
+ * caller takes a frame at once only while no other thread is waiting;
+ * otherwise it joins the end of the list of waiters, and only the oldest
+ * waiter takes the next frame released.
+ */
+LonApiError LdvqAllocWait(LdvqHandle handle, LonSmipMsg** frame_pointer, unsigned timeout)
+{
+    LonApiError result = LonApiNoError;
+    LonSmipMsg* new_frame = NULL;
+    QCtrl* q = handle ? ((QCtrl*) handle)->owner : NULL;
+
+    if (q && __atomic_load_n(&q->wait.count, __ATOMIC_RELAXED) == 0) {
+        new_frame = Take(q);
+    }
+
+    if (q && new_frame == NULL) {
+        Waiter self = { NULL };
+        struct timespec deadline;
+        int expired = 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout / 1000;
+        deadline.tv_nsec += (long)(timeout % 1000) * 1000000L;
+
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        /*
+         * Join the end of the list of waiters.
+         */
         pthread_mutex_lock(&q->mutex);
 
-        if (q->allocated < MAX_FRAMES) {
-            new_frame = (LonSmipMsg*) malloc(sizeof(LonSmipMsg));
+        if (q->wait.tail) {
+            q->wait.tail->next = &self;
+        } else {
+            q->wait.head = &self;
         }
 
-        if (new_frame) {
-            q->allocated += 1;
+        q->wait.tail = &self;
+        __atomic_add_fetch(&q->wait.count, 1, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&q->mutex);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        while (new_frame == NULL && !expired) {
+            unsigned long signals;
+            int first;
+
+            pthread_mutex_lock(&q->mutex);
+            signals = q->wait.signals;
+            first = q->wait.head == &self;
+            pthread_mutex_unlock(&q->mutex);
+
+            if (first) {
+                new_frame = Take(q);
+            }
+
+            if (new_frame == NULL) {
+                /*
+                 * Sleep until frames are released after the attempt above,
+                 * or until another waiter leaves the list.
+                 */
+                pthread_mutex_lock(&q->mutex);
+
+                while (signals == q->wait.signals && !expired) {
+                    if (timeout) {
+                        expired = pthread_cond_timedwait(&q->wait.cond, &q->mutex, &deadline)
+                                  == ETIMEDOUT;
+                    } else {
+                        pthread_cond_wait(&q->wait.cond, &q->mutex);
+                    }
+                }
+
+                pthread_mutex_unlock(&q->mutex);
+            }
         }
 
+        /*
+         * Leave the list, and let the next waiter try.
+         */
+        pthread_mutex_lock(&q->mutex);
+
+        if (q->wait.head == &self) {
+            q->wait.head = self.next;
+        } else {
+            Waiter* previous = q->wait.head;
+
+            while (previous->next != &self) {
+                previous = previous->next;
+            }
+
+            previous->next = self.next;
+
+            if (self.next == NULL) {
+                q->wait.tail = previous;
+            }
+        }
+
+        if (q->wait.head == NULL) {
+            q->wait.tail = NULL;
+        }
+
+        __atomic_sub_fetch(&q->wait.count, 1, __ATOMIC_RELAXED);
+        q->wait.signals += 1;
+        pthread_cond_broadcast(&q->wait.cond);
         pthread_mutex_unlock(&q->mutex);
     }
 
-#else
-    LonSmipMsg* new_frame = (LonSmipMsg*)malloc(sizeof(LonSmipMsg));
-#endif  // MAX_FRAMES
-
     if (new_frame) {
-        *frame_pointer = new_frame;
         memset(new_frame, 0, sizeof(LonSmipMsg));
-        new_frame->Id = ++frame_number;
+        new_frame->Id = NextFrameNumber();
+        *frame_pointer = new_frame;
+    } else if (q) {
+        __atomic_add_fetch(&q->stats.failures, 1, __ATOMIC_RELAXED);
+        result = LonApiTimeout;
     } else {
         result = LonApiTxBufIsFull;
     }
@@ -273,28 +939,112 @@ LonApiError LdvqFree(LdvqHandle handle, LonSmipMsg* frame)
     LonApiError result = LonApiNoError;
 
     if (frame) {
-#if MAX_FRAMES
-        QCtrl* q = (QCtrl*) handle;
+        QCtrl* q = handle ? ((QCtrl*) handle)->owner : NULL;
 
         if (q) {
-            pthread_mutex_lock(&q->mutex);
+            CountRelease(q, 1);
 
-            if (q->allocated) {
-                /*
-                 * This should be balanced but we cannot allow an
-                 * underflow in any circumstances.
-                 */
-                q->allocated -= 1;
+            if (IS_RING(q)) {
+                PoolPut(q, frame);
+            } else {
+                free(frame);
             }
 
-            pthread_mutex_unlock(&q->mutex);
+            Wake(q);
+        }
+    }
 
-            free(frame);
+    return result;
+}
+
+LonApiError LdvqFreeMany(LdvqHandle handle, LonSmipMsg* frames[], unsigned count)
+{
+    LonApiError result = LonApiNoError;
+    QCtrl* q = handle ? ((QCtrl*) handle)->owner : NULL;
+    unsigned used = 0;
+    unsigned i;
+
+    if (q) {
+        /* Compact the array, dropping NULL entries. */
+        for (i = 0; i < count; ++i) {
+            if (frames[i]) {
+                frames[used++] = frames[i];
+            }
         }
 
-#else
-        free(frame);
-#endif  //  MAX_FRAMES
+        if (used) {
+            CountRelease(q, used);
+
+            if (IS_RING(q)) {
+                PoolPutMany(q, frames, used);
+            } else {
+                for (i = 0; i < used; ++i) {
+                    free(frames[i]);
+                }
+            }
+
+            Wake(q);
+        }
+    }
+
+    return result;
+}
+
+/*
+ * LdvqNotify() registers an event file descriptor with the queue. The queue
+ * writes to this descriptor when a push makes the queue non-empty.
+ */
+LonApiError LdvqNotify(LdvqHandle handle, int fd)
+{
+    LonApiError result = LonApiNoError;
+    QCtrl* q = (QCtrl*) handle;
+
+    if (q) {
+        q->notify = fd;
+    } else {
+        result = LonApiQueueNotOpen;
+    }
+
+    return result;
+}
+
+LonApiError LdvqGetStatistics(LdvqHandle handle, LdvQueueStatistics* stats)
+{
+    LonApiError result = LonApiNoError;
+    QCtrl* q = (QCtrl*) handle;
+
+    if (q) {
+        stats->capacity = q->stats.capacity;
+        stats->allocated = __atomic_load_n(&q->stats.allocated, __ATOMIC_RELAXED);
+        stats->highWater = __atomic_load_n(&q->stats.highWater, __ATOMIC_RELAXED);
+        stats->allocations = __atomic_load_n(&q->stats.allocations, __ATOMIC_RELAXED);
+        stats->failures = __atomic_load_n(&q->stats.failures, __ATOMIC_RELAXED);
+        stats->heap = q->stats.heap;
+    } else {
+        result = LonApiQueueNotOpen;
+    }
+
+    return result;
+}
+
+LonApiError LdvqGetLaneStatistics(LdvqHandle handle, LdvLaneStatistics* stats)
+{
+    LonApiError result = LonApiNoError;
+    QCtrl* q = (QCtrl*) handle;
+
+    if (q && IS_RING(q)) {
+        stats->depth = __atomic_load_n(&q->ring.tail, __ATOMIC_RELAXED)
+                       - __atomic_load_n(&q->ring.head, __ATOMIC_RELAXED);
+        stats->highWater = __atomic_load_n(&q->lane.highWater, __ATOMIC_RELAXED);
+        stats->frames = __atomic_load_n(&q->lane.frames, __ATOMIC_RELAXED);
+    } else if (q) {
+        pthread_mutex_lock(&q->mutex);
+        stats->depth = q->lane.depth;
+        stats->highWater = q->lane.highWater;
+        stats->frames = q->lane.frames;
+        pthread_mutex_unlock(&q->mutex);
+    } else {
+        result = LonApiQueueNotOpen;
     }
 
     return result;
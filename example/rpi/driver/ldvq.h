@@ -49,6 +49,51 @@ typedef unsigned long LdvqHandle;
  */
 extern LdvqHandle LdvqOpen(void);
 
+/*
+ * Function: LdvqOpenRing
+ *
+ * LdvqOpenRing() creates a bounded queue for use by exactly one producer
+ * thread (which calls <LdvqPush> or <LdvqCopy>) and one consumer thread
+ * (which calls <LdvqPop> and <LdvqEmpty>). These operations use atomic
+ * operations only; they take no lock and do not allocate memory. The
+ * producer may also call <LdvqPop> to discard the oldest frame.
+ *
+ * The capacity is rounded up to the next power of two. It also limits the
+ * number of frames which can be allocated with <LdvqAlloc> for this queue.
+ * All other Ldvq* API apply to this queue as to any other. LdvqOpenRing()
+ * returns 0 for failure.
+ *
+ * Parameters:
+ * capacity - the minimum number of frames the queue can hold
+ *
+ * Result:
+ * <LdvqHandle>.
+ */
+extern LdvqHandle LdvqOpenRing(unsigned capacity);
+
+/*
+ * Function: LdvqOpenLane
+ *
+ * LdvqOpenLane() creates another bounded queue like <LdvqOpenRing>, but
+ * without a frame pool of its own. The new queue, or lane, shares the frame
+ * pool of an existing ring queue. Frames allocated from any of these queues
+ * may be pushed to any of them, and may be released to any of them.
+ *
+ * This allows one producer thread to sort frames into several lanes which
+ * the consumer thread serves in order of priority, while the total number
+ * of frames remains limited by the capacity of the owning queue.
+ *
+ * Close all lanes before closing the owning queue.
+ *
+ * Parameters:
+ * owner - handle of the ring queue which owns the frame pool.
+ * capacity - the minimum number of frames the lane can hold.
+ *
+ * Result:
+ * <LdvqHandle>, or 0 in case of failure.
+ */
+extern LdvqHandle LdvqOpenLane(LdvqHandle owner, unsigned capacity);
+
 /*
  * Function: LdvqClose
  *
@@ -92,6 +137,8 @@ extern LonApiError LdvqCopy(LdvqHandle q, LonSmipMsg* data);
  * Function: LdvqPop()
  *
  * Use LdvqPop() to retrieve the head of the queue. May return NULL.
+ * With a ring queue, the producer as well as the consumer may call this
+ * function; each frame is retrieved exactly once.
  *
  * Parameters:
  * handle - queue handle, as obtained from <LdvqOpen>.
@@ -101,6 +148,22 @@ extern LonApiError LdvqCopy(LdvqHandle q, LonSmipMsg* data);
  */
 extern LonSmipMsg* LdvqPop(LdvqHandle q);
 
+/*
+ * Function: LdvqPopMany()
+ *
+ * Use LdvqPopMany() to retrieve up to 'count' frames from the head of the
+ * queue in one operation. The frames are returned in queue order.
+ *
+ * Parameters:
+ * handle - queue handle, as obtained from <LdvqOpen>.
+ * frames - output parameter, array of at least 'count' frame pointers.
+ * count - the maximum number of frames to retrieve.
+ *
+ * Returns:
+ * The number of frames retrieved, which may be zero.
+ */
+extern unsigned LdvqPopMany(LdvqHandle q, LonSmipMsg* frames[], unsigned count);
+
 /*
  * Function: LdvqEmpty
  *
@@ -130,6 +193,44 @@ extern int LdvqEmpty(LdvqHandle q);
  */
 extern LonApiError LdvqAlloc(LdvqHandle q, LonSmipMsg** ppMsg);
 
+/*
+ * Function: LdvqAllocWait
+ *
+ * LdvqAllocWait() allocates and returns a frame buffer like <LdvqAlloc>,
+ * but waits until a frame is released with <LdvqFree> or <LdvqFreeMany>
+ * if none is available. Several threads may wait at the same time; they
+ * are served in the order in which they started waiting.
+ *
+ * Close the queue only when no thread is waiting.
+ *
+ * Parameters:
+ * handle - queue handle, as obtained from <LdvqOpen>.
+ * ppMsg - output parameter, pointer to a frame pointer variable.
+ * timeout - the maximum time to wait in milliseconds, 0 to wait
+ * indefinitely.
+ *
+ * Returns:
+ * <LonApiError>, LonApiTimeout when no frame became available in time.
+ */
+extern LonApiError LdvqAllocWait(LdvqHandle q, LonSmipMsg** ppMsg, unsigned timeout);
+
+/*
+ * Function: LdvqAllocRaw
+ *
+ * LdvqAllocRaw() allocates and returns a frame buffer like <LdvqAlloc>,
+ * but does not initialize it. Use this when the caller writes the frame
+ * content anyway, for example to receive data directly into the frame.
+ * Use <LdvqFree> to return it.
+ *
+ * Parameters:
+ * handle - queue handle, as obtained from <LdvqOpen>.
+ * ppMsg - output parameter, pointer to a frame pointer variable.
+ *
+ * Returns:
+ * <LonApiError>.
+ */
+extern LonApiError LdvqAllocRaw(LdvqHandle q, LonSmipMsg** ppMsg);
+
 /*
  * Function: LdvqFree
  *
@@ -144,6 +245,78 @@ extern LonApiError LdvqAlloc(LdvqHandle q, LonSmipMsg** ppMsg);
  */
 extern LonApiError LdvqFree(LdvqHandle q, LonSmipMsg* pMsg);
 
+/*
+ * Function: LdvqFreeMany
+ *
+ * Use LdvqFreeMany to release several frames allocated with <LdvqAlloc>
+ * in one operation. NULL pointers in the array are ignored. The function
+ * may modify the array.
+ *
+ * Parameters:
+ * handle - queue handle, as obtained from <LdvqOpen>.
+ * frames - array of frame pointers.
+ * count - the number of frame pointers in the array.
+ *
+ * Returns:
+ * <LonApiError>.
+ */
+extern LonApiError LdvqFreeMany(LdvqHandle q, LonSmipMsg* frames[], unsigned count);
+
+/*
+ * Function: LdvqNotify
+ *
+ * Use LdvqNotify to register an event file descriptor, typically an
+ * eventfd, with the queue. The queue writes an 8-byte value of one to the
+ * descriptor whenever a push operation makes the queue non-empty. The
+ * descriptor is not written when frames are added to a queue which is
+ * not empty.
+ *
+ * The consumer must therefore clear the event before it tests whether the
+ * queue is empty, and signal the event again if it is not. This ensures
+ * that no event is lost to a concurrent push.
+ *
+ * Register the descriptor before the queue is used, and use -1 to
+ * unregister.
+ *
+ * Parameters:
+ * handle - queue handle, as obtained from <LdvqOpen>.
+ * fd - the event file descriptor, or -1.
+ *
+ * Returns:
+ * <LonApiError>.
+ */
+extern LonApiError LdvqNotify(LdvqHandle q, int fd);
+
+/*
+ * Function: LdvqGetLaneStatistics
+ *
+ * Use LdvqGetLaneStatistics to obtain the queue's depth counters. See
+ * <LdvLaneStatistics> for details.
+ *
+ * Parameters:
+ * handle - queue handle, as obtained from <LdvqOpen>.
+ * stats - output parameter, pointer to the statistics structure.
+ *
+ * Returns:
+ * <LonApiError>.
+ */
+extern LonApiError LdvqGetLaneStatistics(LdvqHandle q, LdvLaneStatistics* stats);
+
+/*
+ * Function: LdvqGetStatistics
+ *
+ * Use LdvqGetStatistics to obtain the allocation counters for the frames
+ * allocated with this queue. See <LdvQueueStatistics> for details.
+ *
+ * Parameters:
+ * handle - queue handle, as obtained from <LdvqOpen>.
+ * stats - output parameter, pointer to the statistics structure.
+ *
+ * Returns:
+ * <LonApiError>.
+ */
+extern LonApiError LdvqGetStatistics(LdvqHandle q, LdvQueueStatistics* stats);
+
 /*
  * Function: LdvqClear
  *
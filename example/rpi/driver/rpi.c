@@ -18,8 +18,14 @@
  * of the Echelon Example Software License Agreement which is available at
  * www.echelon.com/license/examplesoftware/.
  */
+#if !defined(_GNU_SOURCE)
+#   define _GNU_SOURCE  /* for CPU affinity */
+#endif
+
+#include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -29,14 +35,22 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <poll.h>
+#include <linux/serial.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/time.h>
 #include <sys/select.h>
 #include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
 
 #include "ShortStackDev.h"
 #include "ShortStackApi.h"
 #include "ldvq.h"
+#include "ldvlog.h"
 #include "ldv.h"
 
 #include "io.h"
@@ -47,9 +61,13 @@
  *
  * The RxD0/TxD0 functionality is supported with the kernel-mode driver and
  * available through /dev/ttyAMA0. The standard 38400bd rate is supported
- * both by this driver and by the ShortStack Micro Server. This driver only
- * supports standard bitrates because non-standard bitrates depend on
- * specific implementations and are not generally portable.
+ * both by this driver and by the ShortStack Micro Server. Bit rates with a
+ * B* constant are selected with termios. Other bit rates are selected with
+ * the BOTHER encoding of termios2 (see SerialSetBitrate()), where the kernel
+ * and the serial driver support it. The serial driver may round such a rate
+ * to one its clock can produce; LdvOpen() fails if the actual rate deviates
+ * from the requested one by more than 2%, the tolerance of the asynchronous
+ * link.
  *
  * Note that your Raspberry Pi is typically configured to use the UART0
  * serial device for boot mode debug messages and login shells.
@@ -118,6 +136,18 @@
  * corresponding RTS~ de-assertion. These timings are more than enough
  * for a ShortStack link layer driver.
  *
+ * Newer kernels deprecate sysfs GPIO in favor of the GPIO character
+ * device. The driver accesses its pins through the GpioPin interface in
+ * io.h, and LdvCtrl.gpio.backend selects sysfs, the character device or a
+ * mock implementation for testing. With the character device, each pin
+ * access is a single ioctl rather than a seek, read or write of an ASCII
+ * digit, no export delay applies, and CTS edges carry kernel timestamps.
+ *
+ * Alternatively, the driver can run the handshake on the serial port's own
+ * modem control lines (RTS, CTS, and DTR for HRDY). This requires no GPIO
+ * at all and suits USB serial adapters. The kernel's CRTSCTS flow control
+ * is not used; it does not implement the half-duplex handshake either.
+ *
  * Finally, comprehensive and easy-to-follow instructions for setting up
  * Eclipse and a compiler tool chain for cross-compilation and cross-
  * debugging for a Raspberry Pi can be found here:
@@ -136,15 +166,11 @@
 #define SUPPORT_SUSPEND 1   /* 1 to enable, 0 to disable */
 
 /*
- * Timeout values are configured in the unit of ticks, which is defined
- * within the driver thread's worker function.
- * This implementation uses a ten millisecond tick, so all of the following
- * timeout values are multiples of 10ms. Because the timers are not
- * synchronized, the smallest value should be 2. The resulting timeout
- * would be in the 10..20 ms interval.
+ * Timeout values are configured in milliseconds. The driver thread converts
+ * each into a deadline on the monotonic clock when the timeout is started,
+ * and arms a timerfd for the earliest pending deadline. No timer runs while
+ * no timeout is pending.
  */
-#define TICKS_PER_SECOND    100
-#define TIMEOUT_IN_MICROSECONDS 10000l
 
 /*
  * Macro: TIMEOUT_CTS_DEASSERT
@@ -159,9 +185,13 @@
  * start-bit) will generally reset the Micro Server before this value
  * here expires.
  *
+ * The driver adds the time needed to transfer a segment of the maximum
+ * size at the configured bit rate, because the timeout starts as soon as
+ * the segment has been handed to the serial driver.
+ *
  * A value of 2 seconds is recommended.
  */
-#define TIMEOUT_CTS_DEASSERT    (2*TICKS_PER_SECOND)
+#define TIMEOUT_CTS_DEASSERT    2000    // 2s
 
 /*
  * Macro: TIMEOUT_CTS_ASSERT
@@ -195,7 +225,7 @@
  * extra amount is an allowance for a possible non-deterministic delay in
  * detection and reporting of the CTS assertion by the operating system.
  */
-#define TIMEOUT_CTS_ASSERT  (90*TICKS_PER_SECOND)
+#define TIMEOUT_CTS_ASSERT  90000  // 90s
 
 /*
  * Macro: TIMEOUT_UPLINK_DATA
@@ -204,12 +234,33 @@
  * frame to receipt of the next portion. In effect, this timeout detects
  * incomplete uplink transfers.
  *
- * A value of 50 ms is recommended.
+ * The timeout depends on the bit rate. The driver allows the time needed
+ * to transfer UPLINK_DATA_BYTES bytes, 50ms at 38400bps, but no less than
+ * TIMEOUT_UPLINK_DATA.
+ *
+ * A minimum value of 10 ms is recommended.
  */
-#if TICKS_PER_SECOND != 100
-#   error   Adjust the definition of TIMEOUT_UPLINK_DATA
-#endif
-#define TIMEOUT_UPLINK_DATA 5   // 50ms
+#define TIMEOUT_UPLINK_DATA 10  // 10ms
+#define UPLINK_DATA_BYTES   192
+
+/*
+ * Macro: UPLINK_VMIN_THRESHOLD
+ *
+ * With the low latency option, the driver tunes VMIN to the remainder of
+ * an uplink frame only when at least this many bytes remain, see
+ * UplinkExpect(). Each change of VMIN costs a tcsetattr() call, which
+ * saves nothing over the few wakeups a short remainder causes.
+ */
+#define UPLINK_VMIN_THRESHOLD   8
+
+/*
+ * Macro: BYTE_BITS
+ *
+ * The number of bit times needed to transfer one byte: a start bit, eight
+ * data bits and one stop bit. Timeouts which depend on the bit rate are
+ * computed from this when the driver is opened.
+ */
+#define BYTE_BITS   10
 
 /*
  * Macro: TIMEOUT_UPLINK_ENQUEUE
@@ -222,7 +273,166 @@
  *
  * A value of 5s is recommended.
  */
-#define TIMEOUT_UPLINK_ENQUEUE  (5*TICKS_PER_SECOND)
+#define TIMEOUT_UPLINK_ENQUEUE  5000    // 5s
+
+/*
+ * Macro: TIMEOUT_RETRY
+ *
+ * This defines the interval at which the driver retries an operation which
+ * failed for lack of resources: the submission of a complete uplink frame
+ * to a full uplink queue, or the write of a downlink segment to the serial
+ * port. The related protocol timeout (<TIMEOUT_UPLINK_ENQUEUE> or
+ * <TIMEOUT_CTS_ASSERT>) remains armed and limits the number of retries.
+ *
+ * A value of 10 ms is recommended.
+ */
+#define TIMEOUT_RETRY   10  // 10ms
+
+/*
+ * Macro: TIMEOUT_ALLOCATE
+ *
+ * This timeout limits the time for which <LdvAllocateMsgWait> waits for a
+ * downlink frame buffer to be released when all are in use. Buffers are
+ * released as the SIO thread completes each downlink transfer.
+ *
+ * A value of 5s is recommended.
+ */
+#define TIMEOUT_ALLOCATE    5000    // 5s
+
+/*
+ * Macro: MICROSERVER_WATCHDOG
+ *
+ * The Micro Server's watchdog interval in ms, which governs the duration
+ * of each downlink segment. The Micro Server discards a partially received
+ * frame when this watchdog expires.
+ */
+#define MICROSERVER_WATCHDOG    840     // 840ms
+
+/*
+ * Macro: RECOVERY_RETRIES
+ *
+ * This defines the default number of times a frame is transmitted again
+ * after its handshake timed out, when link recovery is enabled with
+ * LdvCtrl.recovery.stall. The Micro Server's 840ms watchdog discards a
+ * partially received frame, so the frame is transmitted again from its
+ * first segment. The timeout may expire before the watchdog, for example
+ * with adaptive timeouts; the driver therefore waits until the watchdog
+ * interval has passed since the last segment was sent before it transmits
+ * the frame again.
+ */
+#define RECOVERY_RETRIES    3
+
+/*
+ * Macro: RECOVERY_PULSE
+ *
+ * When the Micro Server does not respond to RTS, the stall probe de-asserts
+ * RTS for this time in ms before it asserts RTS again, so that the Micro
+ * Server sees a new RTS edge. A retransmission after a timeout also waits
+ * at least this long.
+ */
+#define RECOVERY_PULSE  1   // 1ms
+
+/*
+ * Macro: ADAPTIVE_UPLINK_BYTES, ADAPTIVE_SAMPLES, ADAPTIVE_WINDOW
+ *
+ * These govern adaptive timeouts, enabled with LdvCtrl.adaptive.multiple.
+ * Each timeout has its own lower limit, which never falls below the
+ * protocol's timing: the CTS assert timeout is no shorter than the Micro
+ * Server's watchdog interval, the CTS deassert timeout also allows for the
+ * transfer of a segment of the maximum size, and the uplink data timeout
+ * is no shorter than the time to transfer ADAPTIVE_UPLINK_BYTES bytes, nor
+ * shorter than TIMEOUT_UPLINK_DATA. LdvCtrl.adaptive.floor may raise these
+ * limits.
+ *
+ * The fixed timeouts apply until ADAPTIVE_SAMPLES latencies have been
+ * observed. The latency counts are halved once they reach ADAPTIVE_WINDOW,
+ * so that the timeouts follow a change in the Micro Server's behavior.
+ */
+#define ADAPTIVE_UPLINK_BYTES   16
+#define ADAPTIVE_SAMPLES        32
+#define ADAPTIVE_WINDOW         1024
+
+/*
+ * Macro: UPLINK_BUFFER_SIZE
+ *
+ * The uplink receiver reads all available data from the serial port into
+ * a byte ring, then assembles as many complete frames from it as it can.
+ * The byte ring also serves as a spill buffer while the application is
+ * slow to release uplink frames. This defines the default size in bytes,
+ * which LdvCtrl.uplink.spill can override. The size is rounded up to a
+ * power of two, and should hold several frames of the maximum size.
+ */
+#define UPLINK_BUFFER_SIZE  1024
+
+/*
+ * Macro: STACK_PREFAULT
+ *
+ * When LdvCtrl.thread.lock requests memory locking, the SIO thread touches
+ * this many bytes of its stack when it starts, so that its stack pages are
+ * resident before the first frame is handled.
+ */
+#define STACK_PREFAULT  (64 * 1024)
+
+/*
+ * Macro: QUEUE_CAPACITY
+ *
+ * The uplink and downlink queues are bounded rings shared by exactly one
+ * producer and one consumer: the SIO thread and the thread which runs the
+ * ShortStack API (the ShortStack API itself is not re-entrant). This
+ * defines the default number of frames per direction, which
+ * LdvCtrl.uplink.capacity and LdvCtrl.downlink.capacity can override.
+ */
+#define QUEUE_CAPACITY  16
+
+/*
+ * Macro: WATERMARK_HIGH, WATERMARK_LOW
+ *
+ * These define the default congestion thresholds for a downlink frame pool
+ * of the given capacity, used unless LdvCtrl.watermark provides other
+ * values. The driver reports congestion through <LdvGetCongestion> once
+ * WATERMARK_HIGH frames are allocated, until no more than WATERMARK_LOW
+ * frames remain allocated.
+ */
+#define WATERMARK_HIGH(capacity)    ((capacity) * 3 / 4)
+#define WATERMARK_LOW(capacity)     ((capacity) / 4)
+
+/*
+ * Downlink lanes. Downlink frames are sorted into these lanes by LdvPutMsg(),
+ * and the downlink state engine always transmits the next frame from the
+ * most urgent non-empty lane. Frames within one lane retain their order.
+ *
+ * DL_Control carries local network interface commands and ISI messages,
+ * DL_Priority carries messages for the priority transmit queues, and
+ * DL_Normal carries everything else. The DL_Normal lane is the downlink
+ * queue itself, which owns the frame pool shared by all lanes.
+ */
+typedef enum {
+    DL_Control = 0, DL_Priority = 1, DL_Normal = 2
+} DownlinkLane;
+
+#if LDV_DOWNLINK_LANES != 3
+#   error   Adjust the definition of DownlinkLane
+#endif
+
+/*
+ * Uplink lanes. The SIO thread sorts each uplink frame into one of these
+ * lanes, and LdvGetMsg() always delivers frames from the UL_Control lane
+ * first. A reset or service pin notification, or the ISI response to a
+ * downlink RPC, therefore does not wait behind a burst of incoming network
+ * variable updates.
+ *
+ * UL_Control carries local network interface commands and ISI messages,
+ * UL_Normal carries incoming messages and completion events. The UL_Normal
+ * lane is the uplink queue itself, which owns the frame pool shared by all
+ * lanes.
+ */
+typedef enum {
+    UL_Control = 0, UL_Normal = 1
+} UplinkLane;
+
+#if LDV_UPLINK_LANES != 2
+#   error   Adjust the definition of UplinkLane
+#endif
 
 /*
  * Transmit states
@@ -241,6 +451,11 @@ typedef enum {
 #define LDV_CTRL_EXTHDR     1       /* Next segment is the extended header */
 #define LDV_CTRL_PAYLOAD    2       /* Next segment is the payload */
 
+#if LDV_CTRL_UP != LDV_LOG_FRAME || LDV_CTRL_HEADER != LDV_LOG_HEADER \
+ || LDV_CTRL_EXTHDR != LDV_LOG_EXTHDR || LDV_CTRL_PAYLOAD != LDV_LOG_PAYLOAD
+#   error   Adjust the LDV_LOG_* segment values
+#endif
+
 /*
  * LinkLayerFrame is an overlay of the LonSmipMsg structure used by the API
  * implementation with a raw set of bytes. The raw data is used by portions
@@ -263,26 +478,25 @@ typedef struct {
      */
     struct {
         int sio;    // serial i/o
-        int rts;    // rts via sysfs
-        int cts;    // cts via sysfs
-        int hrdy;   // hrdy via sysfs
         int epo;    // event pipe output (thread end)
         int epi;    // event pipe input (control end)
 #if SUPPORT_SUSPEND
         int spo;    // suspend feedback pipe (control end)
         int spi;    // suspend feedback pipe (thread end)
 #endif
+        int ulw;    // uplink wakeup event, see LdvGetEventFd()
+        int dlw;    // downlink wakeup event, signalled by the downlink lanes
+        int epl;    // epoll instance for the SIO thread
+        int tmr;    // timerfd for the SIO thread's deadlines
     } fd;
 
     /*
-     * GPIO ports
+     * GPIO pins. The HRDY pin is optional, its descriptor is -1 when unused.
      */
     struct {
-        struct {
-            int rts;
-            int cts;
-            int hrdy;
-        } port;
+        GpioPin rts;
+        GpioPin cts;
+        GpioPin hrdy;
         struct {
             int cts;
         } state;
@@ -298,15 +512,70 @@ typedef struct {
 #if SUPPORT_SUSPEND
         pthread_mutex_t mutex;
 #endif  //  SUPPORT_SUSPEND
+        uint64_t deadline; /* Current timerfd expiry, 0 if disarmed */
+        int lock; /* TRUE to prefault the stack, see LdvCtrl.thread */
     } thread;
 
+    /*
+     * Timeouts which depend on the bit rate, in ms. These replace
+     * TIMEOUT_CTS_DEASSERT and TIMEOUT_UPLINK_DATA.
+     */
+    struct {
+        unsigned ctsDeassert;
+        unsigned uplinkData;
+        unsigned segment; /* Transfer time of a maximum size segment */
+    } timeout;
+
+    /*
+     * Adaptive timeouts, see LdvCtrl.adaptive. The latency histograms use
+     * the buckets of LDV_LATENCY_BUCKETS.
+     */
+    struct {
+        unsigned multiple; /* 0 if disabled */
+        struct {
+            unsigned ctsDeassert;
+            unsigned ctsAssert;
+            unsigned uplinkData;
+        } floor, ceiling; /* limits for each timeout, in ms */
+        unsigned long ctsDeassert[LDV_LATENCY_BUCKETS];
+        unsigned long ctsAssert[LDV_LATENCY_BUCKETS];
+        unsigned long uplinkData[LDV_LATENCY_BUCKETS];
+        uint64_t received; /* Time of the last uplink read */
+    } adaptive;
+
+    /*
+     * Start-up timing, see LdvStatistics.startup.
+     */
+    struct {
+        uint64_t opened; /* Time at which LdvOpen() was called */
+        unsigned long open;
+        unsigned long ready;
+    } startup;
+
     struct {
         LdvqHandle queue; /* Incoming from the Micro Server */
+        LdvqHandle lane[LDV_UPLINK_LANES]; /* see UplinkLane */
         unsigned long timeouts;
-        LinkLayerFrame frame; /* Buffer to compile an uplink frame */
-        unsigned buffered; /* Number of bytes in buffer */
-        unsigned expected; /* Number of bytes still expected */
-        unsigned timer; /* Timeout timer */
+        LinkLayerFrame* frame; /* Complete frame, awaiting enqueue */
+        struct {
+            uint8_t* data;
+            unsigned size; /* A power of two */
+            unsigned head; /* Free-running index of the oldest byte */
+            unsigned tail; /* Free-running index past the newest byte */
+        } bytes; /* Received data, not yet assembled into frames */
+        int throttled; /* TRUE while the byte ring is full */
+        struct termios termios; /* Serial settings, see UplinkExpect() */
+        unsigned vmin; /* Current VMIN, 0 if not tuned */
+        unsigned long vminChanges;
+        unsigned long segments[LDV_VMIN_SETTINGS][LDV_LATENCY_BUCKETS];
+        LdvOverflow overflow;
+        unsigned long dropped;
+        int resync; /* TRUE to validate headers, see LdvCtrl.uplink */
+        int resyncing; /* TRUE while discarding data after an invalid header */
+        unsigned long resyncs;
+        unsigned long skipped;
+        uint64_t timer; /* Timeout deadline, 0 if disarmed */
+        uint64_t retry; /* Retry deadline, 0 if disarmed */
         uint16_t id; /* uplink frame Id */
 #if SUPPORT_SUSPEND
 #   define  LDV_SUSPEND_UL_MASK 0x0F
@@ -320,10 +589,43 @@ typedef struct {
 
     struct {
         LdvqHandle queue; /* outgoing to the Micro Server */
+        LdvqHandle lane[LDV_DOWNLINK_LANES]; /* see DownlinkLane */
         unsigned long timeouts;
+        LdvOverflow overflow;
+        unsigned long dropped;
         LinkLayerFrame* frame; /* The work-in-progress frame */
         TransmitState state;
-        unsigned timer; /* Timeout timer */
+        uint64_t timer; /* Timeout deadline, 0 if disarmed */
+        uint64_t retry; /* Retry deadline, 0 if disarmed */
+        struct {
+            unsigned high;
+            unsigned low;
+        } watermark; /* Congestion thresholds, in allocated frames */
+        int congested; /* Set by LdvGetCongestion(), read by the SIO thread */
+        unsigned long congestions;
+        uint64_t request; /* Time of the RTS assertion */
+        unsigned spin; /* CTS polling time after RTS, in us */
+        unsigned long latency[LDV_LATENCY_BUCKETS];
+        unsigned long spins;
+        uint64_t entered; /* Time the current state was entered */
+        LdvSegmentProfile profile[LDV_PROFILE_CLASSES][LDV_PROFILE_SEGMENTS];
+        struct {
+            unsigned stall; /* Stall detection interval in ms, 0 if disabled */
+            unsigned retries; /* Retransmissions allowed per frame */
+            unsigned attempt; /* Retransmissions of the current frame */
+            uint64_t probe; /* Stall probe deadline, 0 if disarmed */
+            uint64_t pulse; /* End of the RTS pulse, 0 if none */
+            uint64_t sent; /* Time the last segment was written */
+            uint64_t holdoff; /* Earliest retransmission, 0 if none */
+            uint64_t stalled; /* Time the current stall began, 0 if none */
+            unsigned long stalls;
+            unsigned long edges;
+            unsigned long resyncs;
+            unsigned long retransmits;
+            unsigned long recovered;
+            unsigned long time;
+            unsigned long longest;
+        } recovery;
 #if SUPPORT_SUSPEND
 #   define  LDV_SUSPEND_DL_MASK 0xF0
 #   define  IS_SUSPEND_DL_IMMEDIATE(v)  ((v) && (v) == (LDV_SUSPEND_DL_MASK & LDV_SUSPEND_IMMEDIATE))
@@ -334,6 +636,7 @@ typedef struct {
     } downlink;
 
     int (*trace)(const char* fmt, ...); // trace function from LdvCtrl
+    LdvLogHandle log;   // binary frame log, see LdvCtrl.frameLog
 } RpiHandle;
 
 #define RPI_TRACE(trace, ...) if (trace) trace(__VA_ARGS__)
@@ -364,7 +667,6 @@ typedef enum {
      * Consider positive values reserved for suspend requests.
      */
     PEV_Terminate = -1, /* Terminate the SIO thread */
-    PEV_Wakeup = -2, /* Wake up and transmit */
     PEV_Resume = -3, /* resume if suspended */
     PEV_Reset = -4 /* immediate driver request */
 } PipeEvent;
@@ -376,7 +678,7 @@ typedef enum {
 typedef enum {
     TEV_None = 0, /* Not an event, just a placeholder */
     TEV_Data = 1, /* Incoming data is available */
-    TEV_Tick = 2, /* A new tick occurred */
+    TEV_Timer = 2, /* A timer may have expired */
     TEV_CTS = 3, /* A change occurred on CTS */
     TEV_Wakeup = 4, /* A new transmit request arrived */
     TEV_Reset = 5 /* Abort current frame immediately, if any */
@@ -384,7 +686,9 @@ typedef enum {
 
 /*
  * EncodeBitrate() transcodes the numeric bit rate requested in the control
- * data structure into the encoded value used by the kernel's driver.
+ * data structure into the encoded value used by the kernel's driver. The
+ * function returns zero for a bit rate without such an encoding; the driver
+ * selects these rates with SerialSetBitrate().
  */
 static speed_t EncodeBitrate(const LdvCtrl* ctrl)
 {
@@ -392,7 +696,9 @@ static speed_t EncodeBitrate(const LdvCtrl* ctrl)
         unsigned plain;
         speed_t encoded;
     } bitrate_table[] = { { 4800, B4800 }, { 9600, B9600 },
-        { 19200, B19200 }, { 38400, B38400 }
+        { 19200, B19200 }, { 38400, B38400 }, { 57600, B57600 },
+        { 115200, B115200 }, { 230400, B230400 }, { 460800, B460800 },
+        { 921600, B921600 }
     };
     speed_t result = 0;
 
@@ -403,11 +709,81 @@ static speed_t EncodeBitrate(const LdvCtrl* ctrl)
         }
     }
 
-    if (result == 0) {
-        RPI_TRACE(ctrl->trace, "Cannot support %u bps\n", ctrl->bitrate);
+    return result;
+}
+
+/*
+ * ByteTimeout() returns the time in milliseconds needed to transfer the
+ * given number of bytes at the given bit rate, rounded up, but no less
+ * than 'minimum'.
+ */
+static unsigned ByteTimeout(unsigned bitrate, unsigned bytes, unsigned minimum)
+{
+    const uint64_t bits = (uint64_t) bytes * BYTE_BITS * 1000u;
+    const unsigned result = bitrate ? (unsigned) ((bits + bitrate - 1) / bitrate) : 0;
+
+    return result > minimum ? result : minimum;
+}
+
+/*
+ * Now() returns the monotonic clock in microseconds.
+ */
+static uint64_t Now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000u + (uint64_t) now.tv_nsec / 1000u;
+}
+
+/*
+ * Deadline() returns the deadline for a timeout of the given number of
+ * milliseconds, starting now.
+ */
+static uint64_t Deadline(unsigned milliseconds)
+{
+    return Now() + (uint64_t) milliseconds * 1000u;
+}
+
+/*
+ * Expired() returns TRUE if the deadline is armed and has passed.
+ */
+static int Expired(uint64_t deadline, uint64_t now)
+{
+    return deadline && deadline <= now;
+}
+
+/*
+ * ArmTimer() arms the timerfd for the earliest pending deadline, or
+ * disarms it when no deadline is pending. The timerfd is only updated
+ * when that deadline changes.
+ */
+static void ArmTimer(RpiHandle* rpi)
+{
+    const uint64_t deadlines[] = {
+        rpi->uplink.timer, rpi->uplink.retry,
+        rpi->downlink.timer, rpi->downlink.retry,
+        rpi->downlink.recovery.probe, rpi->downlink.recovery.pulse,
+        rpi->downlink.recovery.holdoff
+    };
+    uint64_t earliest = 0;
+
+    for (unsigned i = 0; i < sizeof(deadlines) / sizeof(deadlines[0]); ++i) {
+        if (deadlines[i] && (earliest == 0 || deadlines[i] < earliest)) {
+            earliest = deadlines[i];
+        }
     }
 
-    return result;
+    if (earliest != rpi->thread.deadline) {
+        struct itimerspec spec;
+
+        memset(&spec, 0, sizeof(spec));
+        spec.it_value.tv_sec = earliest / 1000000u;
+        spec.it_value.tv_nsec = (earliest % 1000000u) * 1000u;
+
+        timerfd_settime(rpi->fd.tmr, TFD_TIMER_ABSTIME, &spec, NULL);
+        rpi->thread.deadline = earliest;
+    }
 }
 
 /*
@@ -422,14 +798,41 @@ static int GetCts(RpiHandle* rpi)
     return rpi->gpio.state.cts;
 }
 
+/*
+ * ReadCts() reads the physical CTS input, updates the cached state reported
+ * by GetCts(), and returns the logical state.
+ */
+static int ReadCts(RpiHandle* rpi)
+{
+    int level = GpioPinRead(&rpi->gpio.cts);
+
+    if (level != -1) {
+        rpi->gpio.state.cts = level == 0;
+    }
+
+    return GetCts(rpi);
+}
+
+/*
+ * CtsEvent() consumes the pending CTS edge events, and updates the cached
+ * state reported by GetCts().
+ */
+static void CtsEvent(RpiHandle* rpi)
+{
+    int level = GpioPinEvent(&rpi->gpio.cts);
+
+    if (level != -1) {
+        rpi->gpio.state.cts = level == 0;
+    }
+}
+
 /*
  * SetRts sets or clears the RTS signal. The call expects the logical
  * state, i.e. TRUE to assert RTS (which yields a physical low output level).
  */
 static void SetRts(RpiHandle* rpi, int state)
 {
-    char buffer = state ? '0' : '1';
-    write(rpi->fd.rts, &buffer, 1);
+    GpioPinWrite(&rpi->gpio.rts, !state);
 }
 
 /*
@@ -438,237 +841,1008 @@ static void SetRts(RpiHandle* rpi, int state)
  */
 static void SetHrdy(RpiHandle* rpi, int state)
 {
-    if (rpi->fd.hrdy > 0) {
-        char buffer = state ? '0' : '1';
-        write(rpi->fd.hrdy, &buffer, 1);
+    if (rpi->gpio.hrdy.fd != -1) {
+        GpioPinWrite(&rpi->gpio.hrdy, !state);
     }
 }
 
 /*
- * LogFrame() reports a packet log. 'bytes' can be zero; will add the segment sizes
- * in that case.
+ * LatencyBucket() returns the latency histogram bucket for the given number
+ * of microseconds, see LDV_LATENCY_BUCKETS.
  */
-static void LogFrame(RpiHandle *rpi, const char* preamble,
-                     LonSmipMsg* frame, uint8_t ctrl)
+static unsigned LatencyBucket(uint64_t elapsed)
 {
-    /* A local buffer for printing the frame contents.
-     * 3 bytes per byte ("FE.") plus segment frame (" X:0x") and '\0'
-     */
-    if (rpi->trace) {
-        char buffer[LON_APP_OUTPUT_BUFSIZE * 3 + 3 * 6 + 10 + 1];
-
-        size_t pos = sprintf(
-                         buffer, "H:0x%02x.%02x",
-                         (unsigned) frame->Header.Length,
-                         (unsigned) frame->Header.Command
-                     );
-
-        if (frame->ExtHdr.Index
-        && (ctrl == LDV_CTRL_EXTHDR || ctrl == LDV_CTRL_PAYLOAD)) {
-            pos += sprintf(
-                       buffer + pos, " X:0x%02x.%02x",
-                       (unsigned) frame->ExtHdr.Index,
-                       (unsigned) frame->ExtHdr.Reserved
-                   );
-        }
+    unsigned bucket = 0;
 
-        if (frame->Header.Length
-        && (ctrl == LDV_CTRL_UP || ctrl == LDV_CTRL_PAYLOAD)) {
-            pos += sprintf(buffer + pos, " P:0x");
+    while (elapsed && bucket < LDV_LATENCY_BUCKETS - 1) {
+        elapsed >>= 1;
+        ++bucket;
+    }
 
-            for (int i = 0; i < frame->Header.Length; ++i) {
-                pos += sprintf(
-                           buffer + pos, "%02x.",
-                           (unsigned) frame->Payload[i]
-                       );
-            }
+    return bucket;
+}
 
-            /* Remove the trailing '.' */
-            buffer[pos - 1] = '\0';
-        }
+/*
+ * AdaptiveSample() adds a latency to one of the adaptive timeout
+ * histograms, and ages the histogram once it holds ADAPTIVE_WINDOW samples.
+ */
+static void AdaptiveSample(unsigned long histogram[], unsigned bucket)
+{
+    unsigned long total = 0;
+
+    histogram[bucket] += 1;
+
+    for (int i = 0; i < LDV_LATENCY_BUCKETS; ++i) {
+        total += histogram[i];
+    }
 
-        RPI_TRACE(rpi->trace, "%s.%05u %s\n", preamble, frame->Id, buffer);
+    if (total >= ADAPTIVE_WINDOW) {
+        for (int i = 0; i < LDV_LATENCY_BUCKETS; ++i) {
+            histogram[i] >>= 1;
+        }
     }
 }
 
 /*
- * Downlink() is called from the SIO thread and handles everything regarding the
- * downlink transfer of a single frame by implementing an asynchronous state
- * engine.
+ * AdaptiveTimeout() returns the timeout in milliseconds derived from the
+ * given latency histogram, or the 'fixed' timeout when adaptive timeouts
+ * are disabled or too few latencies have been observed. The timeout is a
+ * multiple of the upper bound of the histogram bucket which holds the 99th
+ * percentile, limited to the range from 'floor' to 'ceiling'. The floor
+ * prevails, because it reflects the protocol's timing.
  */
-static void Downlink(RpiHandle* rpi, ThreadEvent tev)
+static unsigned AdaptiveTimeout(RpiHandle* rpi, const unsigned long histogram[],
+                                unsigned fixed, unsigned floor, unsigned ceiling)
 {
-    TransmitState new_state = rpi->downlink.state;
+    unsigned long total = 0;
+    unsigned long count = 0;
+    unsigned result = fixed;
 
-#if SUPPORT_SUSPEND
+    for (int i = 0; i < LDV_LATENCY_BUCKETS; ++i) {
+        total += histogram[i];
+    }
 
-    if (tev == TEV_Reset
-    || IS_SUSPEND_DL_IMMEDIATE(rpi->downlink.suspend)
-    || (IS_SUSPEND_DL_SYNCHED(rpi->downlink.suspend)
-        && rpi->downlink.frame == NULL)
-    ) {
-#else
+    if (rpi->adaptive.multiple && total >= ADAPTIVE_SAMPLES) {
+        int bucket = 0;
 
-    if (tev == TEV_Reset) {
-#endif  // SUPPORT_SUSPEND
+        while ((count += histogram[bucket]) * 100 < total * 99) {
+            ++bucket;
+        }
 
-        /*
-         * Take care of immediate suspension requests.
-         */
-        SetRts(rpi, FALSE);
+        if (bucket == LDV_LATENCY_BUCKETS - 1) {
+            /* The last bucket has no upper bound. */
+            result = ceiling;
+        } else {
+            const uint64_t limit = ((uint64_t) 1 << bucket) * rpi->adaptive.multiple;
+            result = (unsigned) ((limit + 999u) / 1000u);
+        }
 
-        LdvqFree(rpi->downlink.queue, &rpi->downlink.frame->smip);
-        rpi->downlink.frame = NULL;
-        rpi->downlink.state = TXS_Idle;
-        rpi->downlink.timer = 0;
+        if (result > ceiling) {
+            result = ceiling;
+        }
 
-#if SUPPORT_SUSPEND
-        rpi->downlink.suspended = rpi->downlink.suspend;
-#endif  //  SUPPORT_SUSPEND
-    } else {
-        /*
-         * Normal downlink state engine processing.
-         */
-        if (tev == TEV_Tick) {
-            if (rpi->downlink.timer) {
-                rpi->downlink.timer -= 1;
+        if (result < floor) {
+            result = floor;
+        }
+    }
 
-                if (rpi->downlink.timer == 0) {
-                    /* Timeout. */
-                    SetRts(rpi, FALSE);
+    return result;
+}
 
-                    LdvqFree(rpi->downlink.queue, &rpi->downlink.frame->smip);
-                    rpi->downlink.frame = NULL;
-                    rpi->downlink.state = TXS_Idle;
-                    rpi->downlink.timeouts += 1;
+/*
+ * CtsAssertTimeout(), CtsDeassertTimeout() and UplinkDataTimeout() return
+ * the current value of each adaptive timeout in milliseconds.
+ */
+static unsigned CtsAssertTimeout(RpiHandle* rpi)
+{
+    return AdaptiveTimeout(
+               rpi, rpi->adaptive.ctsAssert, TIMEOUT_CTS_ASSERT,
+               rpi->adaptive.floor.ctsAssert, rpi->adaptive.ceiling.ctsAssert
+           );
+}
 
-                    RPI_TRACE(rpi->trace, "Downlink timeout\n");
-                }
-            }
-        }
+static unsigned CtsDeassertTimeout(RpiHandle* rpi)
+{
+    return AdaptiveTimeout(
+               rpi, rpi->adaptive.ctsDeassert, rpi->timeout.ctsDeassert,
+               rpi->adaptive.floor.ctsDeassert, rpi->adaptive.ceiling.ctsDeassert
+           );
+}
 
-        /*
-         * Loop until the state no longer changes. Note that error conditions
-         * or synchronized suspension may execute 'break' within this loop
-         * (in order to support structured code and avoid a mid-function
-         * 'return'), so be careful when adding additional inner loops.
-         */
-        do {
-            rpi->downlink.state = new_state;
+static unsigned UplinkDataTimeout(RpiHandle* rpi)
+{
+    return AdaptiveTimeout(
+               rpi, rpi->adaptive.uplinkData, rpi->timeout.uplinkData,
+               rpi->adaptive.floor.uplinkData, rpi->adaptive.ceiling.uplinkData
+           );
+}
 
-            if (rpi->downlink.state == TXS_Idle) {
-                rpi->downlink.frame = (LinkLayerFrame*)LdvqPop(rpi->downlink.queue);
+/*
+ * AdaptiveLimits() sets the floor and ceiling of one adaptive timeout. A
+ * floor above the ceiling prevails, and is reported.
+ */
+static void AdaptiveLimits(RpiHandle* rpi, const char* name,
+                           unsigned* floor, unsigned* ceiling,
+                           unsigned minimum, unsigned fixed, const LdvCtrl* ctrl)
+{
+    *floor = ctrl->adaptive.floor > minimum ? ctrl->adaptive.floor : minimum;
+    *ceiling = ctrl->adaptive.ceiling ? ctrl->adaptive.ceiling : fixed;
+
+    if (*floor > *ceiling) {
+        RPI_TRACE(
+            rpi->trace, "Adaptive %s timeout: floor %ums exceeds ceiling %ums, using the floor\n",
+            name, *floor, *ceiling
+        );
+        *ceiling = *floor;
+    }
+}
 
-                if (rpi->downlink.frame) {
-                    if (GetCts(rpi)) {
-                        /* Must wait for CTS to be cleared before proceeding. */
-                        rpi->downlink.timer = TIMEOUT_CTS_DEASSERT;
-                        new_state = TXS_AwaitCtsDeassert;
-                    } else {
-                        /* Can assert RTS and wait for CTS response. */
-                        SetRts(rpi, TRUE);
-                        rpi->downlink.timer = TIMEOUT_CTS_ASSERT;
-                        new_state = TXS_AwaitCtsAssert;
-                    }
-                }
-            }   // state TXS_Idle
+/*
+ * RequestToSend() asserts RTS and starts the wait for the CTS response. If
+ * configured, the function polls the CTS input for a short while, so that
+ * a fast response is found without waiting for the CTS edge event.
+ */
+static void RequestToSend(RpiHandle* rpi)
+{
+    SetRts(rpi, TRUE);
+    rpi->downlink.request = Now();
+    rpi->downlink.timer = Deadline(
+        CtsAssertTimeout(rpi)
+    );
 
-            if (rpi->downlink.state == TXS_AwaitCtsDeassert) {
-                if (!GetCts(rpi)) {
-                    /* Can assert RTS and wait for CTS response. */
-                    SetRts(rpi, TRUE);
-                    rpi->downlink.timer = TIMEOUT_CTS_ASSERT;
-                    new_state = TXS_AwaitCtsAssert;
-                }
-            }   // state TXS_AwaitCtsDeassert
+    if (rpi->downlink.spin) {
+        const uint64_t until = rpi->downlink.request + rpi->downlink.spin;
 
-            if (rpi->downlink.state == TXS_AwaitCtsAssert) {
-                if (GetCts(rpi)) {
-                    /*
-                     * Transmit the next segment.
-                     * Determine its data pointer and size.
-                     */
-                    size_t size = sizeof(LonSmipHdr);
-                    uint8_t* data = (uint8_t*) &rpi->downlink.frame->smip.Header;
+        while (!ReadCts(rpi) && Now() < until) {
+            /* Keep polling. */
+        }
 
-                    if (rpi->downlink.frame->smip.Ctrl.Data == LDV_CTRL_EXTHDR) {
-                        size = sizeof(LonSmipExtHdr);
-                        data = (uint8_t*) &rpi->downlink.frame->smip.ExtHdr;
-                    } else if (rpi->downlink.frame->smip.Ctrl.Data == LDV_CTRL_PAYLOAD) {
-                        size = rpi->downlink.frame->smip.Header.Length;
-                        data = (uint8_t*) &rpi->downlink.frame->smip.Payload;
+        if (GetCts(rpi)) {
+            rpi->downlink.spins += 1;
+        }
+    }
+}
+
+/*
+ * RecordLatency() adds the time from the RTS assertion to the CTS response
+ * to the latency histogram, once per RTS assertion. The CTS edge timestamp
+ * is used where the GPIO backend provides one, and the current time
+ * otherwise. The function returns the histogram bucket.
+ */
+static unsigned RecordLatency(RpiHandle* rpi)
+{
+    const uint64_t edge = rpi->gpio.cts.timestamp / 1000u;
+    uint64_t elapsed = Now();
+    unsigned bucket = 0;
+
+    if (edge >= rpi->downlink.request && edge < elapsed) {
+        elapsed = edge;
+    }
+
+    bucket = LatencyBucket(elapsed - rpi->downlink.request);
+    rpi->downlink.request = 0;
+    rpi->downlink.latency[bucket] += 1;
+
+    return bucket;
+}
+
+/*
+ * SegmentProfile() returns the profile entry for the current downlink
+ * segment, selected by the frame's command and the segment.
+ */
+static LdvSegmentProfile* SegmentProfile(RpiHandle* rpi)
+{
+    const LonSmipMsg* frame = &rpi->downlink.frame->smip;
+    const unsigned command = frame->Header.Command;
+    unsigned type = 0;
+
+    if ((command & LonNiNv) == LonNiNv) {
+        type = 3;
+    } else if ((command & 0xF0) == LonNiComm) {
+        type = 1;
+    } else if ((command & 0xF0) == LonNiNetManagement) {
+        type = 2;
+    }
+
+    return &rpi->downlink.profile[type][frame->Ctrl.Data % LDV_PROFILE_SEGMENTS];
+}
+
+/*
+ * LogRecord() fills in a frame log record. The payload is only copied if
+ * the segment includes it.
+ */
+static void LogRecord(LdvLogRecord* record, uint8_t direction,
+                      const LonSmipMsg* frame, uint8_t ctrl)
+{
+    record->timestamp = Now();
+    record->id = frame->Id;
+    record->direction = direction;
+    record->segment = ctrl;
+    record->data[0] = frame->Header.Length;
+    record->data[1] = frame->Header.Command;
+    record->data[2] = frame->ExtHdr.Index;
+    record->data[3] = frame->ExtHdr.Reserved;
+
+    if (ctrl == LDV_CTRL_UP || ctrl == LDV_CTRL_PAYLOAD) {
+        memcpy(record->data + 4, frame->Payload, frame->Header.Length);
+    }
+}
+
+/*
+ * LogFrame() reports a packet log. With the binary frame log enabled, the
+ * frame is recorded there; rendering the record as text is left to
+ * LdvLogFormat(), outside of the SIO thread. Otherwise, the frame is
+ * rendered immediately and reported through the trace function.
+ */
+static void LogFrame(RpiHandle *rpi, uint8_t direction,
+                     LonSmipMsg* frame, uint8_t ctrl)
+{
+    if (rpi->log) {
+        LogRecord(LdvLogNext(rpi->log), direction, frame, ctrl);
+        LdvLogCommit(rpi->log);
+    } else if (rpi->trace) {
+        LdvLogRecord record;
+        char buffer[LDV_LOG_TEXT];
+
+        LogRecord(&record, direction, frame, ctrl);
+        LdvLogFormat(&record, buffer);
+        RPI_TRACE(rpi->trace, "%s\n", buffer);
+    }
+}
+
+/*
+ * DownlinkAllocated() returns the number of frames allocated from the
+ * downlink frame pool.
+ */
+static unsigned DownlinkAllocated(RpiHandle* rpi)
+{
+    LdvQueueStatistics stats;
+
+    LdvqGetStatistics(rpi->downlink.queue, &stats);
+    return stats.allocated;
+}
+
+/*
+ * DownlinkRelease() releases the current downlink frame, if any. When this
+ * ends a congestion reported with LdvGetCongestion(), the uplink event is
+ * signalled so that an application waiting for the event learns of it.
+ */
+static void DownlinkRelease(RpiHandle* rpi)
+{
+    if (rpi->downlink.frame) {
+        LdvqFree(rpi->downlink.queue, &rpi->downlink.frame->smip);
+        rpi->downlink.frame = NULL;
+        rpi->downlink.recovery.attempt = 0;
+
+        if (__atomic_load_n(&rpi->downlink.congested, __ATOMIC_RELAXED)
+            && DownlinkAllocated(rpi) <= rpi->downlink.watermark.low) {
+            const uint64_t count = 1;
+            write(rpi->fd.ulw, &count, sizeof(count));
+        }
+    }
+}
+
+/*
+ * DownlinkProgress() is called when the downlink state engine enters a new
+ * state. The CTS response ends a stall; the function accounts for this, and
+ * restarts stall detection while the engine awaits a CTS response.
+ */
+static void DownlinkProgress(RpiHandle* rpi, TransmitState state)
+{
+    if (rpi->downlink.recovery.stalled && rpi->downlink.state != TXS_Idle) {
+        const unsigned long elapsed = (unsigned long) (Now() - rpi->downlink.recovery.stalled);
+
+        rpi->downlink.recovery.stalled = 0;
+        rpi->downlink.recovery.recovered += 1;
+        rpi->downlink.recovery.time += elapsed;
+
+        if (elapsed > rpi->downlink.recovery.longest) {
+            rpi->downlink.recovery.longest = elapsed;
+        }
+
+        RPI_TRACE(rpi->trace, "Downlink recovered after %luus\n", elapsed);
+    }
+
+    rpi->downlink.recovery.probe = rpi->downlink.recovery.pulse = 0;
+
+    if (rpi->downlink.recovery.stall && state != TXS_Idle) {
+        rpi->downlink.recovery.probe = Deadline(rpi->downlink.recovery.stall);
+    }
+}
+
+/*
+ * DownlinkProbe() is called when the downlink state engine awaited a CTS
+ * response for longer than the stall detection interval. The function
+ * reads the CTS input, because the edge event may have been missed. If the
+ * Micro Server still has not responded to RTS, the function de-asserts RTS
+ * for RECOVERY_PULSE ms, because the Micro Server may have missed the RTS
+ * edge. The downlink state engine asserts RTS again when the pulse ends.
+ */
+static void DownlinkProbe(RpiHandle* rpi)
+{
+    const int cts = GetCts(rpi);
+
+    if (rpi->downlink.recovery.stalled == 0) {
+        /*
+         * The stall began when the engine started to await the response.
+         */
+        rpi->downlink.recovery.stalled = rpi->downlink.recovery.probe
+                                         - (uint64_t) rpi->downlink.recovery.stall * 1000u;
+        rpi->downlink.recovery.stalls += 1;
+        RPI_TRACE(rpi->trace, "Downlink stall (state %d)\n", rpi->downlink.state);
+    }
+
+    if (ReadCts(rpi) != cts) {
+        rpi->downlink.recovery.edges += 1;
+    } else if (rpi->downlink.state == TXS_AwaitCtsAssert && !rpi->downlink.recovery.pulse) {
+        SetRts(rpi, FALSE);
+        rpi->downlink.recovery.pulse = Deadline(RECOVERY_PULSE);
+    }
+
+    rpi->downlink.recovery.probe = Deadline(rpi->downlink.recovery.stall);
+}
+
+/*
+ * DownlinkNext() takes the next frame from the most urgent non-empty lane,
+ * or returns NULL when all lanes are empty. The lanes signal the downlink
+ * event only when they become non-empty, so the final LdvqEmpty() test
+ * makes sure that a frame pushed while the lanes were examined is either
+ * found here or signals the event; see LdvqNotify().
+ */
+static LinkLayerFrame* DownlinkNext(RpiHandle* rpi)
+{
+    LinkLayerFrame* frame = NULL;
+    int empty = FALSE;
+
+    while (!frame && !empty) {
+        empty = TRUE;
+
+        for (int lane = 0; lane < LDV_DOWNLINK_LANES && !frame; ++lane) {
+            frame = (LinkLayerFrame*)LdvqPop(rpi->downlink.lane[lane]);
+        }
+
+        for (int lane = 0; lane < LDV_DOWNLINK_LANES && !frame; ++lane) {
+            empty = empty && LdvqEmpty(rpi->downlink.lane[lane]);
+        }
+    }
+
+    return frame;
+}
+
+/*
+ * Downlink() is called from the SIO thread and handles everything regarding the
+ * downlink transfer of a single frame by implementing an asynchronous state
+ * engine.
+ */
+static void Downlink(RpiHandle* rpi, ThreadEvent tev)
+{
+    TransmitState new_state = rpi->downlink.state;
+
+#if SUPPORT_SUSPEND
+
+    if (tev == TEV_Reset
+    || IS_SUSPEND_DL_IMMEDIATE(rpi->downlink.suspend)
+    || (IS_SUSPEND_DL_SYNCHED(rpi->downlink.suspend)
+        && rpi->downlink.frame == NULL)
+    ) {
+#else
+
+    if (tev == TEV_Reset) {
+#endif  // SUPPORT_SUSPEND
+
+        /*
+         * Take care of immediate suspension requests.
+         */
+        SetRts(rpi, FALSE);
+
+        DownlinkRelease(rpi);
+        rpi->downlink.state = TXS_Idle;
+        rpi->downlink.timer = rpi->downlink.retry = 0;
+        rpi->downlink.recovery.probe = rpi->downlink.recovery.stalled = 0;
+        rpi->downlink.recovery.pulse = rpi->downlink.recovery.holdoff = 0;
+
+#if SUPPORT_SUSPEND
+        rpi->downlink.suspended = rpi->downlink.suspend;
+#endif  //  SUPPORT_SUSPEND
+    } else {
+        /*
+         * Normal downlink state engine processing.
+         */
+        if (tev == TEV_Timer) {
+            const uint64_t now = Now();
+
+            if (Expired(rpi->downlink.retry, now)) {
+                /* Retry now, in the state engine below. */
+                rpi->downlink.retry = 0;
+            }
+
+            if (Expired(rpi->downlink.recovery.pulse, now)) {
+                /* The RTS pulse ends, see DownlinkProbe(). */
+                rpi->downlink.recovery.pulse = 0;
+
+                if (rpi->downlink.state == TXS_AwaitCtsAssert) {
+                    SetRts(rpi, TRUE);
+                    rpi->downlink.recovery.resyncs += 1;
+                }
+            }
+
+            if (Expired(rpi->downlink.recovery.holdoff, now)) {
+                /* Retransmit now, in the state engine below. */
+                rpi->downlink.recovery.holdoff = 0;
+            }
+
+            if (Expired(rpi->downlink.recovery.probe, now)) {
+                DownlinkProbe(rpi);
+            }
+
+            if (Expired(rpi->downlink.timer, now)) {
+                /* Timeout. */
+                SetRts(rpi, FALSE);
+
+                if (rpi->downlink.frame
+                    && rpi->downlink.recovery.attempt < rpi->downlink.recovery.retries) {
+                    /*
+                     * Keep the frame, and transmit it again from its first
+                     * segment, but not before the Micro Server's watchdog
+                     * has discarded any partially received frame, and not
+                     * before RTS was de-asserted for RECOVERY_PULSE.
+                     */
+                    const uint64_t earliest = rpi->downlink.recovery.sent
+                        + (uint64_t) (MICROSERVER_WATCHDOG + rpi->timeout.segment) * 1000u;
+
+                    rpi->downlink.recovery.holdoff = Deadline(RECOVERY_PULSE);
+
+                    if (rpi->downlink.recovery.sent && earliest > rpi->downlink.recovery.holdoff) {
+                        rpi->downlink.recovery.holdoff = earliest;
+                    }
+
+                    rpi->downlink.frame->smip.Ctrl.Data = LDV_CTRL_HEADER;
+                    rpi->downlink.recovery.attempt += 1;
+                    rpi->downlink.recovery.retransmits += 1;
+                    RPI_TRACE(rpi->trace, "Downlink timeout, retransmit\n");
+                } else {
+                    DownlinkRelease(rpi);
+                    rpi->downlink.recovery.stalled = 0;
+                    RPI_TRACE(rpi->trace, "Downlink timeout\n");
+                }
+
+                /*
+                 * The engine returns to Idle without DownlinkProgress(), as
+                 * the timeout does not end a stall. Disarm stall detection
+                 * until the engine awaits CTS again, so that no probe fires
+                 * while idle or during the holdoff.
+                 */
+                rpi->downlink.state = new_state = TXS_Idle;
+                rpi->downlink.timer = rpi->downlink.retry = 0;
+                rpi->downlink.recovery.probe = rpi->downlink.recovery.pulse = 0;
+                rpi->downlink.timeouts += 1;
+            }
+        }
+
+        /*
+         * Loop until the state no longer changes. Note that error conditions
+         * or synchronized suspension may execute 'break' within this loop
+         * (in order to support structured code and avoid a mid-function
+         * 'return'), so be careful when adding additional inner loops.
+         */
+        do {
+            if (new_state != rpi->downlink.state) {
+                rpi->downlink.entered = Now();
+                DownlinkProgress(rpi, new_state);
+            }
+
+            rpi->downlink.state = new_state;
+
+            if (rpi->downlink.state == TXS_Idle) {
+                if (!rpi->downlink.frame) {
+                    rpi->downlink.frame = DownlinkNext(rpi);
+                }
+
+                if (rpi->downlink.frame && rpi->downlink.recovery.holdoff) {
+                    /* Wait for the retransmission, see RECOVERY_RETRIES. */
+                } else if (rpi->downlink.frame) {
+                    if (GetCts(rpi)) {
+                        /* Must wait for CTS to be cleared before proceeding. */
+                        rpi->downlink.timer = Deadline(
+                            CtsDeassertTimeout(rpi)
+                        );
+                        new_state = TXS_AwaitCtsDeassert;
+                    } else {
+                        /* Can assert RTS and wait for CTS response. */
+                        RequestToSend(rpi);
+                        new_state = TXS_AwaitCtsAssert;
+                    }
+                }
+            }   // state TXS_Idle
+
+            if (rpi->downlink.state == TXS_AwaitCtsDeassert) {
+                if (!GetCts(rpi)) {
+                    const uint64_t waited = Now() - rpi->downlink.entered;
+
+                    const unsigned bucket = LatencyBucket(waited);
+
+                    SegmentProfile(rpi)->ctsDeassert[bucket] += 1;
+                    AdaptiveSample(rpi->adaptive.ctsDeassert, bucket);
+
+                    /* Can assert RTS and wait for CTS response. */
+                    RequestToSend(rpi);
+                    new_state = TXS_AwaitCtsAssert;
+                }
+            }   // state TXS_AwaitCtsDeassert
+
+            if (rpi->downlink.state == TXS_AwaitCtsAssert) {
+                if (GetCts(rpi)) {
+                    /*
+                     * Transmit the next segment.
+                     * Determine its data pointer and size.
+                     */
+                    size_t size = sizeof(LonSmipHdr);
+                    uint8_t* data = (uint8_t*) &rpi->downlink.frame->smip.Header;
+                    LdvSegmentProfile* profile = SegmentProfile(rpi);
+                    uint64_t written = 0;
+
+                    if (rpi->downlink.frame->smip.Ctrl.Data == LDV_CTRL_EXTHDR) {
+                        size = sizeof(LonSmipExtHdr);
+                        data = (uint8_t*) &rpi->downlink.frame->smip.ExtHdr;
+                    } else if (rpi->downlink.frame->smip.Ctrl.Data == LDV_CTRL_PAYLOAD) {
+                        size = rpi->downlink.frame->smip.Header.Length;
+                        data = (uint8_t*) &rpi->downlink.frame->smip.Payload;
+                    }
+
+                    SetRts(rpi, FALSE);
+
+                    if (rpi->downlink.request) {
+                        const unsigned bucket = RecordLatency(rpi);
+
+                        profile->ctsAssert[bucket] += 1;
+                        AdaptiveSample(rpi->adaptive.ctsAssert, bucket);
                     }
 
-                    SetRts(rpi, FALSE);
+                    written = Now();
+
+                    if (write(rpi->fd.sio, data, size) != size) {
+                        /*
+                         * The write failed. It is unlikely to fail on a Linux
+                         * host (the kernel typically maintains a 4096 byte buffer),
+                         * but if it does fail, we let the timeout run and try
+                         * again when the retry timer expires.
+                         */
+                        rpi->downlink.retry = Deadline(TIMEOUT_RETRY);
+                    } else {
+                        /*
+                         * The write succeeded. See if there is more to transfer.
+                         * Otherwise, be done.
+                         */
+                        rpi->downlink.retry = 0;
+                        rpi->downlink.recovery.sent = Now();
+                        profile->write[LatencyBucket(rpi->downlink.recovery.sent - written)] += 1;
+                        profile->segments += 1;
+                        LogFrame(
+                            rpi, LDV_LOG_DOWN,
+                            &rpi->downlink.frame->smip,
+                            rpi->downlink.frame->smip.Ctrl.Data
+                        );
+
+                        /*
+                         * Determine what's next.
+                         */
+                        if (rpi->downlink.frame->smip.Ctrl.Data == LDV_CTRL_HEADER) {
+                            if (rpi->downlink.frame->smip.ExtHdr.Index) {
+                                rpi->downlink.frame->smip.Ctrl.Data = LDV_CTRL_EXTHDR;
+                            } else if (rpi->downlink.frame->smip.Header.Length) {
+                                rpi->downlink.frame->smip.Ctrl.Data = LDV_CTRL_PAYLOAD;
+                            }
+                        } else if (rpi->downlink.frame->smip.Ctrl.Data == LDV_CTRL_EXTHDR) {
+                            rpi->downlink.frame->smip.Ctrl.Data = LDV_CTRL_PAYLOAD;
+                        } else {
+                            rpi->downlink.frame->smip.Ctrl.Data = LDV_CTRL_HEADER;
+                        }
+
+                        if (rpi->downlink.frame->smip.Ctrl.Data != LDV_CTRL_HEADER) {
+                            /*
+                             * There is at least one more segment to work on.
+                             */
+                            new_state = TXS_AwaitCtsDeassert;
+                        } else {
+                            /*
+                             * Nothing else to do for this frame. Discard it:
+                             */
+                            DownlinkRelease(rpi);
+                            rpi->downlink.timer = 0;
+                            new_state = TXS_Idle;
+#if SUPPORT_SUSPEND
+
+                            /*
+                             * Signal completion of suspension requests.
+                             */
+                            if (IS_SUSPEND_DL_SYNCHED(rpi->downlink.suspend)) {
+                                rpi->downlink.suspended = rpi->downlink.suspend;
+                                rpi->downlink.state = TXS_Idle;
+                                break;
+                            }
+
+#endif  //  SUPPORT_SUSPEND
+                        }
+                    }
+                }
+            }   // state TXS_AwaitCtsAssert
+        } while (rpi->downlink.state != new_state);
+    }   // if not immediate suspension or reset
+}
+
+/*
+ * UplinkPending() returns the number of bytes in the uplink byte ring.
+ */
+static unsigned UplinkPending(RpiHandle* rpi)
+{
+    return rpi->uplink.bytes.tail - rpi->uplink.bytes.head;
+}
+
+/*
+ * UplinkThrottle() removes the serial port from the SIO thread's epoll set
+ * while the uplink byte ring is full, and restores it when space becomes
+ * available. Otherwise, the level-triggered serial port event would keep
+ * the thread spinning until the application drains the uplink queue.
+ */
+static void UplinkThrottle(RpiHandle* rpi, int throttle)
+{
+    if (throttle != rpi->uplink.throttled) {
+        struct epoll_event event;
+
+        memset(&event, 0, sizeof(event));
+        event.events = throttle ? 0 : EPOLLIN;
+        event.data.fd = rpi->fd.sio;
+
+        epoll_ctl(rpi->fd.epl, EPOLL_CTL_MOD, rpi->fd.sio, &event);
+        rpi->uplink.throttled = throttle;
+    }
+}
+
+/*
+ * UplinkRead() reads as much data as is available and fits into the free
+ * space of the uplink byte ring with a single system call. The function
+ * returns the number of bytes read.
+ */
+static unsigned UplinkRead(RpiHandle* rpi)
+{
+    unsigned space = rpi->uplink.bytes.size - UplinkPending(rpi);
+    unsigned offset = rpi->uplink.bytes.tail & (rpi->uplink.bytes.size - 1);
+    unsigned contiguous = min(space, rpi->uplink.bytes.size - offset);
+    struct iovec iov[2] = {
+        { rpi->uplink.bytes.data + offset, contiguous },
+        { rpi->uplink.bytes.data, space - contiguous }
+    };
+    ssize_t accepted = 0;
+
+    if (space) {
+        accepted = readv(rpi->fd.sio, iov, space > contiguous ? 2 : 1);
+    }
+
+    if (accepted > 0) {
+        rpi->uplink.bytes.tail += accepted;
+    } else {
+        accepted = 0;
+    }
+
+    return (unsigned) accepted;
+}
+
+/*
+ * UplinkCopy() copies 'size' bytes from the uplink byte ring, starting
+ * 'offset' bytes past the oldest byte, to 'destination'.
+ */
+static void UplinkCopy(RpiHandle* rpi, unsigned offset, uint8_t* destination, unsigned size)
+{
+    unsigned start = (rpi->uplink.bytes.head + offset) & (rpi->uplink.bytes.size - 1);
+    unsigned contiguous = min(size, rpi->uplink.bytes.size - start);
+
+    memcpy(destination, rpi->uplink.bytes.data + start, contiguous);
+    memcpy(destination + contiguous, rpi->uplink.bytes.data, size - contiguous);
+}
+
+/*
+ * UplinkDiscard() discards all uplink data received so far, including a
+ * complete frame awaiting enqueue.
+ */
+static void UplinkDiscard(RpiHandle* rpi)
+{
+    if (rpi->uplink.frame) {
+        LdvqFree(rpi->uplink.queue, &rpi->uplink.frame->smip);
+        rpi->uplink.frame = NULL;
+    }
+
+    rpi->uplink.bytes.head = rpi->uplink.bytes.tail;
+}
+
+/*
+ * UplinkComplete() returns the size of the complete frame at the head of
+ * the uplink byte ring, or zero if no complete frame is available.
+ */
+static unsigned UplinkComplete(RpiHandle* rpi)
+{
+    unsigned result = 0;
+    unsigned pending = UplinkPending(rpi);
+
+    if (pending >= sizeof(LonSmipHdr)) {
+        LonSmipHdr header;
+
+        UplinkCopy(rpi, 0, (uint8_t*) &header, sizeof(header));
+
+        if (pending >= sizeof(LonSmipHdr) + header.Length) {
+            result = sizeof(LonSmipHdr) + header.Length;
+        }
+    }
+
+    return result;
+}
+
+/*
+ * UplinkBuffer() takes a frame buffer from the uplink queue's pool. When
+ * the pool is exhausted and the overflow policy permits, the function
+ * discards the oldest frame of ordinary network traffic still queued for
+ * the application, and re-uses its buffer. The function returns NULL if no
+ * buffer is available.
+ */
+static LonSmipMsg* UplinkBuffer(RpiHandle* rpi)
+{
+    LonSmipMsg* frame = NULL;
+
+    if (LdvqAllocRaw(rpi->uplink.queue, &frame) != LonApiNoError) {
+        frame = NULL;
+
+        if (rpi->uplink.overflow == LdvOverflowDropOldest) {
+            frame = LdvqPop(rpi->uplink.lane[UL_Normal]);
+
+            if (frame) {
+                rpi->uplink.dropped += 1;
+            }
+        }
+    }
+
+    return frame;
+}
+
+/*
+ * UplinkValid() returns TRUE if the header can start an uplink frame: the
+ * command is one the Micro Server sends, and the length fits a frame.
+ */
+static int UplinkValid(const LonSmipHdr* header)
+{
+    const unsigned command = header->Command;
+    int result = FALSE;
+
+    if ((command & LonNiNv) == LonNiNv) {
+        /*
+         * The lower six bits hold a network variable index.
+         */
+        return header->Length <= LON_SMIP_MAX_DATA;
+    }
+
+    switch (command & 0xF0) {
+    case LonNiComm:
+    case LonNiNetManagement:
+        switch (command & 0x0F) {
+        case LonNiTxQueue:
+        case LonNiTxQueuePriority:
+        case LonNiNonTxQueue:
+        case LonNiNonTxQueuePriority:
+        case LonNiResponse:
+        case LonNiIncoming:
+            result = TRUE;
+            break;
+        }
+        break;
+
+    case LonNiPhase:
+        result = TRUE;
+        break;
+
+    default:
+        switch (command) {
+        case LonNiXOff:
+        case LonNiXOn:
+        case LonNiService:
+        case LonNiServiceHeld:
+        case LonNiUsop:
+        case LonNiReset:
+        case LonNiFlushComplete:
+        case LonIsiNack:
+        case LonIsiAck:
+        case LonIsiCmd:
+            result = TRUE;
+            break;
+        }
+        break;
+    }
+
+    return result && header->Length <= LON_SMIP_MAX_DATA;
+}
+
+/*
+ * UplinkResync() examines the header at the head of the uplink byte ring in
+ * resync mode. If the header is not valid, the function discards one byte
+ * and returns TRUE; the next byte may then start a valid frame.
+ */
+static int UplinkResync(RpiHandle* rpi, const LonSmipHdr* header)
+{
+    if (!rpi->uplink.resync || UplinkValid(header)) {
+        rpi->uplink.resyncing = FALSE;
+        return FALSE;
+    }
+
+    if (!rpi->uplink.resyncing) {
+        RPI_TRACE(rpi->trace, "Uplink resync (%02X.%02X)\n", header->Length, header->Command);
+        rpi->uplink.resyncing = TRUE;
+        rpi->uplink.resyncs += 1;
+    }
+
+    rpi->uplink.bytes.head += 1;
+    rpi->uplink.skipped += 1;
+
+    return TRUE;
+}
+
+/*
+ * UplinkAssemble() takes the next complete frame off the uplink byte ring
+ * and places it in a frame buffer taken from the uplink queue's pool. The
+ * function returns TRUE if a complete frame was assembled; this frame is
+ * then held in rpi->uplink.frame. The frame remains in the byte ring if no
+ * frame buffer is available, unless the overflow policy discards it.
+ */
+static int UplinkAssemble(RpiHandle* rpi)
+{
+    int result = FALSE;
+    int discarded = FALSE;
+
+    do {
+        unsigned pending = UplinkPending(rpi);
+
+        discarded = FALSE;
+
+        if (pending >= sizeof(LonSmipHdr)) {
+            LonSmipHdr header;
+            unsigned size = 0;
+            LonSmipMsg* frame = NULL;
+
+            UplinkCopy(rpi, 0, (uint8_t*) &header, sizeof(header));
+            size = sizeof(LonSmipHdr) + header.Length;
+
+            if (UplinkResync(rpi, &header)) {
+                /*
+                 * Try the next byte.
+                 */
+                discarded = TRUE;
+                continue;
+            }
+
+            if (header.Command == LonNiReset) {
+                /*
+                 * The Micro Server reports a reset. The driver must handle
+                 * this immediately by canceling any in-progress downlink
+                 * transfer in order to preserve link layer integrity.
+                 *
+                 * The IzoT ShortStack Micro Server (version 4.30) introduces
+                 * a configurable post-reset pause, but if this pause is too
+                 * short, disabled, or not supported with an older Micro
+                 * Server, this receiver code here must take action
+                 * immediately.
+                 */
+                Downlink(rpi, TEV_Reset);
+            }
+
+            if (header.Length > LON_SMIP_MAX_DATA) {
+                /*
+                 * This can't be a valid frame. Discard all data received so
+                 * far and start over.
+                 */
+                RPI_TRACE(rpi->trace, "Uplink frame too large (%u)\n", header.Length);
+                rpi->uplink.bytes.head = rpi->uplink.bytes.tail;
+            } else if (pending >= size && (frame = UplinkBuffer(rpi)) != NULL) {
+                /*
+                 * Receive the frame directly into the pool-owned buffer. Only
+                 * the driver-specific fields which follow the payload require
+                 * initialization.
+                 */
+                rpi->uplink.frame = (LinkLayerFrame*) frame;
+                UplinkCopy(rpi, 0, rpi->uplink.frame->raw, size);
+                rpi->uplink.bytes.head += size;
+
+                memset(&frame->ExtHdr, 0, sizeof(frame->ExtHdr));
+                memset(&frame->Ctrl, 0, sizeof(frame->Ctrl));
+                frame->Id = ++rpi->uplink.id;
 
-                    if (write(rpi->fd.sio, data, size) == size) {
-                        /*
-                         * The write succeeded. It is unlikely to fail on a Linux
-                         * host (the kernel typically maintains a 4096 byte buffer),
-                         * but if it does fail, we do nothing and let the timeout
-                         * run. We'll automatically try again with the next tick.
-                         *
-                         * But here, it did succeed. See if there is more to transfer.
-                         * Otherwise, be done.
-                         */
-                        LogFrame(
-                            rpi, "DN",
-                            &rpi->downlink.frame->smip,
-                            rpi->downlink.frame->smip.Ctrl.Data
-                        );
+                LogFrame(rpi, LDV_LOG_UP, frame, LDV_CTRL_UP);
+                result = TRUE;
+            } else if (pending >= size && rpi->uplink.overflow == LdvOverflowDropNewest) {
+                /*
+                 * No frame buffer is available. Discard this frame, and
+                 * try the next.
+                 */
+                RPI_TRACE(rpi->trace, "Uplink frame dropped (%02X)\n", header.Command);
+                rpi->uplink.bytes.head += size;
+                rpi->uplink.dropped += 1;
+                discarded = TRUE;
+            }
+        }
+    } while (discarded);
 
-                        /*
-                         * Determine what's next.
-                         */
-                        if (rpi->downlink.frame->smip.Ctrl.Data == LDV_CTRL_HEADER) {
-                            if (rpi->downlink.frame->smip.ExtHdr.Index) {
-                                rpi->downlink.frame->smip.Ctrl.Data = LDV_CTRL_EXTHDR;
-                            } else if (rpi->downlink.frame->smip.Header.Length) {
-                                rpi->downlink.frame->smip.Ctrl.Data = LDV_CTRL_PAYLOAD;
-                            }
-                        } else if (rpi->downlink.frame->smip.Ctrl.Data == LDV_CTRL_EXTHDR) {
-                            rpi->downlink.frame->smip.Ctrl.Data = LDV_CTRL_PAYLOAD;
-                        } else {
-                            rpi->downlink.frame->smip.Ctrl.Data = LDV_CTRL_HEADER;
-                        }
+    return result;
+}
 
-                        if (rpi->downlink.frame->smip.Ctrl.Data != LDV_CTRL_HEADER) {
-                            /*
-                             * There is at least one more segment to work on.
-                             */
-                            new_state = TXS_AwaitCtsDeassert;
-                        } else {
-                            /*
-                             * Nothing else to do for this frame. Discard it:
-                             */
-                            LdvqFree(rpi->downlink.queue, (LonSmipMsg*) rpi->downlink.frame);
-                            rpi->downlink.frame = NULL;
-                            rpi->downlink.timer = 0;
-                            new_state = TXS_Idle;
-#if SUPPORT_SUSPEND
+/*
+ * UplinkClassify() selects the uplink lane for a frame, based on the
+ * frame's network interface command.
+ */
+static UplinkLane UplinkClassify(const LonSmipMsg* pFrame)
+{
+    const unsigned command = pFrame->Header.Command;
 
-                            /*
-                             * Signal completion of suspension requests.
-                             */
-                            if (IS_SUSPEND_DL_SYNCHED(rpi->downlink.suspend)) {
-                                rpi->downlink.suspended = rpi->downlink.suspend;
-                                rpi->downlink.state = TXS_Idle;
-                                break;
-                            }
+    return ((command & 0xF0) == LonNiComm || (command & 0xF0) == LonNiNetManagement)
+           ? UL_Normal : UL_Control;
+}
 
-#endif  //  SUPPORT_SUSPEND
-                        }
-                    }
-                }
-            }   // state TXS_AwaitCtsAssert
-        } while (rpi->downlink.state != new_state);
-    }   // if not immediate suspension or reset
+/*
+ * UplinkExpect() tunes the serial port's VMIN setting to the number of
+ * bytes which complete the frame being received, so that the SIO thread is
+ * woken once for the remainder of a frame rather than for each fragment.
+ * VMIN is one while no partial frame is pending, and while fewer than
+ * UPLINK_VMIN_THRESHOLD bytes remain. The uplink data timeout still
+ * governs incomplete frames. This requires the low latency option.
+ *
+ * The serial port is non-blocking, so VMIN does not affect read(). The
+ * tuning relies on the N_TTY line discipline's poll, which reports a
+ * non-canonical port with VTIME zero as readable only once VMIN bytes are
+ * available. LdvOpen() enables the tuning only with this line discipline.
+ *
+ * The current setting is kept in 'vmin', and tcsetattr() is only called
+ * when the setting changes.
+ */
+static void UplinkExpect(RpiHandle* rpi)
+{
+    if (rpi->uplink.vmin) {
+        const unsigned pending = UplinkPending(rpi);
+        const unsigned space = rpi->uplink.bytes.size - pending;
+        unsigned expected = 1;
+
+        if (pending >= sizeof(LonSmipHdr)) {
+            LonSmipHdr header;
+            unsigned size = 0;
+
+            UplinkCopy(rpi, 0, (uint8_t*) &header, sizeof(header));
+            size = sizeof(LonSmipHdr) + header.Length;
+
+            if (size > pending) {
+                expected = size - pending;
+            }
+        }
+
+        if (expected > space) {
+            expected = space;
+        }
+
+        if (expected > 255) {
+            expected = 255;
+        }
+
+        if (expected < UPLINK_VMIN_THRESHOLD) {
+            expected = 1;
+        }
+
+        if (expected != rpi->uplink.vmin) {
+            rpi->uplink.termios.c_cc[VMIN] = (cc_t) expected;
+
+            if (tcsetattr(rpi->fd.sio, TCSANOW, &rpi->uplink.termios) == 0) {
+                rpi->uplink.vmin = expected;
+                rpi->uplink.vminChanges += 1;
+            }
+        }
+    }
 }
 
 /*
  * Uplink() is called from the SIO thread. The function retrieves incoming
  * ('uplink') data and handles timeout conditions. The function enqueues
- * an incoming frame (once successfully received) in the uplink queue.
+ * each incoming frame (once successfully received) in the uplink queue.
  * The host API retrieves it from there with the standard Ldv* API functions.
  */
 static void Uplink(RpiHandle* rpi, ThreadEvent tev)
@@ -678,7 +1852,8 @@ static void Uplink(RpiHandle* rpi, ThreadEvent tev)
     if (tev == TEV_Reset
     || IS_SUSPEND_UL_IMMEDIATE(rpi->uplink.suspend)
     || (IS_SUSPEND_UL_SYNCHED(rpi->uplink.suspend)
-        && rpi->uplink.buffered == 0)
+        && rpi->uplink.frame == NULL
+        && UplinkPending(rpi) == 0)
     ) {
 #else
 
@@ -687,158 +1862,155 @@ static void Uplink(RpiHandle* rpi, ThreadEvent tev)
         /*
          * Take care of immediate suspension requests.
          */
-        rpi->uplink.timer = rpi->uplink.buffered = rpi->uplink.expected = 0;
+        rpi->uplink.timer = rpi->uplink.retry = 0;
+        UplinkDiscard(rpi);
 #if SUPPORT_SUSPEND
         rpi->uplink.suspended = rpi->uplink.suspend;
 #endif  //  SUPPORT_SUSPEND
     } else {
-        if (tev == TEV_Tick) {
-            if (rpi->uplink.timer) {
-                rpi->uplink.timer -= 1;
-
-                if (rpi->uplink.timer == 0) {
-                    /* Timeout. */
-                    rpi->uplink.timeouts += 1;
-                    rpi->uplink.buffered = rpi->uplink.expected = 0;
-                    RPI_TRACE(rpi->trace, "Uplink timeout\n");
-                }
+        if (tev == TEV_Timer) {
+            const uint64_t now = Now();
+
+            if (Expired(rpi->uplink.retry, now)) {
+                /* Retry now, below. */
+                rpi->uplink.retry = 0;
             }
-        } else if (tev == TEV_Data) {
-            int available = 0;
 
-            if (ioctl(rpi->fd.sio, FIONREAD, &available) == -1) {
-                available = 0; /* to be safe in case ioctl modified it */
+            if (Expired(rpi->uplink.timer, now)) {
+                /* Timeout. */
+                rpi->uplink.timeouts += 1;
+                rpi->uplink.timer = rpi->uplink.retry = 0;
+                UplinkDiscard(rpi);
+                RPI_TRACE(rpi->trace, "Uplink timeout\n");
             }
+        } else if (tev == TEV_Data) {
+            /*
+             * Note whether a partial frame awaits more data, so that the
+             * gap between the portions of a frame can be observed.
+             */
+            const int partial = rpi->uplink.frame == NULL
+                                && UplinkPending(rpi) && !UplinkComplete(rpi);
+
+            if (UplinkRead(rpi)) {
+                const uint64_t now = Now();
+
+                if (partial && rpi->adaptive.received) {
+                    const unsigned bucket = LatencyBucket(now - rpi->adaptive.received);
+
+                    rpi->uplink.segments[rpi->uplink.vmin > 1][bucket] += 1;
+                    AdaptiveSample(rpi->adaptive.uplinkData, bucket);
+                }
+
+                rpi->adaptive.received = now;
 
-            if (available) {
                 /*
                  * Kill the timeout right away (we may need to arm it again
                  * later).
                  */
                 rpi->uplink.timer = 0;
-
-                if (rpi->uplink.buffered == 0) {
-                    /*
-                     * Start a new frame
-                     */
-                    int accepted = read(
-                                       rpi->fd.sio,
-                                       rpi->uplink.frame.raw,
-                                       min(sizeof(LonSmipHdr), available)
-                                   );
-
-                    if (accepted > 0) {
-                        rpi->uplink.frame.smip.Id = ++rpi->uplink.id;
-                        /* What we have. */
-                        rpi->uplink.buffered = accepted;
-                        /* What is yet to come. */
-                        /* Assumes the Length is in the *first* header byte */
-                        rpi->uplink.expected =
-                            rpi->uplink.frame.smip.Header.Length
-                            + sizeof(LonSmipHdr)
-                            - rpi->uplink.buffered;
-                        /* What is left in the OS buffer. */
-                        available -= accepted;
-                    }
-                }
             }
+        }
 
-            if (available) {
-                /*
-                 * More data available.
-                 */
-                if (rpi->uplink.expected > 0) {
-                    /*
-                     * Add more incoming data to the temporary buffer
-                     */
-                    int accepted = read(
-                                       rpi->fd.sio,
-                                       rpi->uplink.frame.raw + rpi->uplink.buffered,
-                                       min(rpi->uplink.expected, available)
-                                   );
-
-                    if (accepted > 0) {
-                        rpi->uplink.buffered += accepted;
-                        rpi->uplink.expected -= accepted;
-                    }
-                }
+        /*
+         * Enqueue as many complete frames as we have, and get ready for the
+         * next one.
+         */
+        while (rpi->uplink.frame || UplinkAssemble(rpi)) {
+            LonSmipMsg* frame = &rpi->uplink.frame->smip;
+
+            if (LdvqPush(rpi->uplink.lane[UplinkClassify(frame)], frame) != LonApiNoError) {
+                break;
             }
 
-            if (rpi->uplink.buffered > 0) {
+            /*
+             * OK, the frame is now in the queue, from where the API will
+             * fetch it with LdvGetMsg(). The frame buffer now belongs to the
+             * API.
+             */
+            rpi->uplink.frame = NULL;
+            rpi->uplink.timer = rpi->uplink.retry = 0;
 
-                if (rpi->uplink.buffered >= sizeof(LonSmipHdr)
-                && rpi->uplink.frame.smip.Header.Command == LonNiReset) {
-                    /*
-                     * The Micro Server reports a reset. The driver must handle
-                     * this immediately by canceling any in-progress downlink
-                     * transfer in order to preserve link layer integrity.
-                     *
-                     * The IzoT ShortStack Micro Server (version 4.30) introduces
-                     * a configurable post-reset pause, but if this pause is too
-                     * short, disabled, or not supported with an older Micro
-                     * Server, this receiver code here must take action
-                     * immediately.
-                     */
-                    Downlink(rpi, TEV_Reset);
-                }
+            if (rpi->startup.ready == 0) {
+                rpi->startup.ready = (unsigned long) (Now() - rpi->startup.opened);
+            }
+#if SUPPORT_SUSPEND
 
-                if (rpi->uplink.expected > 0) {
-                    /*
-                     * More bytes are expected. Arm the timeout.
-                     */
-                    rpi->uplink.timer = TIMEOUT_UPLINK_DATA;
-                } else {
-                    /*
-                     * We have a complete frame. Set a very long timeout to
-                     * monitor the time it takes to enqueue this. This should
-                     * not normally take any time at all, but the queue may be
-                     * finite and we may need to wait until space becomes
-                     * available.
-                     */
-                    rpi->uplink.timer = TIMEOUT_UPLINK_ENQUEUE;
-                }
+            /*
+             * Signal completion of suspension requests.
+             */
+            if (IS_SUSPEND_UL_SYNCHED(rpi->uplink.suspend)) {
+                rpi->uplink.suspended = rpi->uplink.suspend;
+                break;
             }
+
+#endif  //  SUPPORT_SUSPEND
         }
 
-        if (rpi->uplink.expected == 0
-        && rpi->uplink.buffered >= sizeof(LonSmipHdr)) {
+        if (rpi->uplink.frame || UplinkComplete(rpi)) {
             /*
-             * The frame is complete, so let's enqueue it and get ready for the
-             * next one.
+             * We have a complete frame, but either no frame buffer or no
+             * room in the queue, maybe because the pool or queue have finite
+             * capacity and are exhausted. We try again with the next
+             * interrupt or when the retry timer expires.
              */
-            if (LdvqCopy(rpi->uplink.queue, &rpi->uplink.frame.smip) == LonApiNoError) {
+            if (rpi->uplink.retry == 0) {
+                rpi->uplink.retry = Deadline(TIMEOUT_RETRY);
+            }
+        }
+
+        if (rpi->uplink.timer == 0) {
+            if (rpi->uplink.frame || UplinkComplete(rpi)) {
                 /*
-                 * OK, a copy of this frame is now in the queue, from where the
-                 * API will fetch it with LdvGetMsg().
-                 *
-                 * If the LdvqCopy call fails, maybe because the queue has finite
-                 * capacity and is full, we try again with the next interrupt or
-                 * tick. In this case, a large timeout is already armed. This uses
-                 * a large value, because the most likely reason for the enqueue
+                 * Set a very long timeout to monitor the time it takes to
+                 * enqueue the complete frame. This should not normally take
+                 * any time at all, but the queue may be finite and we may
+                 * need to wait until space becomes available. This uses a
+                 * large value, because the most likely reason for the enqueue
                  * operation to fail is that the application is too busy with
                  * higher priority tasks and can't serve our queue right now.
-                 *
-                 * Here, it succeeded.
                  */
-                LogFrame(rpi, "UP", &rpi->uplink.frame.smip, LDV_CTRL_UP);
-
-                rpi->uplink.buffered = rpi->uplink.expected = 0;
-                rpi->uplink.timer = 0;
-#if SUPPORT_SUSPEND
-
+                rpi->uplink.timer = Deadline(TIMEOUT_UPLINK_ENQUEUE);
+            } else if (UplinkPending(rpi)) {
                 /*
-                 * Signal completion of suspension requests.
+                 * More bytes are expected. Arm the timeout.
                  */
-                if (IS_SUSPEND_UL_SYNCHED(rpi->uplink.suspend)) {
-                    rpi->uplink.suspended = rpi->uplink.suspend;
-                }
-
-#endif  //  SUPPORT_SUSPEND
+                rpi->uplink.timer = Deadline(
+                    UplinkDataTimeout(rpi)
+                );
             }
         }
     }
+
+    UplinkThrottle(rpi, UplinkPending(rpi) == rpi->uplink.bytes.size);
+    UplinkExpect(rpi);
+}
+
+/*
+ * PrefaultStack() touches STACK_PREFAULT bytes of the calling thread's
+ * stack, one page at a time, so that these pages are resident and (with
+ * mlockall) remain so.
+ */
+static void PrefaultStack(void)
+{
+    volatile uint8_t stack[STACK_PREFAULT];
+    const long page = sysconf(_SC_PAGESIZE);
+
+    for (long offset = 0; offset < STACK_PREFAULT; offset += page > 0 ? page : 4096) {
+        stack[offset] = 0;
+    }
+
+    (void) stack[0];
 }
 
+/*
+ * SIO_EVENTS is the number of file descriptors which LdvOpen() registers
+ * with the SIO thread's epoll instance: the serial port, the control pipe,
+ * the downlink event, the CTS input and the timerfd. One epoll_wait() call
+ * can therefore report all of them, and no descriptor is starved by the
+ * others in a busy iteration.
+ */
+#define SIO_EVENTS  5
+
 /*
  * sio_thread is the serial I/O thread.
  */
@@ -846,75 +2018,74 @@ static void* SioThread(void* arg)
 {
     RpiHandle* rpi = (RpiHandle*) arg;
     int running = TRUE;
-    fd_set read_fds, write_fds, interrupt_fds;
-    struct timeval timeout = { 0, TIMEOUT_IN_MICROSECONDS };
+    struct epoll_event events[SIO_EVENTS];
     int selected = 0;
-    int nfds = -1;
+
+    if (rpi->thread.lock) {
+        PrefaultStack();
+    }
 
     while (running) {
+        int pipe_event = FALSE, sio_event = FALSE, cts_event = FALSE;
+        int timer_event = FALSE, downlink_event = FALSE;
+        int i;
+
 #if SUPPORT_SUSPEND
         /*
-         * Grab the suspend_mutex. When the thread is suspended, the suspender
-         * holds that mutex, and the following lock() call does not return
-         * until the suspended resumes the thread.
+         * When the thread is suspended, the suspender holds the suspend
+         * mutex, and the following lock() call does not return until the
+         * suspender resumes the thread.
          * This is done to minimize CPU activity while the driver is suspended,
          * which is sometimes needed during time-critical operations.
          *
          * This mutex is only used to hold the driver thread in suspension, so
          * we can unlock it as soon as we acquire it. This reduces the risk of
-         * failing to unlock it later.
+         * failing to unlock it later. The mutex is not touched while the
+         * driver is not suspended.
          */
-        pthread_mutex_lock(&rpi->thread.mutex);
-        pthread_mutex_unlock(&rpi->thread.mutex);
+        if (rpi->uplink.suspended || rpi->downlink.suspended) {
+            pthread_mutex_lock(&rpi->thread.mutex);
+            pthread_mutex_unlock(&rpi->thread.mutex);
+        }
 #endif  //  SUPPORT_SUSPEND
 
         /*
-         * Prepare the file descriptor arrays and timeout structure for
-         * select(). Remember that select() modifies the file descriptor
-         * arguments, and some implementations (Linux in particular)
-         * modify the timeout argument, so these must be initialized
-         * before each select() call.
+         * Wait for events on the serial port, the control pipe, the CTS
+         * input and the timerfd. These are registered with the epoll
+         * instance once, in LdvOpen().
          *
-         * We use a timeout of 10ms. This provides a base tick for the
-         * uplink and downlink engines to implement their various actual
-         * timeout values.
+         * There is no timeout. The uplink and downlink engines implement
+         * their timeouts with deadlines, and ArmTimer() arms the timerfd
+         * for the earliest of these, so that an idle driver sleeps until
+         * something happens.
          */
+        selected = epoll_wait(
+                       rpi->fd.epl,
+                       events,
+                       sizeof(events) / sizeof(events[0]),
+                       -1
+                   );
 
-        FD_ZERO(&read_fds);
-        FD_ZERO(&write_fds);
-        FD_ZERO(&interrupt_fds);
-        nfds = 0;
-
-        FD_SET(rpi->fd.sio, &read_fds);
-        nfds = max(nfds, rpi->fd.sio);
-
-        FD_SET(rpi->fd.epo, &read_fds);
-        nfds = max(nfds, rpi->fd.epo);
-
-        FD_SET(rpi->fd.cts, &interrupt_fds);
-        nfds = max(nfds, rpi->fd.cts);
-
-        timeout.tv_sec = 0;
-        timeout.tv_usec = TIMEOUT_IN_MICROSECONDS;
-
-        selected = select(nfds + 1, &read_fds, &write_fds, &interrupt_fds, &timeout);
-
-        if (selected == 0) {
-            /*
-             * Timeout. We use this to implement various timeouts based on this
-             * 10 ms ticker. Arguably this time base is not reliable, because a
-             * very busy device may rarely see a select() call timing out.
-             * However, a device busy sending and receiving data will not be
-             * suffering from timeout conditions, so this consideration is more
-             * of an academic nature.
-             */
-            Uplink(rpi, TEV_Tick);
-            Downlink(rpi, TEV_Tick);
-        } else if (selected > 0) {
+        if (selected > 0) {
             /*
-             * We've got work to do.
+             * We've got work to do. Collect the events first, so that they
+             * are always handled in the same order.
              */
-            if (FD_ISSET(rpi->fd.epo, &read_fds)) {
+            for (i = 0; i < selected; ++i) {
+                if (events[i].data.fd == rpi->fd.epo) {
+                    pipe_event = TRUE;
+                } else if (events[i].data.fd == rpi->fd.sio) {
+                    sio_event = TRUE;
+                } else if (events[i].data.fd == rpi->gpio.cts.fd) {
+                    cts_event = TRUE;
+                } else if (events[i].data.fd == rpi->fd.tmr) {
+                    timer_event = TRUE;
+                } else if (events[i].data.fd == rpi->fd.dlw) {
+                    downlink_event = TRUE;
+                }
+            }
+
+            if (pipe_event) {
                 /*
                  * A Pipe event wants to be read
                  */
@@ -923,8 +2094,6 @@ static void* SioThread(void* arg)
                 if (read(rpi->fd.epo, &event, sizeof(event)) == sizeof(event)) {
                     if (event == PEV_Terminate) {
                         running = FALSE;
-                    } else if (event == PEV_Wakeup) {
-                        Downlink(rpi, TEV_Wakeup);
                     } else if (event == PEV_Reset) {
                         Uplink(rpi, TEV_Reset);
                         Downlink(rpi, TEV_Reset);
@@ -948,52 +2117,256 @@ static void* SioThread(void* arg)
                 }
             }
 
-            if (FD_ISSET(rpi->fd.sio, &read_fds)) {
+            if (downlink_event) {
+                /*
+                 * A downlink lane became non-empty. Clear the event before
+                 * the downlink engine examines the lanes, so that a frame
+                 * pushed meanwhile signals it again.
+                 */
+                uint64_t count;
+
+                read(rpi->fd.dlw, &count, sizeof(count));
+                Downlink(rpi, TEV_Wakeup);
+            }
+
+            if (sio_event) {
                 /*
                  * Uplink data waiting to be read
                  */
                 Uplink(rpi, TEV_Data);
             }
 
-            if (FD_ISSET(rpi->fd.cts, &interrupt_fds)) {
+            if (cts_event) {
                 /*
                  * A CTS edge occurred. Read its current state:
                  */
-                if (lseek(rpi->fd.cts, 0, SEEK_SET) != -1) {
-                    char buffer;
-                    ssize_t bytes = read(rpi->fd.cts, &buffer, sizeof(buffer));
+                CtsEvent(rpi);
+                Downlink(rpi, TEV_CTS);
+            }
 
-                    if (bytes == ssizeof(buffer)) {
-                        rpi->gpio.state.cts = buffer == '0';
-                    }
-                }
+            if (timer_event) {
+                /*
+                 * The timerfd expired and is now disarmed. Let the uplink and
+                 * downlink engines examine their deadlines.
+                 */
+                uint64_t expirations;
 
-                Downlink(rpi, TEV_CTS);
+                read(rpi->fd.tmr, &expirations, sizeof(expirations));
+                rpi->thread.deadline = 0;
+
+                Uplink(rpi, TEV_Timer);
+                Downlink(rpi, TEV_Timer);
+            }
+        }
+
+        ArmTimer(rpi);
+
+#if SUPPORT_SUSPEND
+
+        /*
+         * Check if suspend requests have been met.
+         */
+        if (rpi->uplink.suspend
+        && rpi->uplink.suspend == rpi->uplink.suspended
+        && rpi->downlink.suspend
+        && rpi->downlink.suspend == rpi->downlink.suspended) {
+            /*
+             * Clear the request and report success.
+             */
+            LonApiError result = LonApiNoError;
+            rpi->uplink.suspend = rpi->downlink.suspend = 0;
+            write(rpi->fd.spi, &result, sizeof(result));
+        }
+
+#endif  //  SUPPORT_SUSPEND
+
+    }   // while running
+
+    return NULL;
+}
+
+/*
+ * Watch() adds a file descriptor to the SIO thread's epoll instance.
+ * Returns -1 in case of failure.
+ */
+static int Watch(int epl, int fd, uint32_t events)
+{
+    struct epoll_event event;
+
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.fd = fd;
+
+    return epoll_ctl(epl, EPOLL_CTL_ADD, fd, &event);
+}
+
+/*
+ * UplinkEmpty() returns TRUE when all uplink lanes are empty.
+ */
+static int UplinkEmpty(RpiHandle* rpi)
+{
+    return LdvqEmpty(rpi->uplink.lane[UL_Control])
+           && LdvqEmpty(rpi->uplink.lane[UL_Normal]);
+}
+
+/*
+ * ClearUplinkEvent() clears the uplink event once all uplink lanes have
+ * been drained, then checks again: the SIO thread may have pushed another
+ * frame and signalled the event just before it was cleared.
+ */
+static void ClearUplinkEvent(RpiHandle* rpi)
+{
+    if (UplinkEmpty(rpi)) {
+        uint64_t count;
+
+        if (read(rpi->fd.ulw, &count, sizeof(count)) == sizeof(count)
+            && !UplinkEmpty(rpi)) {
+            count = 1;
+            write(rpi->fd.ulw, &count, sizeof(count));
+        }
+    }
+}
+
+/*
+ * StartSioThread() creates the SIO thread with the scheduling policy and
+ * CPU affinity requested in LdvCtrl.thread. Real-time scheduling requires
+ * the CAP_SYS_NICE capability or a suitable RLIMIT_RTPRIO; without these,
+ * the thread runs with the default policy instead.
+ */
+static int StartSioThread(RpiHandle* rpi, const LdvCtrl* ctrl)
+{
+    pthread_attr_t attributes;
+    int result = 0;
+
+    pthread_attr_init(&attributes);
+
+    if (ctrl->thread.priority) {
+        struct sched_param parameters;
+
+        memset(&parameters, 0, sizeof(parameters));
+        parameters.sched_priority = ctrl->thread.priority;
+
+        pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attributes, SCHED_FIFO);
+        pthread_attr_setschedparam(&attributes, &parameters);
+    }
+
+    if (ctrl->thread.cpus) {
+        cpu_set_t cpus;
+
+        CPU_ZERO(&cpus);
+
+        for (unsigned cpu = 0; cpu < sizeof(ctrl->thread.cpus) * 8; ++cpu) {
+            if (ctrl->thread.cpus & (1UL << cpu)) {
+                CPU_SET(cpu, &cpus);
             }
         }
 
-#if SUPPORT_SUSPEND
+        pthread_attr_setaffinity_np(&attributes, sizeof(cpus), &cpus);
+    }
+
+    result = pthread_create(&rpi->thread.sio, &attributes, SioThread, rpi);
+
+    if (result == EPERM && ctrl->thread.priority) {
+        RPI_TRACE(rpi->trace, "Can't use SCHED_FIFO priority %d\n", ctrl->thread.priority);
+        pthread_attr_setinheritsched(&attributes, PTHREAD_INHERIT_SCHED);
+        result = pthread_create(&rpi->thread.sio, &attributes, SioThread, rpi);
+    }
+
+    pthread_attr_destroy(&attributes);
+
+    return result;
+}
+
+/*
+ * SetLowLatency() requests the serial driver's low latency mode. Not all
+ * serial drivers support this.
+ */
+static void SetLowLatency(RpiHandle* rpi)
+{
+    struct serial_struct serial;
+
+    if (ioctl(rpi->fd.sio, TIOCGSERIAL, &serial) == -1) {
+        RPI_TRACE(rpi->trace, "Can't query serial settings (%s)\n", strerror(errno));
+    } else {
+        serial.flags |= ASYNC_LOW_LATENCY;
+
+        if (ioctl(rpi->fd.sio, TIOCSSERIAL, &serial) == -1) {
+            RPI_TRACE(rpi->trace, "Can't select low latency (%s)\n", strerror(errno));
+        }
+    }
+}
+
+/*
+ * PinRequest describes one handshake pin for OpenPin(): either the GPIO
+ * 'port' or the serial port's modem control 'line' is opened, as selected
+ * with LdvCtrl.gpio.backend.
+ */
+typedef struct {
+    RpiHandle* rpi;
+    const LdvCtrl* ctrl;
+    GpioPin* pin;
+    int port;
+    int line;
+    GpioDirection direction;
+} PinRequest;
+
+static void* OpenPin(void* arg)
+{
+    const PinRequest* request = (const PinRequest*) arg;
+    const LdvCtrl* ctrl = request->ctrl;
+
+    if (ctrl->gpio.backend != LdvGpioModem) {
+        GpioPinOpen(request->pin, (GpioBackend) ctrl->gpio.backend,
+                    ctrl->gpio.chip, request->port, request->direction);
+    } else if (request->rpi->fd.sio != -1) {
+        GpioPinOpenModem(request->pin, request->rpi->fd.sio, request->line,
+                         request->direction);
+    } else {
+        request->pin->fd = -1;
+    }
+
+    return NULL;
+}
 
+/*
+ * OpenPins() opens the RTS, CTS and (optional) HRDY pins. With sysfs, each
+ * pin must be exported, and its files become accessible only once udev has
+ * applied its rules. OpenPins() brings up the pins in parallel in this
+ * case, so that these delays overlap.
+ */
+static void OpenPins(RpiHandle* rpi, const LdvCtrl* ctrl)
+{
+    const PinRequest requests[] = {
+        { rpi, ctrl, &rpi->gpio.rts, ctrl->gpio.rts, TIOCM_RTS, GpioOutputHigh },
+        { rpi, ctrl, &rpi->gpio.cts, ctrl->gpio.cts, TIOCM_CTS, GpioInputEdges },
         /*
-         * Check if suspend requests have been met.
+         *  The HRDY signal is optional, but if we have it, we should
+         *  deassert it at once.
          */
-        if (rpi->uplink.suspend
-        && rpi->uplink.suspend == rpi->uplink.suspended
-        && rpi->downlink.suspend
-        && rpi->downlink.suspend == rpi->downlink.suspended) {
-            /*
-             * Clear the request and report success.
-             */
-            LonApiError result = LonApiNoError;
-            rpi->uplink.suspend = rpi->downlink.suspend = 0;
-            write(rpi->fd.spi, &result, sizeof(result));
-        }
+        { rpi, ctrl, &rpi->gpio.hrdy, ctrl->gpio.hrdy, TIOCM_DTR, GpioOutputHigh }
+    };
+    const unsigned count = ctrl->gpio.hrdy ? 3 : 2;
+    pthread_t threads[3];
+    int started[3] = { FALSE, FALSE, FALSE };
 
-#endif  //  SUPPORT_SUSPEND
+    rpi->gpio.hrdy.fd = -1;
 
-    }   // while running
+    for (unsigned i = 0; i < count; ++i) {
+        if (ctrl->gpio.backend == LdvGpioSysfs && i < count - 1) {
+            started[i] = pthread_create(&threads[i], NULL, OpenPin, (void*) &requests[i]) == 0;
+        }
 
-    return NULL;
+        if (!started[i]) {
+            OpenPin((void*) &requests[i]);
+        }
+    }
+
+    for (unsigned i = 0; i < count; ++i) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
 }
 
 LonApiError LdvOpen(const LdvCtrl* ctrl, LdvHandle* handle)
@@ -1003,29 +2376,32 @@ LonApiError LdvOpen(const LdvCtrl* ctrl, LdvHandle* handle)
     LonApiError result = LonApiNoError;
 
     memset(rpi, 0, sizeof(RpiHandle));
+    rpi->thread.sio = (pthread_t) -1;   // not started, see LdvClose()
     rpi->trace = ctrl->trace;
+    rpi->startup.opened = Now();
 
-    rpi->gpio.port.rts = ctrl->gpio.rts;
-    rpi->gpio.port.cts = ctrl->gpio.cts;
-    rpi->gpio.port.hrdy = ctrl->gpio.hrdy;
+    rpi->uplink.overflow = ctrl->uplink.overflow ? ctrl->uplink.overflow : LdvOverflowBlock;
+    rpi->uplink.resync = ctrl->uplink.resync;
+    rpi->downlink.overflow = ctrl->downlink.overflow ? ctrl->downlink.overflow : LdvOverflowDropNewest;
+    rpi->uplink.bytes.size = 1;
 
-    if (ctrl->gpio.hrdy) {
-        /*
-         *  The HRDY signal is optional, but if we have it, we should
-         *  deassert it at once.
-         */
-        rpi->fd.hrdy = GpioOpen(ctrl->gpio.hrdy, O_WRONLY, "high", NULL);
-    } else {
-        rpi->fd.hrdy = 0;
+    while (rpi->uplink.bytes.size < (ctrl->uplink.spill ? ctrl->uplink.spill : UPLINK_BUFFER_SIZE)
+           || rpi->uplink.bytes.size < sizeof(LinkLayerFrame)) {
+        rpi->uplink.bytes.size <<= 1;
     }
 
-    rpi->fd.rts = GpioOpen(ctrl->gpio.rts, O_WRONLY, "high", NULL);
-    rpi->fd.cts = GpioOpen(ctrl->gpio.cts, O_RDONLY, "in", "both");
+    rpi->uplink.bytes.data = (uint8_t*) malloc(rpi->uplink.bytes.size);
 
-    rpi->gpio.state.cts = FALSE;    // not asserted
+    if (ctrl->frameLog.records) {
+        rpi->log = LdvLogOpen(ctrl->frameLog.records);
+    }
 
     rpi->fd.sio = open(ctrl->device, O_RDWR | O_NOCTTY | O_NDELAY);
 
+    OpenPins(rpi, ctrl);
+
+    rpi->gpio.state.cts = FALSE;    // not asserted
+
     if (pipe(fds) == -1) {
         rpi->fd.epi = rpi->fd.epo = -1;
     } else {
@@ -1044,15 +2420,20 @@ LonApiError LdvOpen(const LdvCtrl* ctrl, LdvHandle* handle)
 
 #endif  // SUPPORT_SUSPEND
 
+    rpi->fd.ulw = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    rpi->fd.dlw = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    rpi->fd.epl = epoll_create1(EPOLL_CLOEXEC);
+    rpi->fd.tmr = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
     if (rpi->fd.sio == -1) {
         RPI_TRACE(rpi->trace, "Can't connect to %s\n", ctrl->device);
         result = LonApiInitializationFailure;
         LdvClose((LdvHandle) rpi);
-    } else if (rpi->fd.rts == -1) {
+    } else if (rpi->gpio.rts.fd == -1) {
         RPI_TRACE(rpi->trace, "Can't connect to RTS\n");
         result = LonApiInitializationFailure;
         LdvClose((LdvHandle) rpi);
-    } else if (rpi->fd.cts == -1) {
+    } else if (rpi->gpio.cts.fd == -1) {
         RPI_TRACE(rpi->trace, "Can't connect to CTS\n");
         result = LonApiInitializationFailure;
         LdvClose((LdvHandle) rpi);
@@ -1060,15 +2441,51 @@ LonApiError LdvOpen(const LdvCtrl* ctrl, LdvHandle* handle)
         RPI_TRACE(rpi->trace, "Can't create the SIO thread control pipe\n");
         result = LonApiInitializationFailure;
         LdvClose((LdvHandle) rpi);
+    } else if (rpi->fd.ulw == -1) {
+        RPI_TRACE(rpi->trace, "Can't create the uplink event\n");
+        result = LonApiInitializationFailure;
+        LdvClose((LdvHandle) rpi);
+    } else if (rpi->fd.dlw == -1) {
+        RPI_TRACE(rpi->trace, "Can't create the downlink event\n");
+        result = LonApiInitializationFailure;
+        LdvClose((LdvHandle) rpi);
+    } else if (rpi->fd.epl == -1
+           || Watch(rpi->fd.epl, rpi->fd.sio, EPOLLIN) == -1
+           || Watch(rpi->fd.epl, rpi->fd.epo, EPOLLIN) == -1
+           || Watch(rpi->fd.epl, rpi->fd.dlw, EPOLLIN) == -1
+           || Watch(rpi->fd.epl, rpi->gpio.cts.fd, rpi->gpio.cts.events) == -1
+           || rpi->fd.tmr == -1
+           || Watch(rpi->fd.epl, rpi->fd.tmr, EPOLLIN) == -1) {
+        RPI_TRACE(rpi->trace, "Can't create the SIO thread event set\n");
+        result = LonApiInitializationFailure;
+        LdvClose((LdvHandle) rpi);
+    } else if (rpi->uplink.bytes.data == NULL) {
+        RPI_TRACE(rpi->trace, "Can't allocate the uplink spill buffer\n");
+        result = LonApiInitializationFailure;
+        LdvClose((LdvHandle) rpi);
+    } else if (ctrl->frameLog.records && !rpi->log) {
+        RPI_TRACE(rpi->trace, "Can't allocate the frame log\n");
+        result = LonApiInitializationFailure;
+        LdvClose((LdvHandle) rpi);
+    } else if (ctrl->adaptive.multiple && ctrl->adaptive.ceiling
+               && ctrl->adaptive.floor > ctrl->adaptive.ceiling) {
+        RPI_TRACE(
+            rpi->trace, "Adaptive timeout floor %ums exceeds the ceiling %ums\n",
+            ctrl->adaptive.floor, ctrl->adaptive.ceiling
+        );
+        result = LonApiInitializationFailure;
+        LdvClose((LdvHandle) rpi);
     }
 
+    struct termios tio;
+
     if (result == LonApiNoError) {
-        struct termios tio;
+        const speed_t speed = EncodeBitrate(ctrl);
 
         // Configure serial communications
         tcgetattr(rpi->fd.sio, &tio);
 
-        tio.c_cflag = CS8 | CLOCAL | CREAD | EncodeBitrate(ctrl);
+        tio.c_cflag = CS8 | CLOCAL | CREAD | (speed ? speed : B38400);
         tio.c_iflag = IGNPAR;
         tio.c_oflag = 0;
         tio.c_lflag = 0;
@@ -1077,28 +2494,136 @@ LonApiError LdvOpen(const LdvCtrl* ctrl, LdvHandle* handle)
 
         tcsetattr(rpi->fd.sio, TCSAFLUSH, &tio);
 
-        rpi->uplink.queue = LdvqOpen();
-        rpi->downlink.queue = LdvqOpen();
+        if (speed == 0) {
+            /*
+             * There is no B* constant for this bit rate. Select it with
+             * termios2, and read back the resulting settings for later use.
+             */
+            if (SerialSetBitrate(rpi->fd.sio, ctrl->bitrate) == -1) {
+                RPI_TRACE(rpi->trace, "Cannot support %u bps (%s)\n", ctrl->bitrate, strerror(errno));
+                result = LonApiInitializationFailure;
+                LdvClose((LdvHandle) rpi);
+            } else {
+                tcgetattr(rpi->fd.sio, &tio);
+            }
+        }
+    }
+
+    if (result == LonApiNoError) {
+        rpi->timeout.segment = ByteTimeout(ctrl->bitrate, LON_SMIP_MAX_DATA, 0);
+        rpi->timeout.ctsDeassert = TIMEOUT_CTS_DEASSERT + rpi->timeout.segment;
+        rpi->timeout.uplinkData = ByteTimeout(ctrl->bitrate, UPLINK_DATA_BYTES, TIMEOUT_UPLINK_DATA);
+
+        if (ctrl->latency.lowLatency) {
+            int discipline = -1;
+
+            SetLowLatency(rpi);
+
+            if (ioctl(rpi->fd.sio, TIOCGETD, &discipline) == 0 && discipline == N_TTY) {
+                rpi->uplink.termios = tio;
+                rpi->uplink.vmin = tio.c_cc[VMIN];
+            } else {
+                RPI_TRACE(rpi->trace, "Can't tune VMIN without the N_TTY line discipline\n");
+            }
+        }
+
+        rpi->downlink.spin = ctrl->latency.spin;
+        rpi->downlink.recovery.stall = ctrl->recovery.stall;
+        rpi->adaptive.multiple = ctrl->adaptive.multiple;
+
+        if (rpi->adaptive.multiple) {
+            AdaptiveLimits(
+                rpi, "CTS assert",
+                &rpi->adaptive.floor.ctsAssert, &rpi->adaptive.ceiling.ctsAssert,
+                MICROSERVER_WATCHDOG, TIMEOUT_CTS_ASSERT, ctrl
+            );
+            AdaptiveLimits(
+                rpi, "CTS deassert",
+                &rpi->adaptive.floor.ctsDeassert, &rpi->adaptive.ceiling.ctsDeassert,
+                MICROSERVER_WATCHDOG + rpi->timeout.segment,
+                rpi->timeout.ctsDeassert, ctrl
+            );
+            AdaptiveLimits(
+                rpi, "uplink data",
+                &rpi->adaptive.floor.uplinkData, &rpi->adaptive.ceiling.uplinkData,
+                ByteTimeout(ctrl->bitrate, ADAPTIVE_UPLINK_BYTES, TIMEOUT_UPLINK_DATA),
+                rpi->timeout.uplinkData, ctrl
+            );
+        }
+
+        if (ctrl->recovery.stall) {
+            rpi->downlink.recovery.retries = ctrl->recovery.retries ? ctrl->recovery.retries : RECOVERY_RETRIES;
+        }
+
+        const unsigned uplink = ctrl->uplink.capacity ? ctrl->uplink.capacity : QUEUE_CAPACITY;
+        const unsigned downlink = ctrl->downlink.capacity ? ctrl->downlink.capacity : QUEUE_CAPACITY;
+
+        rpi->uplink.queue = LdvqOpenRing(uplink);
+        rpi->uplink.lane[UL_Control] = LdvqOpenLane(rpi->uplink.queue, uplink);
+        rpi->uplink.lane[UL_Normal] = rpi->uplink.queue;
+        rpi->downlink.queue = LdvqOpenRing(downlink);
+        rpi->downlink.lane[DL_Control] = LdvqOpenLane(rpi->downlink.queue, downlink);
+        rpi->downlink.lane[DL_Priority] = LdvqOpenLane(rpi->downlink.queue, downlink);
+        rpi->downlink.lane[DL_Normal] = rpi->downlink.queue;
+        rpi->downlink.watermark.high = ctrl->watermark.high ? ctrl->watermark.high : WATERMARK_HIGH(downlink);
+        rpi->downlink.watermark.low = ctrl->watermark.low ? ctrl->watermark.low : WATERMARK_LOW(downlink);
+
+        if (rpi->downlink.watermark.low >= rpi->downlink.watermark.high) {
+            rpi->downlink.watermark.low = rpi->downlink.watermark.high - 1;
+        }
+
+        if (!rpi->uplink.queue || !rpi->uplink.lane[UL_Control]) {
+            RPI_TRACE(rpi->trace, "Can't allocate the uplink queue (%u frames)\n", uplink);
+            result = LonApiInitializationFailure;
+            LdvClose((LdvHandle) rpi);
+        } else if (!rpi->downlink.queue || !rpi->downlink.lane[DL_Control]
+                   || !rpi->downlink.lane[DL_Priority]) {
+            RPI_TRACE(rpi->trace, "Can't allocate the downlink queue (%u frames)\n", downlink);
+            result = LonApiInitializationFailure;
+            LdvClose((LdvHandle) rpi);
+        }
+    }
+
+    if (result == LonApiNoError) {
+        LdvqNotify(rpi->uplink.lane[UL_Control], rpi->fd.ulw);
+        LdvqNotify(rpi->uplink.lane[UL_Normal], rpi->fd.ulw);
+
+        for (int lane = 0; lane < LDV_DOWNLINK_LANES; ++lane) {
+            LdvqNotify(rpi->downlink.lane[lane], rpi->fd.dlw);
+        }
 
 #if SUPPORT_SUSPEND
         pthread_mutex_init(&rpi->thread.mutex, NULL);
 #endif  //  SUPPORT_SUSPEND
 
-        if (pthread_create(&rpi->thread.sio, NULL, SioThread, rpi)) {
+        if (ctrl->thread.lock && mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+            RPI_TRACE(rpi->trace, "Can't lock memory (%s)\n", strerror(errno));
+        }
+
+        rpi->thread.lock = ctrl->thread.lock;
+
+        if (StartSioThread(rpi, ctrl)) {
             RPI_TRACE(rpi->trace, "Can't create the SIO thread");
+            rpi->thread.sio = (pthread_t) -1;
             result = LonApiInitializationFailure;
             LdvClose((LdvHandle) rpi);
         } else {
             SetHrdy(rpi, TRUE);
             *handle = (LdvHandle) rpi;
-            RPI_TRACE(
-                rpi->trace,
-                "Connected to %s,CTS~: GPIO%d, RTS~: GPIO%d, HRDY~: GPIO%d\n",
-                ctrl->device,
-                ctrl->gpio.cts,
-                ctrl->gpio.rts,
-                ctrl->gpio.hrdy
-            );
+            rpi->startup.open = (unsigned long) (Now() - rpi->startup.opened);
+
+            if (ctrl->gpio.backend == LdvGpioModem) {
+                RPI_TRACE(rpi->trace, "Connected to %s, modem line handshake\n", ctrl->device);
+            } else {
+                RPI_TRACE(
+                    rpi->trace,
+                    "Connected to %s,CTS~: GPIO%d, RTS~: GPIO%d, HRDY~: GPIO%d\n",
+                    ctrl->device,
+                    ctrl->gpio.cts,
+                    ctrl->gpio.rts,
+                    ctrl->gpio.hrdy
+                );
+            }
         }
     }
 
@@ -1129,10 +2654,17 @@ LonApiError LdvClose(LdvHandle handle)
 #endif  //  SUPPORT_SUSPEND
     }
 
-    if (rpi->fd.rts != -1) {
+    if (rpi->gpio.rts.fd != -1) {
         SetRts(rpi, FALSE);
     }
 
+    /*
+     * Close the pins first, these may be modem lines of the serial port.
+     */
+    GpioPinClose(&rpi->gpio.cts);
+    GpioPinClose(&rpi->gpio.rts);
+    GpioPinClose(&rpi->gpio.hrdy);
+
     /*
      * Now that the SIO thread is dead, let's close the open files:
      */
@@ -1158,19 +2690,36 @@ LonApiError LdvClose(LdvHandle handle)
 
 #endif  // SUPPORT_SUSPEND
 
-    if (rpi->fd.cts != -1) {
-        GpioClose(rpi->gpio.port.cts, rpi->fd.cts);
-        rpi->fd.cts = -1;
+    if (rpi->fd.ulw != -1) {
+        close(rpi->fd.ulw);
+        rpi->fd.ulw = -1;
+    }
+
+    if (rpi->fd.dlw != -1) {
+        close(rpi->fd.dlw);
+        rpi->fd.dlw = -1;
+    }
+
+    if (rpi->fd.epl != -1) {
+        close(rpi->fd.epl);
+        rpi->fd.epl = -1;
+    }
+
+    if (rpi->fd.tmr != -1) {
+        close(rpi->fd.tmr);
+        rpi->fd.tmr = -1;
     }
 
-    if (rpi->fd.rts != -1) {
-        GpioClose(rpi->gpio.port.rts, rpi->fd.rts);
-        rpi->fd.rts = -1;
+    if (rpi->uplink.queue) {
+        UplinkDiscard(rpi);
     }
 
-    if (rpi->fd.hrdy != -1) {
-        GpioClose(rpi->gpio.port.hrdy, rpi->fd.hrdy);
-        rpi->fd.hrdy = -1;
+    for (int lane = 0; lane < LDV_UPLINK_LANES; ++lane) {
+        if (rpi->uplink.lane[lane] != rpi->uplink.queue) {
+            LdvqClose(rpi->uplink.lane[lane]);
+        }
+
+        rpi->uplink.lane[lane] = 0;
     }
 
     if (rpi->uplink.queue) {
@@ -1178,36 +2727,65 @@ LonApiError LdvClose(LdvHandle handle)
         rpi->uplink.queue = 0;
     }
 
+    for (int lane = 0; lane < LDV_DOWNLINK_LANES; ++lane) {
+        if (rpi->downlink.lane[lane] != rpi->downlink.queue) {
+            LdvqClose(rpi->downlink.lane[lane]);
+        }
+
+        rpi->downlink.lane[lane] = 0;
+    }
+
     if (rpi->downlink.queue) {
         LdvqClose(rpi->downlink.queue);
         rpi->downlink.queue = 0;
     }
 
+    free(rpi->uplink.bytes.data);
+
+    if (rpi->log) {
+        LdvLogClose(rpi->log);
+    }
+
     free(rpi);
 
     return LonApiNoError;
 }
 
 /*
- * LdvAllocateMsg() allocates a transmit buffer.
+ * LdvAllocateMsg() allocates a transmit buffer. When all are in use, the
+ * downlink overflow policy determines whether the function waits, fails,
+ * or discards the oldest frame of ordinary network traffic still queued
+ * for transmission.
  */
 LonApiError LdvAllocateMsg(LdvHandle handle, LonSmipMsg** pFrame)
 {
     RpiHandle* rpi = (RpiHandle*) handle;
-    return LdvqAlloc(rpi->downlink.queue, pFrame);
+    LonApiError result = LonApiNoError;
+
+    if (rpi->downlink.overflow == LdvOverflowBlock) {
+        result = LdvqAllocWait(rpi->downlink.queue, pFrame, TIMEOUT_ALLOCATE);
+    } else {
+        result = LdvqAlloc(rpi->downlink.queue, pFrame);
+
+        if (result == LonApiTxBufIsFull && rpi->downlink.overflow == LdvOverflowDropOldest) {
+            LonSmipMsg* oldest = LdvqPop(rpi->downlink.lane[DL_Normal]);
+
+            if (oldest) {
+                rpi->downlink.dropped += 1;
+                LdvqFree(rpi->downlink.queue, oldest);
+                result = LdvqAlloc(rpi->downlink.queue, pFrame);
+            }
+        }
+    }
+
+    return result;
 }
 
 /*
  * LdvAllocateMsgWait() is a time-limited blocking version of
- * LdvAllocateMsg(). Since this implementation uses the heap and is designed
- * for Raspberry Pi (or similar) boards, we consider the pool of available
- * buffers to be infinite for the purpose of application initialization.
- *
- * This implementation of LdvAllocateMsgWait() is nothing but an alias to
- * LdvAllocateMsg(), therefore.
- *
- * Implementations which use a finite buffer pool may need to wait until a
- * timeout occurs or a buffer becomes available, whichever comes first.
+ * LdvAllocateMsg(). The downlink frame pool is finite, so the function
+ * waits until a buffer becomes available or TIMEOUT_ALLOCATE expires,
+ * whichever comes first. Concurrent callers are served in order.
  *
  * The Shortstack API calls this function only during initialization. The
  * Micro Server is in quiet mode during that phase; incoming network messages
@@ -1215,24 +2793,93 @@ LonApiError LdvAllocateMsg(LdvHandle handle, LonSmipMsg** pFrame)
  */
 LonApiError LdvAllocateMsgWait(LdvHandle handle, LonSmipMsg** pFrame)
 {
-    return LdvAllocateMsg(handle, pFrame);
+    RpiHandle* rpi = (RpiHandle*) handle;
+    return LdvqAllocWait(rpi->downlink.queue, pFrame, TIMEOUT_ALLOCATE);
 }
 
 /*
- * LdvPutMsg() submits a message for downlink transfer.
+ * LdvAllocateMsgs() allocates several transmit buffers with the downlink
+ * overflow policy of LdvAllocateMsg(). The operation succeeds or fails as
+ * a whole: when one buffer cannot be allocated, those already allocated
+ * are released again.
  */
-LonApiError LdvPutMsg(LdvHandle handle, LonSmipMsg* pFrame)
+LonApiError LdvAllocateMsgs(LdvHandle handle, LonSmipMsg* pFrames[], unsigned count)
 {
     RpiHandle* rpi = (RpiHandle*) handle;
     LonApiError result = LonApiNoError;
+    unsigned allocated = 0;
 
-    result = LdvqPush(rpi->downlink.queue, pFrame);
+    while (result == LonApiNoError && allocated < count) {
+        result = LdvAllocateMsg(handle, &pFrames[allocated]);
 
-    if (result == LonApiNoError) {
-        PipeEvent event = PEV_Wakeup;
+        if (result == LonApiNoError) {
+            ++allocated;
+        }
+    }
 
-        if (write(rpi->fd.epi, &event, sizeof(event)) != sizeof(event)) {
-            result = LonApiDriverCtrl;
+    if (result != LonApiNoError) {
+        LdvqFreeMany(rpi->downlink.queue, pFrames, allocated);
+
+        for (unsigned i = 0; i < count; ++i) {
+            pFrames[i] = NULL;
+        }
+    }
+
+    return result;
+}
+
+/*
+ * DownlinkClassify() selects the downlink lane for a frame, based on the
+ * frame's network interface command.
+ */
+static DownlinkLane DownlinkClassify(const LonSmipMsg* pFrame)
+{
+    DownlinkLane result = DL_Control;
+    const unsigned command = pFrame->Header.Command;
+
+    if (command >= LonNiNv) {
+        /* A network variable update or poll. */
+        result = DL_Normal;
+    } else if ((command & 0xF0) == LonNiComm
+           || (command & 0xF0) == LonNiNetManagement) {
+        /* A message; the lower nibble selects the transmit queue. */
+        const unsigned queue = command & 0x0F;
+
+        result = (queue == LonNiTxQueuePriority || queue == LonNiNonTxQueuePriority)
+                 ? DL_Priority : DL_Normal;
+    }
+
+    return result;
+}
+
+/*
+ * LdvPutMsg() submits a message for downlink transfer. The lane signals
+ * the downlink event, and so wakes up the SIO thread, only when it becomes
+ * non-empty; a frame submitted while the SIO thread is busy costs no
+ * system call.
+ */
+LonApiError LdvPutMsg(LdvHandle handle, LonSmipMsg* pFrame)
+{
+    RpiHandle* rpi = (RpiHandle*) handle;
+
+    return LdvqPush(rpi->downlink.lane[DownlinkClassify(pFrame)], pFrame);
+}
+
+/*
+ * LdvPutMsgs() submits several messages for downlink transfer, in array
+ * order. Submission stops with the first frame which fails. Each submitted
+ * entry is set to NULL, so that the remaining entries identify the frames
+ * which still belong to the caller.
+ */
+LonApiError LdvPutMsgs(LdvHandle handle, LonSmipMsg* pFrames[], unsigned count)
+{
+    LonApiError result = LonApiNoError;
+
+    for (unsigned i = 0; i < count && result == LonApiNoError; ++i) {
+        result = LdvPutMsg(handle, pFrames[i]);
+
+        if (result == LonApiNoError) {
+            pFrames[i] = NULL;
         }
     }
 
@@ -1240,19 +2887,48 @@ LonApiError LdvPutMsg(LdvHandle handle, LonSmipMsg* pFrame)
 }
 
 /*
- * LdvGetMsg() retrieves an incoming message (if any).
+ * LdvGetMsg() retrieves an incoming message (if any), taking frames from
+ * the control lane first.
  */
 LonApiError LdvGetMsg(LdvHandle handle, LonSmipMsg** pFrame)
 {
     RpiHandle* rpi = (RpiHandle*) handle;
     LonApiError result = LonApiNoError;
 
-    *pFrame = LdvqPop(rpi->uplink.queue);
+    *pFrame = LdvqPop(rpi->uplink.lane[UL_Control]);
 
     if (*pFrame == NULL) {
+        *pFrame = LdvqPop(rpi->uplink.lane[UL_Normal]);
+    }
+
+    if (*pFrame == NULL) {
+        result = LonApiRxMsgNotAvailable;
+    }
+
+    ClearUplinkEvent(rpi);
+
+    return result;
+}
+
+/*
+ * LdvGetMsgs() retrieves up to 'count' incoming messages at once. Frames
+ * from the control lane precede all others.
+ */
+LonApiError LdvGetMsgs(LdvHandle handle, LonSmipMsg* pFrames[],
+                       unsigned count, unsigned* pCount)
+{
+    RpiHandle* rpi = (RpiHandle*) handle;
+    LonApiError result = LonApiNoError;
+
+    *pCount = LdvqPopMany(rpi->uplink.lane[UL_Control], pFrames, count);
+    *pCount += LdvqPopMany(rpi->uplink.lane[UL_Normal], pFrames + *pCount, count - *pCount);
+
+    if (*pCount == 0) {
         result = LonApiRxMsgNotAvailable;
     }
 
+    ClearUplinkEvent(rpi);
+
     return result;
 }
 
@@ -1266,6 +2942,15 @@ LonApiError LdvReleaseMsg(LdvHandle handle, LonSmipMsg* pFrame)
     return LdvqFree(rpi->uplink.queue, pFrame);
 }
 
+/*
+ * LdvReleaseMsgs() releases several message buffers at once.
+ */
+LonApiError LdvReleaseMsgs(LdvHandle handle, LonSmipMsg* pFrames[], unsigned count)
+{
+    RpiHandle* rpi = (RpiHandle*) handle;
+    return LdvqFreeMany(rpi->uplink.queue, pFrames, count);
+}
+
 /*
  * LdvReset resets the driver. Note that the function returns
  * as soon as the driver reset request has been submitted and not
@@ -1367,3 +3052,136 @@ LonApiError LdvResume(LdvHandle handle)
 #endif  //  SUPPORT_SUSPEND
 }
 
+/*
+ * LdvGetStatistics() reports the frame pool counters and the number of
+ * timeouts for each direction, and the depth of each lane.
+ */
+LonApiError LdvGetStatistics(LdvHandle handle, LdvStatistics* stats)
+{
+    RpiHandle* rpi = (RpiHandle*) handle;
+
+    memset(stats, 0, sizeof(LdvStatistics));
+    LdvqGetStatistics(rpi->uplink.queue, &stats->uplink.queue);
+    LdvqGetStatistics(rpi->downlink.queue, &stats->downlink.queue);
+
+    for (int lane = 0; lane < LDV_UPLINK_LANES; ++lane) {
+        LdvqGetLaneStatistics(rpi->uplink.lane[lane], &stats->uplink.lanes[lane]);
+    }
+
+    for (int lane = 0; lane < LDV_DOWNLINK_LANES; ++lane) {
+        LdvqGetLaneStatistics(rpi->downlink.lane[lane], &stats->downlink.lanes[lane]);
+    }
+    stats->uplink.timeouts = rpi->uplink.timeouts;
+    stats->downlink.timeouts = rpi->downlink.timeouts;
+    stats->uplink.dropped = rpi->uplink.dropped;
+    stats->uplink.resyncs = rpi->uplink.resyncs;
+    stats->uplink.skipped = rpi->uplink.skipped;
+    stats->uplink.vminChanges = rpi->uplink.vminChanges;
+    memcpy(stats->uplink.segments, rpi->uplink.segments, sizeof(stats->uplink.segments));
+    stats->downlink.dropped = rpi->downlink.dropped;
+    memcpy(stats->downlink.latency, rpi->downlink.latency, sizeof(stats->downlink.latency));
+    stats->downlink.spins = rpi->downlink.spins;
+    memcpy(stats->downlink.profile, rpi->downlink.profile, sizeof(stats->downlink.profile));
+    stats->downlink.recovery.stalls = rpi->downlink.recovery.stalls;
+    stats->downlink.recovery.edges = rpi->downlink.recovery.edges;
+    stats->downlink.recovery.resyncs = rpi->downlink.recovery.resyncs;
+    stats->downlink.recovery.retransmits = rpi->downlink.recovery.retransmits;
+    stats->downlink.recovery.recovered = rpi->downlink.recovery.recovered;
+    stats->downlink.recovery.time = rpi->downlink.recovery.time;
+    stats->downlink.recovery.longest = rpi->downlink.recovery.longest;
+    stats->downlink.congestions = rpi->downlink.congestions;
+    stats->downlink.congested = rpi->downlink.congested;
+    stats->timeouts.ctsDeassert = CtsDeassertTimeout(rpi);
+    stats->timeouts.ctsAssert = CtsAssertTimeout(rpi);
+    stats->timeouts.uplinkData = UplinkDataTimeout(rpi);
+    stats->startup.open = rpi->startup.open;
+    stats->startup.ready = rpi->startup.ready;
+
+    return LonApiNoError;
+}
+
+/*
+ * LdvWaitForEvent() waits until an uplink lane holds a frame, or until
+ * the timeout expires. The timeout is given in milliseconds; zero waits
+ * indefinitely.
+ */
+LonApiError LdvWaitForEvent(LdvHandle handle, unsigned timeout)
+{
+    RpiHandle* rpi = (RpiHandle*) handle;
+    LonApiError result = LonApiNoError;
+
+    if (UplinkEmpty(rpi)) {
+        struct pollfd event = { rpi->fd.ulw, POLLIN, 0 };
+        int polled = poll(&event, 1, timeout ? (int) timeout : -1);
+
+        if (polled == 0) {
+            result = LonApiTimeout;
+        } else if (polled == -1 && errno != EINTR) {
+            result = LonApiDriverCtrl;
+        }
+    }
+
+    return result;
+}
+
+/*
+ * LdvGetEventFd() reports the uplink event file descriptor. The descriptor
+ * is readable while any uplink lane holds frames.
+ */
+LonApiError LdvGetEventFd(LdvHandle handle, int* fd)
+{
+    RpiHandle* rpi = (RpiHandle*) handle;
+
+    *fd = rpi->fd.ulw;
+    return LonApiNoError;
+}
+
+/*
+ * LdvGetTimestamp() reports the monotonic clock in microseconds.
+ */
+LonApiError LdvGetTimestamp(LdvHandle handle, unsigned long* pMicroseconds)
+{
+    (void) handle;
+    *pMicroseconds = (unsigned long) Now();
+    return LonApiNoError;
+}
+
+/*
+ * LdvDumpLog() writes the binary frame log to a file. Use the ldvdecode
+ * tool, or LdvLogFormat(), to render the file as text.
+ */
+LonApiError LdvDumpLog(LdvHandle handle, int fd)
+{
+    RpiHandle* rpi = (RpiHandle*) handle;
+    LonApiError result = LonApiNotSupported;
+
+    if (rpi->log) {
+        result = LdvLogDump(rpi->log, fd) == 0 ? LonApiNoError : LonApiDriverCtrl;
+    }
+
+    return result;
+}
+
+/*
+ * LdvGetCongestion() reports whether the downlink frame pool is congested.
+ * Congestion begins when the high watermark is reached, and ends when no
+ * more than the low watermark's number of frames remain allocated.
+ */
+LonApiError LdvGetCongestion(LdvHandle handle, LonBool* pCongested)
+{
+    RpiHandle* rpi = (RpiHandle*) handle;
+    const unsigned allocated = DownlinkAllocated(rpi);
+    int congested = rpi->downlink.congested;
+
+    if (!congested && allocated >= rpi->downlink.watermark.high) {
+        congested = TRUE;
+        rpi->downlink.congestions += 1;
+    } else if (congested && allocated <= rpi->downlink.watermark.low) {
+        congested = FALSE;
+    }
+
+    __atomic_store_n(&rpi->downlink.congested, congested, __ATOMIC_RELAXED);
+    *pCongested = congested ? TRUE : FALSE;
+
+    return LonApiNoError;
+}
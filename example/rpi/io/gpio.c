@@ -10,7 +10,10 @@
  * of the Echelon Example Software License Agreement which is available at
  * www.echelon.com/license/examplesoftware/.
  */
+#include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
 #include <pthread.h>
 #include <stdarg.h>
 #include <stddef.h>
@@ -21,11 +24,37 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <linux/gpio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
 #include <sys/ioctl.h>
 #include <sys/time.h>
 #include <sys/select.h>
 #include <sys/stat.h>
 
+#include "io.h"
+
+/*
+ * OPEN_TIMEOUT is the time Openf() waits for write access to a sysfs file,
+ * in milliseconds. OPEN_RETRY is the interval at which it looks for a file
+ * which does not yet exist.
+ */
+#define OPEN_TIMEOUT    500
+#define OPEN_RETRY      1
+
+/*
+ * Elapsed() returns the milliseconds elapsed since 'start'.
+ */
+static int Elapsed(const struct timespec* start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int) ((now.tv_sec - start->tv_sec) * 1000
+                  + (now.tv_nsec - start->tv_nsec) / 1000000);
+}
+
 /*
  * Openf() implements open for sprintf-style filenames, useful when dealing
  * with sysfs files.
@@ -49,37 +78,48 @@ static int Openf(mode_t mode, const char* fmt, ...)
      * because this yields the appropriate system error code for us when it
      * fails.
      *
-     * Note that this code assumes that we'll be granted write access through
-     * group permissions.
+     * udev grants access with chown() and chmod(), which raise an inotify
+     * IN_ATTRIB event for the file. Once the file exists, we wait for this
+     * event rather than sleep. sysfs does not report the creation of the
+     * file, however, so until then we look for the file at short intervals.
      */
-    if (mode & O_WRONLY) {
-        int timeout = 100;
-        struct stat status = {0};
-
-        do {
-			/*
-			 * We always begin with a small delay. It seems this is almost
-			 * always required before we can even stat the file, because
-			 * execute permission to the directory is required to stat()
-			 * the file, and the file must exist.
-			 */
-			struct timespec wait = {0, 5000000};    // 5ms
-			nanosleep(&wait, NULL);
-			--timeout;
-
-			if (stat(filename, &status)) {
-				/* stat() failed. This implementation assumes that the
-				 * failure is transient, either because the GPIO sysfs
-				 * value or direction file does not yet exist, or
-				 * because the folder containing that file does not yet
-				 * exist or is not yet searchable (executable), which
-				 * is required by stat(). Therefore, this implementation
-				 * ignores the error and tries again, replying on eventual
-				 * success or failure by timeout.
-				 */
-				memset(&status, 0, sizeof(status));
-			}
-        } while (timeout && !(status.st_mode & S_IWGRP));
+    if (mode & O_WRONLY && access(filename, W_OK)) {
+        struct timespec start;
+        int notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        int watch = -1;
+        int remaining;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        while ((remaining = OPEN_TIMEOUT - Elapsed(&start)) > 0) {
+            struct pollfd event = { notify, POLLIN, 0 };
+            char buffer[sizeof(struct inotify_event) + NAME_MAX + 1];
+
+            if (watch == -1 && notify != -1) {
+                watch = inotify_add_watch(notify, filename, IN_ATTRIB);
+            }
+
+            /*
+             * Test again after adding the watch, in case access was granted
+             * meanwhile.
+             */
+            if (access(filename, W_OK) == 0) {
+                break;
+            }
+
+            if (watch == -1) {
+                struct timespec wait = {0, OPEN_RETRY * 1000000};
+                nanosleep(&wait, NULL);
+            } else if (poll(&event, 1, remaining) > 0) {
+                while (read(notify, buffer, sizeof(buffer)) > 0) {
+                    /* Drain the events. */
+                }
+            }
+        }
+
+        if (notify != -1) {
+            close(notify);
+        }
     }
 
     return open(filename, mode);
@@ -153,3 +193,519 @@ int GpioClose(int port, int handle)
 }
 
 
+
+/*
+ * GpioOps is the interface implemented by each GPIO backend. GpioPin*()
+ * dispatch to the backend selected when the pin was opened.
+ */
+struct GpioOps {
+    int (*open)(GpioPin* pin, const char* chip, GpioDirection direction);
+    int (*read)(GpioPin* pin);
+    int (*write)(GpioPin* pin, int level);
+    int (*event)(GpioPin* pin);
+    void (*close)(GpioPin* pin);
+};
+
+/*
+ * The sysfs backend uses GpioOpen() and GpioClose(), above. The value file
+ * signals an edge with POLLPRI, and must be read from the beginning.
+ */
+static int SysfsOpen(GpioPin* pin, const char* chip, GpioDirection direction)
+{
+    static const char* const dir[] = { "in", "in", "low", "high" };
+
+    (void) chip;
+
+    pin->fd = GpioOpen(
+        pin->port,
+        direction >= GpioOutputLow ? O_WRONLY : O_RDONLY,
+        dir[direction],
+        direction == GpioInputEdges ? "both" : NULL
+    );
+    pin->events = EPOLLPRI;
+
+    return pin->fd == -1 ? -1 : 0;
+}
+
+static int SysfsRead(GpioPin* pin)
+{
+    char buffer;
+
+    if (lseek(pin->fd, 0, SEEK_SET) == -1
+        || read(pin->fd, &buffer, sizeof(buffer)) != sizeof(buffer)) {
+        return -1;
+    }
+
+    return buffer != '0';
+}
+
+static int SysfsWrite(GpioPin* pin, int level)
+{
+    char buffer = level ? '1' : '0';
+
+    return write(pin->fd, &buffer, 1) == 1 ? 0 : -1;
+}
+
+static void SysfsClose(GpioPin* pin)
+{
+    GpioClose(pin->port, pin->fd);
+}
+
+static const struct GpioOps sysfsOps = {
+    SysfsOpen, SysfsRead, SysfsWrite, SysfsRead, SysfsClose
+};
+
+/*
+ * The character device backend requests one line from the GPIO chip. The
+ * line request descriptor carries all further operations, and delivers
+ * edge events with kernel timestamps.
+ */
+#if defined(GPIO_V2_GET_LINE_IOCTL)
+
+static int ChardevOpen(GpioPin* pin, const char* chip, GpioDirection direction)
+{
+    struct gpio_v2_line_request request;
+    int fd = open(chip ? chip : "/dev/gpiochip0", O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1) {
+        return -1;
+    }
+
+    memset(&request, 0, sizeof(request));
+    request.offsets[0] = pin->port;
+    request.num_lines = 1;
+    strncpy(request.consumer, "shortstack", sizeof(request.consumer) - 1);
+
+    if (direction >= GpioOutputLow) {
+        request.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+        request.config.num_attrs = 1;
+        request.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+        request.config.attrs[0].attr.values = direction == GpioOutputHigh;
+        request.config.attrs[0].mask = 1;
+    } else {
+        request.config.flags = GPIO_V2_LINE_FLAG_INPUT;
+
+        if (direction == GpioInputEdges) {
+            request.config.flags |= GPIO_V2_LINE_FLAG_EDGE_RISING
+                                    | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+        }
+    }
+
+    if (ioctl(fd, GPIO_V2_GET_LINE_IOCTL, &request) == -1) {
+        int error = errno;
+
+        close(fd);
+        errno = error;
+        return -1;
+    }
+
+    close(fd);
+
+    /*
+     * GpioPinEvent() drains all pending events, and must not block when
+     * there are none.
+     */
+    fcntl(request.fd, F_SETFL, fcntl(request.fd, F_GETFL) | O_NONBLOCK);
+
+    pin->fd = request.fd;
+    pin->events = EPOLLIN;
+
+    return 0;
+}
+
+static int ChardevRead(GpioPin* pin)
+{
+    struct gpio_v2_line_values values = { 0, 1 };
+
+    if (ioctl(pin->fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) == -1) {
+        return -1;
+    }
+
+    return (int) (values.bits & 1);
+}
+
+static int ChardevWrite(GpioPin* pin, int level)
+{
+    struct gpio_v2_line_values values = { level ? 1 : 0, 1 };
+
+    return ioctl(pin->fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values);
+}
+
+static int ChardevEvent(GpioPin* pin)
+{
+    struct gpio_v2_line_event events[16];
+    int level = -1;
+    ssize_t bytes;
+
+    do {
+        bytes = read(pin->fd, events, sizeof(events));
+
+        for (unsigned i = 0; bytes > 0 && i < bytes / sizeof(events[0]); ++i) {
+            level = events[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE;
+            pin->timestamp = events[i].timestamp_ns;
+        }
+    } while (bytes == sizeof(events));
+
+    /*
+     * Without a pending event, read the level instead.
+     */
+    return level == -1 ? ChardevRead(pin) : level;
+}
+
+static void ChardevClose(GpioPin* pin)
+{
+    close(pin->fd);
+}
+
+#else   //  GPIO_V2_GET_LINE_IOCTL
+
+static int ChardevOpen(GpioPin* pin, const char* chip, GpioDirection direction)
+{
+    (void) pin;
+    (void) chip;
+    (void) direction;
+
+    errno = ENOSYS;
+    return -1;
+}
+
+#define ChardevRead     NULL
+#define ChardevWrite    NULL
+#define ChardevEvent    NULL
+#define ChardevClose    NULL
+
+#endif  //  GPIO_V2_GET_LINE_IOCTL
+
+static const struct GpioOps chardevOps = {
+    ChardevOpen, ChardevRead, ChardevWrite, ChardevEvent, ChardevClose
+};
+
+/*
+ * The mock backend keeps the level of each pin in memory. An eventfd takes
+ * the place of the pin's value file, and signals edges caused with
+ * GpioMockSet(). Mock pins are initially high, as with a pull-up resistor.
+ */
+#define GPIO_MOCK_PORTS 64
+
+static struct {
+    int level;
+    int fd;         /* eventfd of the open pin with edge events, or -1 */
+    uint64_t timestamp;
+} mockPins[GPIO_MOCK_PORTS] = {
+    [0 ... GPIO_MOCK_PORTS - 1] = { 1, -1, 0 }
+};
+
+static uint64_t MockTime(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+static int MockOpen(GpioPin* pin, const char* chip, GpioDirection direction)
+{
+    (void) chip;
+
+    if (pin->port < 0 || pin->port >= GPIO_MOCK_PORTS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pin->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    pin->events = EPOLLIN;
+
+    if (pin->fd == -1) {
+        return -1;
+    }
+
+    if (direction >= GpioOutputLow) {
+        __atomic_store_n(&mockPins[pin->port].level, direction == GpioOutputHigh, __ATOMIC_SEQ_CST);
+    }
+
+    __atomic_store_n(&mockPins[pin->port].fd, direction == GpioInputEdges ? pin->fd : -1, __ATOMIC_SEQ_CST);
+
+    return 0;
+}
+
+static int MockRead(GpioPin* pin)
+{
+    return __atomic_load_n(&mockPins[pin->port].level, __ATOMIC_SEQ_CST);
+}
+
+static int MockWrite(GpioPin* pin, int level)
+{
+    __atomic_store_n(&mockPins[pin->port].level, level ? 1 : 0, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+static int MockEvent(GpioPin* pin)
+{
+    uint64_t count;
+
+    if (read(pin->fd, &count, sizeof(count)) == sizeof(count)) {
+        pin->timestamp = __atomic_load_n(&mockPins[pin->port].timestamp, __ATOMIC_SEQ_CST);
+    }
+
+    return MockRead(pin);
+}
+
+static void MockClose(GpioPin* pin)
+{
+    int fd = pin->fd;
+
+    __atomic_compare_exchange_n(
+        &mockPins[pin->port].fd, &fd, -1, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST
+    );
+    close(pin->fd);
+}
+
+static const struct GpioOps mockOps = {
+    MockOpen, MockRead, MockWrite, MockEvent, MockClose
+};
+
+void GpioMockSet(int port, int level)
+{
+    if (port >= 0 && port < GPIO_MOCK_PORTS) {
+        level = level ? 1 : 0;
+        __atomic_store_n(&mockPins[port].timestamp, MockTime(), __ATOMIC_SEQ_CST);
+
+        if (__atomic_exchange_n(&mockPins[port].level, level, __ATOMIC_SEQ_CST) != level) {
+            const uint64_t one = 1;
+            int fd = __atomic_load_n(&mockPins[port].fd, __ATOMIC_SEQ_CST);
+
+            if (fd != -1) {
+                write(fd, &one, sizeof(one));
+            }
+        }
+    }
+}
+
+int GpioMockGet(int port)
+{
+    if (port >= 0 && port < GPIO_MOCK_PORTS) {
+        return __atomic_load_n(&mockPins[port].level, __ATOMIC_SEQ_CST);
+    }
+
+    return -1;
+}
+
+/*
+ * The modem backend drives the modem control lines of a serial port. The
+ * line is asserted when the pin is low, as with a TTL UART. An output pin
+ * uses the serial port's descriptor. An input pin with edge events uses an
+ * eventfd instead, which a thread signals when TIOCMIWAIT reports a change
+ * of the line. Some serial drivers do not support TIOCMIWAIT; the thread
+ * polls the line in this case.
+ */
+#define MODEM_POLL_INTERVAL 200000  // 200us, in ns
+
+typedef struct {
+    int tty;
+    int fd;             /* eventfd, or -1 without edge events */
+    pthread_t thread;
+    uint64_t timestamp;
+} ModemContext;
+
+static void* ModemWait(void* arg)
+{
+    GpioPin* pin = (GpioPin*) arg;
+    ModemContext* context = (ModemContext*) pin->context;
+    const uint64_t one = 1;
+    int wait = 1;
+    int last = 0;
+
+    ioctl(context->tty, TIOCMGET, &last);
+
+    for (;;) {
+        int status = 0;
+
+        if (wait) {
+            /*
+             * TIOCMIWAIT is no cancellation point, but only returns when the
+             * line changes. Allow the thread to be cancelled while it waits.
+             */
+            int result;
+
+            pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+            result = ioctl(context->tty, TIOCMIWAIT, pin->port);
+            pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
+
+            if (result == -1 && errno != EINTR) {
+                wait = 0;
+            }
+        } else {
+            struct timespec interval = {0, MODEM_POLL_INTERVAL};
+            nanosleep(&interval, NULL);
+        }
+
+        if (ioctl(context->tty, TIOCMGET, &status) == 0
+            && (status ^ last) & pin->port) {
+            struct timespec now;
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            __atomic_store_n(
+                &context->timestamp,
+                (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec,
+                __ATOMIC_SEQ_CST
+            );
+            write(context->fd, &one, sizeof(one));
+            last = status;
+        }
+    }
+
+    return NULL;
+}
+
+static int ModemRead(GpioPin* pin)
+{
+    int status;
+
+    if (ioctl(((ModemContext*) pin->context)->tty, TIOCMGET, &status) == -1) {
+        return -1;
+    }
+
+    return !(status & pin->port);
+}
+
+static int ModemWrite(GpioPin* pin, int level)
+{
+    return ioctl(
+        ((ModemContext*) pin->context)->tty,
+        level ? TIOCMBIC : TIOCMBIS,
+        &pin->port
+    );
+}
+
+static int ModemEvent(GpioPin* pin)
+{
+    ModemContext* context = (ModemContext*) pin->context;
+    uint64_t count;
+
+    if (read(context->fd, &count, sizeof(count)) == sizeof(count)) {
+        pin->timestamp = __atomic_load_n(&context->timestamp, __ATOMIC_SEQ_CST);
+    }
+
+    return ModemRead(pin);
+}
+
+static void ModemClose(GpioPin* pin)
+{
+    ModemContext* context = (ModemContext*) pin->context;
+
+    if (context->fd != -1) {
+        pthread_cancel(context->thread);
+        pthread_join(context->thread, NULL);
+        close(context->fd);
+    }
+
+    free(context);
+    pin->context = NULL;
+}
+
+static const struct GpioOps modemOps = {
+    NULL, ModemRead, ModemWrite, ModemEvent, ModemClose
+};
+
+int GpioPinOpenModem(
+    GpioPin* pin, int tty, int line, GpioDirection direction
+)
+{
+    ModemContext* context = (ModemContext*) malloc(sizeof(ModemContext));
+
+    pin->ops = &modemOps;
+    pin->port = line;
+    pin->fd = -1;
+    pin->events = 0;
+    pin->timestamp = 0;
+    pin->context = context;
+
+    if (context == NULL) {
+        return -1;
+    }
+
+    context->tty = tty;
+    context->fd = -1;
+    context->timestamp = 0;
+
+    if (direction >= GpioOutputLow
+        && ModemWrite(pin, direction == GpioOutputHigh) == -1) {
+        free(context);
+        pin->context = NULL;
+        return -1;
+    }
+
+    if (direction == GpioInputEdges) {
+        context->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (context->fd == -1
+            || pthread_create(&context->thread, NULL, ModemWait, pin)) {
+            if (context->fd != -1) {
+                close(context->fd);
+            }
+
+            free(context);
+            pin->context = NULL;
+            return -1;
+        }
+
+        pin->fd = context->fd;
+        pin->events = EPOLLIN;
+    } else {
+        pin->fd = tty;
+    }
+
+    return 0;
+}
+
+int GpioPinOpen(
+    GpioPin* pin, GpioBackend backend, const char* chip, int port,
+    GpioDirection direction
+)
+{
+    pin->ops = backend == GpioChardev ? &chardevOps
+               : backend == GpioMock ? &mockOps : &sysfsOps;
+    pin->port = port;
+    pin->fd = -1;
+    pin->events = 0;
+    pin->timestamp = 0;
+    pin->context = NULL;
+
+    if (backend == GpioModem) {
+        /*
+         * Modem lines require the serial port, see GpioPinOpenModem().
+         */
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (pin->ops->open(pin, chip, direction) == -1) {
+        pin->fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+int GpioPinRead(GpioPin* pin)
+{
+    return pin->fd == -1 ? -1 : pin->ops->read(pin);
+}
+
+int GpioPinWrite(GpioPin* pin, int level)
+{
+    return pin->fd == -1 ? -1 : pin->ops->write(pin, level);
+}
+
+int GpioPinEvent(GpioPin* pin)
+{
+    return pin->fd == -1 ? -1 : pin->ops->event(pin);
+}
+
+void GpioPinClose(GpioPin* pin)
+{
+    if (pin->fd != -1) {
+        pin->ops->close(pin);
+        pin->fd = -1;
+    }
+}
@@ -12,11 +12,137 @@
 #ifndef RPI_EXAMPLE_IO_DEFINED
 #	define RPI_EXAMPLE_IO_DEFINED
 
+#include <stdint.h>
+#include <sys/types.h>
+
 extern int GpioOpen(
     int port, mode_t mode, const char* dir, const char* trigger
 );
 
 extern int GpioClose(int port, int handle);
 
+/*
+ * Enumeration: GpioBackend
+ *
+ * GpioBackend selects the implementation used for a <GpioPin>:
+ *
+ * GpioSysfs - the legacy sysfs interface in /sys/class/gpio. Each pin is
+ * exported, and each access reads or writes an ASCII digit.
+ *
+ * GpioChardev - a line request with the GPIO character device
+ * (/dev/gpiochipN, uAPI v2, Linux 5.10 and later). Each access is a single
+ * ioctl, edge events carry kernel timestamps, and no export is required.
+ *
+ * GpioMock - an in-memory pin without hardware, for tests. See
+ * <GpioMockSet> and <GpioMockGet>.
+ *
+ * GpioModem - a modem control line of a serial port, such as RTS or CTS,
+ * driven with TIOCMGET and TIOCMSET. Open these pins with
+ * <GpioPinOpenModem>.
+ */
+typedef enum {
+    GpioSysfs = 0,
+    GpioChardev = 1,
+    GpioMock = 2,
+    GpioModem = 3
+} GpioBackend;
+
+/*
+ * Enumeration: GpioDirection
+ *
+ * GpioDirection selects the direction of a <GpioPin>, the initial level
+ * of an output, and whether an input reports edge events.
+ */
+typedef enum {
+    GpioInput = 0,      /* input without edge events */
+    GpioInputEdges = 1, /* input, reports rising and falling edges */
+    GpioOutputLow = 2,  /* output, initially low */
+    GpioOutputHigh = 3  /* output, initially high */
+} GpioDirection;
+
+/*
+ * Typedef: GpioPin
+ *
+ * GpioPin holds one open GPIO pin. 'fd' is the descriptor to watch for
+ * edge events, with the epoll 'events' given; it is -1 when the pin is not
+ * open. 'timestamp' is the time of the most recent edge reported by
+ * <GpioPinEvent> in nanoseconds of CLOCK_MONOTONIC, or zero if the backend
+ * provides no timestamps. The remaining fields are private to the backend.
+ */
+typedef struct {
+    const struct GpioOps* ops;
+    int port;
+    int fd;
+    uint32_t events;
+    uint64_t timestamp;
+    void* context;
+} GpioPin;
+
+/*
+ * GpioPinOpen opens one GPIO pin with the given backend. 'chip' names the
+ * GPIO character device for GpioChardev, and is ignored otherwise. 'port'
+ * is the pin number (the line offset with GpioChardev).
+ * Returns 0 on success, or -1 with errno set.
+ */
+extern int GpioPinOpen(
+    GpioPin* pin, GpioBackend backend, const char* chip, int port,
+    GpioDirection direction
+);
+
+/*
+ * GpioPinOpenModem opens the modem control line 'line' (TIOCM_RTS,
+ * TIOCM_CTS, TIOCM_DTR, etc.) of the open serial port 'tty' as a pin. The
+ * pin's level is the level of a TTL UART signal: low when the line is
+ * asserted. An input with edge events starts a thread which waits for
+ * changes with TIOCMIWAIT, or polls the line if the serial driver does not
+ * support TIOCMIWAIT. Close the pin before closing 'tty'.
+ * Returns 0 on success, or -1 with errno set.
+ */
+extern int GpioPinOpenModem(
+    GpioPin* pin, int tty, int line, GpioDirection direction
+);
+
+/*
+ * GpioPinRead returns the physical level of a pin (0 or 1), or -1 on error.
+ */
+extern int GpioPinRead(GpioPin* pin);
+
+/*
+ * GpioPinWrite sets the physical level of an output pin.
+ * Returns 0 on success, or -1 on error.
+ */
+extern int GpioPinWrite(GpioPin* pin, int level);
+
+/*
+ * GpioPinEvent consumes the edge events pending on the pin's descriptor,
+ * updates 'timestamp' and returns the physical level after the most recent
+ * edge, or -1 on error.
+ */
+extern int GpioPinEvent(GpioPin* pin);
+
+/*
+ * GpioPinClose closes a pin and releases it. The call has no effect with a
+ * pin which is not open.
+ */
+extern void GpioPinClose(GpioPin* pin);
+
+/*
+ * GpioMockSet sets the level of a mock pin, as an external driver would.
+ * An edge event is signalled if the level changes and the pin is open as
+ * GpioInputEdges. GpioMockGet returns the level of a mock pin, as an
+ * external receiver would see it. Mock pins are numbered 0..63.
+ */
+extern void GpioMockSet(int port, int level);
+extern int GpioMockGet(int port);
+
+/*
+ * SerialSetBitrate sets the bit rate of an open serial port to any value
+ * the serial driver supports, including rates without a B* constant, with
+ * the termios2 interface. Other settings remain unchanged. Returns 0 on
+ * success, or -1 with errno set. EINVAL reports a rate which the serial
+ * driver can only approximate within more than 2%; the port then keeps its
+ * previous bit rate.
+ */
+extern int SerialSetBitrate(int fd, unsigned bitrate);
 
 #endif /* RPI_EXAMPLE_IO_DEFINED */
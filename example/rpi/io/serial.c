@@ -0,0 +1,74 @@
+/*
+ * IzoT ShortStack for Raspberry Pi Example code.
+ *
+ * serial.c provides serial port configuration which the standard termios
+ * interface does not support: arbitrary bit rates through the Linux termios2
+ * interface. This is kept apart from other modules, because the kernel's
+ * termios2 definitions conflict with the C library's <termios.h>.
+ *
+ * License:
+ * Use of the source code contained in this file is subject to the terms
+ * of the Echelon Example Software License Agreement which is available at
+ * www.echelon.com/license/examplesoftware/.
+ */
+#include <errno.h>
+#include <stdint.h>
+
+#include <asm/ioctls.h>
+#include <asm/termbits.h>
+
+#include "io.h"
+
+/*
+ * ioctl() is declared here, because <sys/ioctl.h> brings in definitions
+ * which conflict with <asm/termbits.h>.
+ */
+extern int ioctl(int fd, unsigned long request, ...);
+
+/*
+ * SerialSetBitrate sets the input and output bit rate of an open serial
+ * port to any value the serial driver supports, using the BOTHER encoding
+ * of termios2. All other settings remain unchanged. A rate which the
+ * driver can only approximate within more than 2% is rejected, and the
+ * previous settings are restored.
+ */
+int SerialSetBitrate(int fd, unsigned bitrate)
+{
+#if defined(TCGETS2) && defined(BOTHER)
+    struct termios2 previous;
+    struct termios2 tio;
+
+    if (ioctl(fd, TCGETS2, &previous) == -1) {
+        return -1;
+    }
+
+    tio = previous;
+    tio.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    tio.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+    tio.c_ispeed = bitrate;
+    tio.c_ospeed = bitrate;
+
+    if (ioctl(fd, TCSETS2, &tio) == -1) {
+        return -1;
+    }
+
+    /*
+     * The driver may round the bit rate to the nearest rate it supports.
+     * Reject the setting if it deviates by more than 2%.
+     */
+    if (ioctl(fd, TCGETS2, &tio) == -1) {
+        return -1;
+    }
+
+    if (tio.c_ospeed * 50u < bitrate * 49u || tio.c_ospeed * 50u > bitrate * 51u) {
+        ioctl(fd, TCSETS2, &previous);
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
@@ -77,14 +77,14 @@ static struct {
 static int Trace(const char* fmt, ...);
 
 static LdvCtrl ctrl = {
-    LDVCTRL_DEFAULT_DEVICE,
-    LDVCTRL_DEFAULT_BITRATE,
-    {
-        LDVCTRL_DEFAULT_GPIO_RTS,
-        LDVCTRL_DEFAULT_GPIO_CTS,
-        LDVCTRL_DEFAULT_GPIO_HRDY
+    .device = LDVCTRL_DEFAULT_DEVICE,
+    .bitrate = LDVCTRL_DEFAULT_BITRATE,
+    .gpio = {
+        .rts = LDVCTRL_DEFAULT_GPIO_RTS,
+        .cts = LDVCTRL_DEFAULT_GPIO_CTS,
+        .hrdy = LDVCTRL_DEFAULT_GPIO_HRDY
     },
-    Trace
+    .trace = Trace
 };
 
 /*
@@ -115,19 +115,39 @@ static void ConioCtrl(int direct)
 }
 
 /*
- * ConioPending() provides a simple non-blocking API to query availability
- * of keyboard input. The tool returns a true value if keyboard input is
- * pending.
+ * ConioPending() queries availability of keyboard input. The tool returns a
+ * true value if keyboard input is pending.
+ *
+ * When built with LON_DRIVER_EVENTS defined as non-zero, and the driver
+ * provides an event file descriptor, the function also waits for driver
+ * events, and returns when keyboard input or an incoming message is
+ * available, or after 100ms. This allows the main loop to sleep rather than
+ * spin. Without an event file descriptor, the function returns immediately.
  */
 static int ConioPending()
 {
     struct timeval timeout = { 0, 0 };  // no timeout, return immediately
     fd_set  read_fds;
+    int nfds = STDIN_FILENO + 1;
+#if LON_DRIVER_EVENTS
+    int event_fd = -1;
+#endif  /* LON_DRIVER_EVENTS */
 
     FD_ZERO(&read_fds);
     FD_SET(STDIN_FILENO, &read_fds);
 
-    select(STDIN_FILENO + 1, &read_fds, NULL, NULL, &timeout);
+#if LON_DRIVER_EVENTS
+    if (LonGetEventFd(&event_fd) == LonApiNoError && event_fd != -1) {
+        FD_SET(event_fd, &read_fds);
+        timeout.tv_usec = 100000;
+
+        if (event_fd >= nfds) {
+            nfds = event_fd + 1;
+        }
+    }
+#endif  /* LON_DRIVER_EVENTS */
+
+    select(nfds, &read_fds, NULL, NULL, &timeout);
     return FD_ISSET(STDIN_FILENO, &read_fds);
 }
 
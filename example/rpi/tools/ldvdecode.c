@@ -0,0 +1,124 @@
+/*
+ * IzoT ShortStack for Raspberry Pi Frame Log Decoder
+ *
+ * ldvdecode renders a binary frame log, written by the driver with
+ * LdvDumpLog(), as text in the format of the driver's frame trace, one
+ * line per record:
+ *
+ *  DN.00012 H:0x02.12 P:0x01.02
+ *  UP.00007 H:0x00.50
+ *
+ * With the -t option, each line begins with the record's timestamp in
+ * seconds of CLOCK_MONOTONIC, and the time since the previous record in
+ * microseconds.
+ *
+ * Build with the frame log implementation, for example:
+ *  gcc -I../driver -o ldvdecode ldvdecode.c ../driver/ldvlog.c
+ *
+ * License:
+ * Use of the source code contained in this file is subject to the terms
+ * of the Echelon Example Software License Agreement which is available at
+ * www.echelon.com/license/examplesoftware/.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ldvlog.h"
+
+#if !defined(TRUE)
+#   define TRUE 1
+#endif
+#if !defined(FALSE)
+#   define  FALSE   0
+#endif
+
+/*
+ * Decode() renders all records of one log file. Returns the number of
+ * errors.
+ */
+static int Decode(FILE* file, const char* name, int timestamps)
+{
+    LdvLogFileHeader header;
+    LdvLogRecord record;
+    char text[LDV_LOG_TEXT];
+    uint64_t previous = 0;
+    int errors = 0;
+
+    if (fread(&header, sizeof(header), 1, file) != 1
+        || header.magic != LDV_LOG_MAGIC) {
+        fprintf(stderr, "%s: not a frame log\n", name);
+        ++errors;
+    } else if (header.version != LDV_LOG_VERSION
+               || header.size != sizeof(LdvLogRecord)) {
+        fprintf(stderr, "%s: unsupported frame log version %u\n", name, header.version);
+        ++errors;
+    } else {
+        if (header.lost) {
+            printf("%u records lost\n", header.lost);
+        }
+
+        for (unsigned i = 0; i < header.count && !errors; ++i) {
+            if (fread(&record, sizeof(record), 1, file) != 1) {
+                fprintf(stderr, "%s: truncated after %u records\n", name, i);
+                ++errors;
+            } else {
+                LdvLogFormat(&record, text);
+
+                if (timestamps) {
+                    printf(
+                        "%llu.%06llu +%llu ",
+                        (unsigned long long) (record.timestamp / 1000000u),
+                        (unsigned long long) (record.timestamp % 1000000u),
+                        (unsigned long long) (previous ? record.timestamp - previous : 0)
+                    );
+                    previous = record.timestamp;
+                }
+
+                printf("%s\n", text);
+            }
+        }
+    }
+
+    return errors;
+}
+
+int main(int argc, char* argv[])
+{
+    int timestamps = FALSE;
+    int files = 0;
+    int errors = 0;
+
+    for (int i = 1; i < argc && !errors; ++i) {
+        if (strcmp(argv[i], "-t") == 0) {
+            timestamps = TRUE;
+        } else if (argv[i][0] == '-' && argv[i][1]) {
+            fprintf(
+                stderr, "Usage: %s [-t] [file...]\n"
+                "Renders frame logs written with LdvDumpLog(), or standard input.\n"
+                "-t           show timestamps\n", argv[0]);
+            ++errors;
+        } else {
+            FILE* file = strcmp(argv[i], "-") ? fopen(argv[i], "rb") : stdin;
+
+            if (file) {
+                errors += Decode(file, argv[i], timestamps);
+
+                if (file != stdin) {
+                    fclose(file);
+                }
+            } else {
+                perror(argv[i]);
+                ++errors;
+            }
+
+            ++files;
+        }
+    }
+
+    if (!files && !errors) {
+        errors += Decode(stdin, "stdin", timestamps);
+    }
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,193 @@
+/*
+ * IzoT ShortStack for Raspberry Pi Queue Benchmark
+ *
+ * ldvqbench compares the linked list queue created with LdvqOpen() with
+ * the ring queue created with LdvqOpenRing(), both implemented in ldvq.c.
+ *
+ * The first measurement reports the mean cost of one allocate, push, pop
+ * and release cycle within one thread, in nanoseconds. It shows the cost
+ * of the mutex and of the heap allocations made by the list queue, without
+ * contention.
+ *
+ * The second measurement passes timestamped frames from a producer thread
+ * to a consumer thread, one frame at a time, and reports the distribution
+ * of the time from each push until the consumer has popped the frame. The
+ * consumer polls the queue with LdvqEmpty(), as the driver's I/O thread
+ * and the ShortStack event handler do. The tail of the distribution shows
+ * the effect of lock contention between the two threads.
+ *
+ * Run the benchmark on an otherwise idle system, and with at least two
+ * CPUs for meaningful latencies.
+ *
+ * Build with the queue implementation and any example's ShortStackDev.h,
+ * for example:
+ *  gcc -std=gnu99 -O2 -DARM_NONE_EABI_GCC -I../simple -I../../../api
+ *      -I../driver -o ldvqbench ldvqbench.c ../driver/ldvq.c -lpthread
+ *
+ * License:
+ * Use of the source code contained in this file is subject to the terms
+ * of the Echelon Example Software License Agreement which is available at
+ * www.echelon.com/license/examplesoftware/.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ldvq.h"
+
+#define CYCLES      1000000     /* single-thread cycles per queue */
+#define SAMPLES     200000      /* frames passed between the threads */
+#define CAPACITY    16          /* frames per ring */
+#define POLLS       1000        /* polls before the consumer yields */
+
+/*
+ * Now() returns the time in nanoseconds of CLOCK_MONOTONIC.
+ */
+static uint64_t Now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+/*
+ * Cycle() returns the mean time in nanoseconds for one allocate, push, pop
+ * and release cycle on the given queue.
+ */
+static double Cycle(LdvqHandle q)
+{
+    const uint64_t start = Now();
+
+    for (unsigned i = 0; i < CYCLES; ++i) {
+        LonSmipMsg* frame = NULL;
+
+        if (LdvqAllocRaw(q, &frame) == LonApiNoError) {
+            LdvqPush(q, frame);
+            LdvqFree(q, LdvqPop(q));
+        }
+    }
+
+    return (double) (Now() - start) / CYCLES;
+}
+
+/*
+ * Latency describes one producer/consumer run. The producer waits for the
+ * consumer to take each frame before it pushes the next one, so that each
+ * sample measures the handover alone and not the time spent queued.
+ */
+typedef struct {
+    LdvqHandle q;
+    volatile unsigned taken;
+    uint32_t* samples;
+} Latency;
+
+static void* Consumer(void* arg)
+{
+    Latency* latency = (Latency*) arg;
+
+    for (unsigned i = 0; i < SAMPLES; ++i) {
+        LonSmipMsg* frame = NULL;
+        uint64_t pushed = 0;
+
+        for (unsigned polls = 1; LdvqEmpty(latency->q); ++polls) {
+            if (polls % POLLS == 0) {
+                /* Let the producer run on a single CPU. */
+                sched_yield();
+            }
+        }
+
+        frame = LdvqPop(latency->q);
+        memcpy(&pushed, frame->Payload, sizeof(pushed));
+        latency->samples[i] = (uint32_t) (Now() - pushed);
+        LdvqFree(latency->q, frame);
+        __atomic_store_n(&latency->taken, i + 1, __ATOMIC_RELEASE);
+    }
+
+    return NULL;
+}
+
+static int Ascending(const void* a, const void* b)
+{
+    const uint32_t x = *(const uint32_t*) a;
+    const uint32_t y = *(const uint32_t*) b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Handover() measures the latency distribution for the given queue, and
+ * prints the median, the 99th and 99.9th percentiles and the maximum in
+ * nanoseconds.
+ */
+static void Handover(const char* name, LdvqHandle q)
+{
+    Latency latency;
+    pthread_t consumer;
+
+    memset(&latency, 0, sizeof(latency));
+    latency.q = q;
+    latency.samples = calloc(SAMPLES, sizeof(uint32_t));
+
+    if (latency.samples == NULL) {
+        printf("%-5s out of memory\n", name);
+        return;
+    }
+
+    pthread_create(&consumer, NULL, Consumer, &latency);
+
+    for (unsigned i = 0; i < SAMPLES; ++i) {
+        LonSmipMsg* frame = NULL;
+        uint64_t pushed = 0;
+
+        while (LdvqAllocRaw(q, &frame) != LonApiNoError) {
+            sched_yield();
+        }
+
+        pushed = Now();
+        memcpy(frame->Payload, &pushed, sizeof(pushed));
+        LdvqPush(q, frame);
+
+        while (__atomic_load_n(&latency.taken, __ATOMIC_ACQUIRE) <= i) {
+            sched_yield();
+        }
+    }
+
+    pthread_join(consumer, NULL);
+    qsort(latency.samples, SAMPLES, sizeof(uint32_t), Ascending);
+
+    printf(
+        "%-5s handover (ns): median %u, 99%% %u, 99.9%% %u, max %u\n", name,
+        latency.samples[SAMPLES / 2],
+        latency.samples[SAMPLES - SAMPLES / 100],
+        latency.samples[SAMPLES - SAMPLES / 1000],
+        latency.samples[SAMPLES - 1]
+    );
+
+    free(latency.samples);
+}
+
+int main(void)
+{
+    const LdvqHandle list = LdvqOpen();
+    const LdvqHandle ring = LdvqOpenRing(CAPACITY);
+
+    if (!list || !ring) {
+        fprintf(stderr, "Can't open the queues\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("list  cycle (ns): %.1f\n", Cycle(list));
+    printf("ring  cycle (ns): %.1f\n", Cycle(ring));
+
+    Handover("list", list);
+    Handover("ring", ring);
+
+    LdvqClose(list);
+    LdvqClose(ring);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,262 @@
+/*
+ * IzoT ShortStack for Raspberry Pi Queue Stress Test
+ *
+ * ldvqstress passes frames from a producer thread to a consumer thread
+ * through each kind of queue implemented in ldvq.c: the linked list queue
+ * created with LdvqOpen(), a ring queue created with LdvqOpenRing(), and
+ * a ring queue with a second lane created with LdvqOpenLane(). This is the
+ * pattern the driver uses between its I/O thread and the thread which runs
+ * the ShortStack event handler.
+ *
+ * The producer allocates each frame, numbers it and pushes it. When a
+ * ring is full, the producer discards the oldest frame every other time,
+ * racing with the consumer for it, as the driver's overflow policy does.
+ * The consumer pops frames singly and in batches, and releases them singly
+ * and in batches.
+ *
+ * The test checks that each lane delivers its frames in order without
+ * duplicates, that every frame is either delivered or discarded, that all
+ * frames return to the pool, and that ring queues make no heap allocation
+ * after they are opened. It exits with a non-zero status if any check
+ * fails.
+ *
+ * Build with the queue implementation and any example's ShortStackDev.h,
+ * for example:
+ *  gcc -std=gnu99 -O2 -DARM_NONE_EABI_GCC -I../simple -I../../../api
+ *      -I../driver -o ldvqstress ldvqstress.c ../driver/ldvq.c -lpthread
+ *
+ * License:
+ * Use of the source code contained in this file is subject to the terms
+ * of the Echelon Example Software License Agreement which is available at
+ * www.echelon.com/license/examplesoftware/.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ldvq.h"
+
+#define FRAMES      1000000     /* frames per test */
+#define CAPACITY    16          /* frames per ring */
+#define BATCH       8           /* frames per batch */
+#define LANES       2
+
+/*
+ * Test describes one run: the queue kind, the lanes which the producer
+ * feeds in turn, and the counts gathered by both threads.
+ */
+typedef struct {
+    const char* name;
+    int ring;
+    unsigned lanes;
+    LdvqHandle lane[LANES];
+    volatile int done;
+    unsigned long produced;
+    unsigned long discarded;
+    unsigned long delivered;
+    unsigned long disorder;
+} Test;
+
+/*
+ * The frame's sequence number, per lane, is kept in its payload.
+ */
+static void Stamp(LonSmipMsg* frame, uint32_t sequence)
+{
+    memcpy(frame->Payload, &sequence, sizeof(sequence));
+}
+
+static uint32_t Sequence(const LonSmipMsg* frame)
+{
+    uint32_t sequence = 0;
+
+    memcpy(&sequence, frame->Payload, sizeof(sequence));
+    return sequence;
+}
+
+static void* Producer(void* arg)
+{
+    Test* test = (Test*) arg;
+    uint32_t sequence[LANES] = { 0 };
+    unsigned full = 0;
+
+    for (unsigned long i = 0; i < FRAMES; ++i) {
+        const unsigned lane = i % test->lanes;
+        LonSmipMsg* frame = NULL;
+
+        while (LdvqAlloc(test->lane[0], &frame) != LonApiNoError) {
+            sched_yield();
+        }
+
+        Stamp(frame, ++sequence[lane]);
+
+        while (LdvqPush(test->lane[lane], frame) != LonApiNoError) {
+            LonSmipMsg* oldest = NULL;
+
+            if (test->ring && ++full % 2) {
+                oldest = LdvqPop(test->lane[lane]);
+            }
+
+            if (oldest) {
+                LdvqFree(test->lane[lane], oldest);
+                ++test->discarded;
+            } else {
+                sched_yield();
+            }
+        }
+
+        ++test->produced;
+    }
+
+    __atomic_store_n(&test->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void* Consumer(void* arg)
+{
+    Test* test = (Test*) arg;
+    uint32_t last[LANES] = { 0 };
+    LonSmipMsg* frames[BATCH];
+    unsigned long round = 0;
+    int done = 0;
+
+    while (!done) {
+        unsigned long received = test->delivered;
+        unsigned count = 0;
+
+        /* Test for completion before popping, so that no frame is left. */
+        done = __atomic_load_n(&test->done, __ATOMIC_ACQUIRE);
+
+        for (unsigned lane = 0; lane < test->lanes; ++lane) {
+            do {
+                if (++round % 2) {
+                    frames[0] = LdvqPop(test->lane[lane]);
+                    count = frames[0] ? 1 : 0;
+                } else {
+                    count = LdvqPopMany(test->lane[lane], frames, BATCH);
+                }
+
+                for (unsigned i = 0; i < count; ++i) {
+                    const uint32_t sequence = Sequence(frames[i]);
+
+                    if (sequence <= last[lane]) {
+                        ++test->disorder;
+                    }
+
+                    last[lane] = sequence;
+                }
+
+                if (count > 1) {
+                    LdvqFreeMany(test->lane[lane], frames, count);
+                } else if (count) {
+                    LdvqFree(test->lane[lane], frames[0]);
+                }
+
+                test->delivered += count;
+            } while (count);
+        }
+
+        if (test->delivered == received) {
+            /* Nothing to do, let the producer run. */
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Run() runs one test, reports the result and returns the number of
+ * failed checks.
+ */
+static int Run(Test* test)
+{
+    LdvQueueStatistics before;
+    LdvQueueStatistics after;
+    pthread_t producer;
+    pthread_t consumer;
+    int failures = 0;
+
+    LdvqGetStatistics(test->lane[0], &before);
+
+    pthread_create(&consumer, NULL, Consumer, test);
+    pthread_create(&producer, NULL, Producer, test);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+
+    LdvqGetStatistics(test->lane[0], &after);
+
+    printf(
+        "%-10s produced %lu, delivered %lu, discarded %lu, out of order %lu, "
+        "allocated %u, heap allocations %lu\n",
+        test->name, test->produced, test->delivered, test->discarded,
+        test->disorder, after.allocated, after.heap - before.heap
+    );
+
+    if (test->disorder) {
+        printf("FAIL: %s: frames out of order or duplicated\n", test->name);
+        ++failures;
+    }
+
+    if (test->delivered + test->discarded != test->produced) {
+        printf("FAIL: %s: frames lost\n", test->name);
+        ++failures;
+    }
+
+    if (after.allocated) {
+        printf("FAIL: %s: frames not returned to the pool\n", test->name);
+        ++failures;
+    }
+
+    if (test->ring && after.heap != before.heap) {
+        printf("FAIL: %s: heap allocations after LdvqOpenRing()\n", test->name);
+        ++failures;
+    }
+
+    return failures;
+}
+
+int main(void)
+{
+    Test tests[3];
+    int failures = 0;
+
+    memset(tests, 0, sizeof(tests));
+
+    tests[0].name = "list";
+    tests[0].lanes = 1;
+    tests[0].lane[0] = LdvqOpen();
+
+    tests[1].name = "ring";
+    tests[1].ring = 1;
+    tests[1].lanes = 1;
+    tests[1].lane[0] = LdvqOpenRing(CAPACITY);
+
+    tests[2].name = "ring+lane";
+    tests[2].ring = 1;
+    tests[2].lanes = 2;
+    tests[2].lane[0] = LdvqOpenRing(CAPACITY);
+    tests[2].lane[1] = LdvqOpenLane(tests[2].lane[0], CAPACITY / 4);
+
+    for (int i = 0; i < 3; ++i) {
+        if (tests[i].lane[0] && (tests[i].lanes == 1 || tests[i].lane[1])) {
+            failures += Run(&tests[i]);
+        } else {
+            printf("FAIL: %s: queue not opened\n", tests[i].name);
+            ++failures;
+        }
+
+        if (tests[i].lane[1]) {
+            LdvqClose(tests[i].lane[1]);
+        }
+
+        if (tests[i].lane[0]) {
+            LdvqClose(tests[i].lane[0]);
+        }
+    }
+
+    printf("%d failure%s\n", failures, failures == 1 ? "" : "s");
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,260 @@
+/*
+ * IzoT ShortStack for Raspberry Pi Mock GPIO Test
+ *
+ * mocktest exercises the in-memory mock GPIO backend, and the driver's
+ * RTS/CTS handshake with mock pins over a pseudo-terminal. No Micro Server
+ * and no GPIO hardware is required. A thread plays the part of the Micro
+ * Server: it answers each RTS assertion with CTS, and reads the segment
+ * sent by the driver.
+ *
+ * mocktest prints one line per check, and exits with a non-zero status if
+ * any check fails.
+ *
+ * Build with the driver and the io utilities, for example:
+ *  gcc -std=gnu99 -DARM_NONE_EABI_GCC -DLON_DRIVER_STATISTICS=1
+ *      -DLON_DRIVER_EVENTS=1 -I../simple -I../../../api -I../driver -I../io
+ *      -o mocktest mocktest.c ../driver/rpi.c ../driver/ldvq.c ../driver/ldvlog.c
+ *      ../io/gpio.c ../io/serial.c -lpthread -lutil
+ *
+ * License:
+ * Use of the source code contained in this file is subject to the terms
+ * of the Echelon Example Software License Agreement which is available at
+ * www.echelon.com/license/examplesoftware/.
+ */
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <pty.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "ShortStackDev.h"
+#include "ShortStackApi.h"
+#include "ldv.h"
+#include "io.h"
+
+/*
+ * The mock pins used for the driver's handshake. The handshake signals
+ * are active low.
+ */
+#define PIN_RTS     10
+#define PIN_CTS     9
+#define PIN_HRDY    11
+
+/*
+ * A pin used for the GPIO checks only.
+ */
+#define PIN_TEST    20
+
+static int failures;
+
+static void Check(int condition, const char* name)
+{
+    printf("%s: %s\n", condition ? "pass" : "FAIL", name);
+
+    if (!condition) {
+        ++failures;
+    }
+}
+
+/*
+ * Pending() returns TRUE if the descriptor is readable within 'timeout'
+ * milliseconds.
+ */
+static int Pending(int fd, int timeout)
+{
+    struct pollfd entry = { fd, POLLIN, 0 };
+
+    return poll(&entry, 1, timeout) == 1;
+}
+
+static void TestGpio(void)
+{
+    GpioPin pin;
+    GpioPin output;
+
+    Check(
+        GpioPinOpen(&pin, GpioMock, NULL, 64, GpioInput) == -1 && errno == EINVAL,
+        "mock pin number out of range"
+    );
+
+    Check(
+        GpioPinOpen(&output, GpioMock, NULL, PIN_TEST, GpioOutputLow) == 0
+        && GpioMockGet(PIN_TEST) == 0,
+        "output initially low"
+    );
+    GpioPinWrite(&output, 1);
+    Check(GpioMockGet(PIN_TEST) == 1 && GpioPinRead(&output) == 1, "output written high");
+    GpioPinClose(&output);
+
+    Check(
+        GpioPinOpen(&pin, GpioMock, NULL, PIN_TEST, GpioInputEdges) == 0,
+        "input with edges opened"
+    );
+    Check(!Pending(pin.fd, 0), "no edge after open");
+
+    GpioMockSet(PIN_TEST, 0);
+    Check(Pending(pin.fd, 0), "falling edge signalled");
+    Check(GpioPinEvent(&pin) == 0 && pin.timestamp != 0, "falling edge level and timestamp");
+    Check(!Pending(pin.fd, 0), "edge consumed");
+
+    GpioMockSet(PIN_TEST, 0);
+    Check(!Pending(pin.fd, 0), "no edge without a change of level");
+
+    GpioMockSet(PIN_TEST, 1);
+    Check(Pending(pin.fd, 0) && GpioPinEvent(&pin) == 1, "rising edge signalled");
+    GpioPinClose(&pin);
+
+    Check(
+        GpioPinOpen(&pin, GpioMock, NULL, PIN_TEST, GpioInput) == 0,
+        "input without edges opened"
+    );
+    GpioMockSet(PIN_TEST, 0);
+    Check(!Pending(pin.fd, 0) && GpioPinRead(&pin) == 0, "input without edges reads level only");
+    GpioPinClose(&pin);
+}
+
+/*
+ * The Micro Server's side of the link: the pseudo-terminal master and the
+ * data received from the driver.
+ */
+typedef struct {
+    int master;
+    volatile int stop;
+    uint8_t data[512];
+    volatile unsigned size;
+    volatile unsigned segments;
+} Peer;
+
+/*
+ * PeerThread() answers each RTS assertion with CTS, reads the segment and
+ * de-asserts CTS once the driver has de-asserted RTS.
+ */
+static void* PeerThread(void* arg)
+{
+    Peer* peer = (Peer*) arg;
+
+    while (!peer->stop) {
+        if (GpioMockGet(PIN_RTS) == 0) {
+            GpioMockSet(PIN_CTS, 0);
+
+            while (!peer->stop && GpioMockGet(PIN_RTS) == 0) {
+                usleep(50);
+            }
+
+            while (Pending(peer->master, 20)) {
+                const ssize_t got = read(
+                    peer->master, &peer->data[peer->size], sizeof(peer->data) - peer->size
+                );
+
+                if (got > 0) {
+                    peer->size += got;
+                }
+            }
+
+            peer->segments += 1;
+            GpioMockSet(PIN_CTS, 1);
+        }
+
+        usleep(50);
+    }
+
+    return NULL;
+}
+
+static void TestDriver(void)
+{
+    Peer peer;
+    pthread_t thread;
+    struct termios tio;
+    char name[64];
+    int slave = -1;
+    LdvCtrl ctrl;
+    LdvHandle handle = 0;
+    LonSmipMsg* frame = NULL;
+
+    memset(&peer, 0, sizeof(peer));
+
+    if (openpty(&peer.master, &slave, name, NULL, NULL) == -1) {
+        Check(0, "pseudo-terminal opened");
+        return;
+    }
+
+    tcgetattr(peer.master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(peer.master, TCSANOW, &tio);
+
+    memset(&ctrl, 0, sizeof(ctrl));
+    ctrl.device = name;
+    ctrl.bitrate = LDVCTRL_DEFAULT_BITRATE;
+    ctrl.gpio.rts = PIN_RTS;
+    ctrl.gpio.cts = PIN_CTS;
+    ctrl.gpio.hrdy = PIN_HRDY;
+    ctrl.gpio.backend = LdvGpioMock;
+
+    Check(LdvOpen(&ctrl, &handle) == LonApiNoError, "driver opened with mock pins");
+
+    if (handle) {
+        Check(GpioMockGet(PIN_HRDY) == 0 && GpioMockGet(PIN_RTS) == 1, "HRDY asserted, RTS idle");
+
+        pthread_create(&thread, NULL, PeerThread, &peer);
+
+        /* Downlink: header and payload, one handshake each. */
+        if (LdvAllocateMsg(handle, &frame) == LonApiNoError) {
+            frame->Header.Length = 3;
+            frame->Header.Command = 0x12;
+            frame->Payload[0] = 1;
+            frame->Payload[1] = 2;
+            frame->Payload[2] = 3;
+            LdvPutMsg(handle, frame);
+        }
+
+        for (int wait = 0; wait < 100 && peer.segments < 2; ++wait) {
+            usleep(10000);
+        }
+
+        Check(peer.segments == 2, "downlink frame sent in two segments");
+        Check(
+            peer.size == 5
+            && memcmp(peer.data, "\x03\x12\x01\x02\x03", 5) == 0,
+            "downlink frame data received"
+        );
+
+        /* Uplink: one frame, written by the Micro Server at once. */
+        frame = NULL;
+        Check(write(peer.master, "\x02\x50\x0A\x0B", 4) == 4, "uplink frame written");
+        Check(LdvWaitForEvent(handle, 1000) == LonApiNoError, "uplink frame signalled");
+        Check(
+            LdvGetMsg(handle, &frame) == LonApiNoError
+            && frame->Header.Length == 2 && frame->Header.Command == 0x50
+            && frame->Payload[0] == 0x0A && frame->Payload[1] == 0x0B,
+            "uplink frame received"
+        );
+
+        if (frame) {
+            LdvReleaseMsg(handle, frame);
+        }
+
+        peer.stop = 1;
+        pthread_join(thread, NULL);
+
+        Check(LdvClose(handle) == LonApiNoError, "driver closed");
+        Check(GpioMockGet(PIN_HRDY) == 1, "HRDY released");
+    }
+
+    close(slave);
+    close(peer.master);
+}
+
+int main(void)
+{
+    TestGpio();
+    TestDriver();
+
+    printf("%d failure%s\n", failures, failures == 1 ? "" : "s");
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,223 @@
+/*
+ * IzoT ShortStack for Raspberry Pi Uplink Noise Test
+ *
+ * noisetest plays the part of a Micro Server on a noisy serial line: it
+ * writes numbered uplink frames to a pseudo-terminal, with bursts of line
+ * noise before some frames and truncated frames before others. The driver
+ * runs with mock GPIO pins and with LdvCtrl.uplink.resync enabled, so that
+ * no Micro Server and no GPIO hardware is required.
+ *
+ * Noise bytes never start a valid header, so the driver must skip each
+ * burst byte by byte and count one resync per burst. A truncated frame
+ * is followed by a pause longer than the uplink data timeout, so the driver
+ * must discard it and count one uplink timeout. The test checks these
+ * counters, and that every complete frame is delivered once, in order and
+ * intact.
+ *
+ * noisetest prints one line per check, and exits with a non-zero status if
+ * any check fails.
+ *
+ * Build with the driver and the io utilities, for example:
+ *  gcc -std=gnu99 -DARM_NONE_EABI_GCC -DLON_DRIVER_STATISTICS=1
+ *      -DLON_DRIVER_EVENTS=1 -I../simple -I../../../api -I../driver -I../io
+ *      -o noisetest noisetest.c ../driver/rpi.c ../driver/ldvq.c ../driver/ldvlog.c
+ *      ../io/gpio.c ../io/serial.c -lpthread -lutil
+ *
+ * License:
+ * Use of the source code contained in this file is subject to the terms
+ * of the Echelon Example Software License Agreement which is available at
+ * www.echelon.com/license/examplesoftware/.
+ */
+#include <pty.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ShortStackDev.h"
+#include "ShortStackApi.h"
+#include "ldv.h"
+
+/*
+ * The mock pins used by the driver.
+ */
+#define PIN_RTS     10
+#define PIN_CTS     9
+
+#define FRAMES      300     /* complete frames sent */
+#define NOISY       3       /* every third frame follows a noise burst */
+#define TRUNCATED   25      /* every 25th frame follows a truncated frame */
+#define PAUSE       150000  /* us after a truncated frame, beyond the timeout */
+
+/*
+ * The uplink frames: a received message, LonNiComm | LonNiIncoming, with
+ * three bytes of payload which hold the frame's number.
+ */
+#define COMMAND     0x18
+#define LENGTH      3
+
+static int failures;
+
+static void Check(int condition, const char* name)
+{
+    printf("%s: %s\n", condition ? "pass" : "FAIL", name);
+
+    if (!condition) {
+        ++failures;
+    }
+}
+
+/*
+ * Frame() writes the header and payload of frame 'number' to 'buffer', and
+ * returns the size of the frame.
+ */
+static unsigned Frame(uint8_t* buffer, unsigned number)
+{
+    buffer[0] = LENGTH;
+    buffer[1] = COMMAND;
+    buffer[2] = (uint8_t) number;
+    buffer[3] = (uint8_t) (number >> 8);
+    buffer[4] = (uint8_t) ~number;
+
+    return 2 + LENGTH;
+}
+
+/*
+ * Noise() writes one to five noise bytes to 'buffer' and returns their
+ * number. Bytes 0x30..0x3F are neither a valid command, nor do they form
+ * a valid header with the length byte of the frame which follows.
+ */
+static unsigned Noise(uint8_t* buffer)
+{
+    const unsigned count = 1 + rand() % 5;
+
+    for (unsigned i = 0; i < count; ++i) {
+        buffer[i] = (uint8_t) (0x30 + rand() % 0x10);
+    }
+
+    return count;
+}
+
+/*
+ * Collect() receives frames until 'expected' frames have arrived, or no
+ * frame arrived for a second, and checks the number of each frame. It
+ * returns the number of frames received so far.
+ */
+static unsigned Collect(LdvHandle handle, unsigned received, unsigned expected,
+                        unsigned* damaged)
+{
+    while (received < expected && LdvWaitForEvent(handle, 1000) == LonApiNoError) {
+        LonSmipMsg* frame = NULL;
+
+        while (LdvGetMsg(handle, &frame) == LonApiNoError) {
+            const unsigned number = frame->Payload[0] | (frame->Payload[1] << 8);
+
+            if (frame->Header.Length != LENGTH || frame->Header.Command != COMMAND
+                || number != received || frame->Payload[2] != (uint8_t) ~number) {
+                *damaged += 1;
+            }
+
+            received += 1;
+            LdvReleaseMsg(handle, frame);
+        }
+    }
+
+    return received;
+}
+
+int main(void)
+{
+    struct termios tio;
+    char name[64];
+    int master = -1;
+    int slave = -1;
+    LdvCtrl ctrl;
+    LdvHandle handle = 0;
+    LdvStatistics statistics;
+    unsigned received = 0;
+    unsigned damaged = 0;
+    unsigned long bursts = 0;
+    unsigned long noise = 0;
+    unsigned long truncated = 0;
+
+    if (openpty(&master, &slave, name, NULL, NULL) == -1) {
+        perror("noisetest");
+        return EXIT_FAILURE;
+    }
+
+    tcgetattr(master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(master, TCSANOW, &tio);
+
+    memset(&ctrl, 0, sizeof(ctrl));
+    ctrl.device = name;
+    ctrl.bitrate = LDVCTRL_DEFAULT_BITRATE;
+    ctrl.gpio.rts = PIN_RTS;
+    ctrl.gpio.cts = PIN_CTS;
+    ctrl.gpio.backend = LdvGpioMock;
+    ctrl.uplink.resync = 1;
+
+    Check(LdvOpen(&ctrl, &handle) == LonApiNoError, "driver opened with resync");
+
+    if (handle) {
+        srand(1);
+
+        for (unsigned i = 0; i < FRAMES; ++i) {
+            uint8_t buffer[16];
+            unsigned size = 0;
+
+            if (i % TRUNCATED == TRUNCATED - 1) {
+                /* The header and part of the payload only. */
+                size = Frame(buffer, 0xFFFF) - 1 - rand() % LENGTH;
+
+                if (write(master, buffer, size) == (ssize_t) size) {
+                    truncated += 1;
+                }
+
+                usleep(PAUSE);
+                size = 0;
+            }
+
+            if (i % NOISY == NOISY - 1) {
+                size = Noise(buffer);
+                bursts += 1;
+                noise += size;
+            }
+
+            size += Frame(&buffer[size], i);
+
+            if (write(master, buffer, size) != (ssize_t) size) {
+                break;
+            }
+
+            received = Collect(handle, received, i + 1, &damaged);
+        }
+
+        LdvGetStatistics(handle, &statistics);
+
+        printf(
+            "sent %u frames, %lu noise bursts (%lu bytes), %lu truncated frames\n"
+            "received %u frames, %lu resyncs, %lu bytes skipped, %lu uplink timeouts\n",
+            FRAMES, bursts, noise, truncated,
+            received, statistics.uplink.resyncs, statistics.uplink.skipped,
+            statistics.uplink.timeouts
+        );
+
+        Check(received == FRAMES, "every complete frame delivered");
+        Check(damaged == 0, "frames delivered in order and intact");
+        Check(statistics.uplink.resyncs == bursts, "one resync per noise burst");
+        Check(statistics.uplink.skipped == noise, "noise bytes skipped");
+        Check(statistics.uplink.timeouts == truncated, "truncated frames discarded");
+
+        Check(LdvClose(handle) == LonApiNoError, "driver closed");
+    }
+
+    close(slave);
+    close(master);
+
+    printf("%d failure%s\n", failures, failures == 1 ? "" : "s");
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,319 @@
+/*
+ * IzoT ShortStack for Raspberry Pi Downlink Recovery Test
+ *
+ * recovertest injects handshake faults into the driver's downlink, and
+ * reports how the driver's link-level recovery (LdvCtrl.recovery) deals
+ * with them. The driver runs with mock GPIO pins over a pseudo-terminal,
+ * so that no Micro Server and no GPIO hardware is required. A thread
+ * plays the part of the Micro Server, and answers RTS with CTS, except
+ * where the test tells it to withhold its CTS response:
+ *
+ * warmup  The Micro Server answers every frame, so that the driver's
+ *         adaptive handshake timeout (LdvCtrl.adaptive) applies.
+ * missed  The Micro Server misses the first RTS edge of each frame. The
+ *         driver must detect each stall, re-assert RTS and so recover
+ *         every frame without a timeout.
+ * deaf    The Micro Server does not respond to one frame at all. The
+ *         driver must transmit the frame again after the handshake
+ *         timeout, then discard it.
+ * idle    Nothing is sent. The driver must not detect stalls while it has
+ *         no frame to send.
+ *
+ * For each phase, recovertest prints the stall, resync, retransmit,
+ * timeout and recovery counts, and the mean and longest time to recovery
+ * from the driver's statistics. It exits with a non-zero status if any
+ * check fails. The test takes several seconds, because the handshake
+ * timeout cannot be shorter than the Micro Server's watchdog interval.
+ *
+ * Build with the driver and the io utilities, for example:
+ *  gcc -std=gnu99 -DARM_NONE_EABI_GCC -DLON_DRIVER_STATISTICS=1 -I../simple
+ *      -I../../../api -I../driver -I../io -o recovertest recovertest.c ../driver/rpi.c
+ *      ../driver/ldvq.c ../driver/ldvlog.c ../io/gpio.c ../io/serial.c
+ *      -lpthread -lutil
+ *
+ * License:
+ * Use of the source code contained in this file is subject to the terms
+ * of the Echelon Example Software License Agreement which is available at
+ * www.echelon.com/license/examplesoftware/.
+ */
+#include <poll.h>
+#include <pthread.h>
+#include <pty.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "ShortStackDev.h"
+#include "ShortStackApi.h"
+#include "ldv.h"
+#include "io.h"
+
+/*
+ * The mock pins used for the driver's handshake. The handshake signals
+ * are active low.
+ */
+#define PIN_RTS     10
+#define PIN_CTS     9
+
+#define STALL       20      /* ms, LdvCtrl.recovery.stall */
+#define RETRIES     1       /* LdvCtrl.recovery.retries */
+#define CEILING     1000    /* ms, the handshake timeout's ceiling */
+#define WARMUP      40      /* frames sent in the 'warmup' phase */
+#define FRAMES      10      /* frames sent in the 'missed' phase */
+#define IDLE        500     /* ms, duration of the 'idle' phase */
+
+/*
+ * The Micro Server's behaviour, see the file header.
+ */
+typedef enum {
+    PeerAnswer = 0,
+    PeerMissFirst,
+    PeerDeaf
+} PeerMode;
+
+/*
+ * Peer describes the Micro Server thread.
+ */
+typedef struct {
+    int master;
+    volatile PeerMode mode;
+    volatile int stop;
+    volatile unsigned answered;
+} Peer;
+
+static int failures;
+
+static void Check(int condition, const char* name)
+{
+    printf("%s: %s\n", condition ? "pass" : "FAIL", name);
+
+    if (!condition) {
+        ++failures;
+    }
+}
+
+/*
+ * Answer() responds to an RTS assertion: it asserts CTS, reads the segment,
+ * and de-asserts CTS once the driver has de-asserted RTS.
+ */
+static void Answer(Peer* peer)
+{
+    struct pollfd entry = { peer->master, POLLIN, 0 };
+    uint8_t data[64];
+
+    GpioMockSet(PIN_CTS, 0);
+
+    if (poll(&entry, 1, 200) == 1) {
+        read(peer->master, data, sizeof(data));
+    }
+
+    while (GpioMockGet(PIN_RTS) == 0 && !peer->stop) {
+        usleep(50);
+    }
+
+    GpioMockSet(PIN_CTS, 1);
+    __atomic_store_n(&peer->answered, peer->answered + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * PeerThread() watches RTS for falling edges, and answers or ignores each
+ * according to the peer's mode.
+ */
+static void* PeerThread(void* arg)
+{
+    Peer* peer = (Peer*) arg;
+    int previous = 1;
+    int missed = 0;
+
+    while (!peer->stop) {
+        const int rts = GpioMockGet(PIN_RTS);
+
+        if (previous == 1 && rts == 0) {
+            if (peer->mode == PeerDeaf) {
+                /* Withhold CTS. */
+            } else if (peer->mode == PeerMissFirst && !missed) {
+                missed = 1;
+            } else {
+                Answer(peer);
+                missed = 0;
+            }
+        }
+
+        previous = GpioMockGet(PIN_RTS);
+        usleep(50);
+    }
+
+    return NULL;
+}
+
+/*
+ * Send() sends one frame of header only, and waits up to 'timeout' ms until
+ * the peer has answered it and the driver has released it.
+ */
+static void Send(LdvHandle handle, Peer* peer, unsigned timeout)
+{
+    const unsigned answered = peer->answered;
+    LonSmipMsg* frame = NULL;
+    LdvStatistics statistics;
+
+    if (LdvAllocateMsgWait(handle, &frame) != LonApiNoError) {
+        return;
+    }
+
+    frame->Header.Length = 0;
+    frame->Header.Command = 0x12;
+    LdvPutMsg(handle, frame);
+
+    for (unsigned wait = 0; wait < timeout; wait += 10) {
+        usleep(10000);
+        LdvGetStatistics(handle, &statistics);
+
+        if (statistics.downlink.queue.allocated == 0
+            && (peer->mode == PeerDeaf || peer->answered != answered)) {
+            break;
+        }
+    }
+}
+
+static void Report(const char* phase, const LdvStatistics* statistics)
+{
+    const unsigned long recovered = statistics->downlink.recovery.recovered;
+
+    printf(
+        "%-7s stalls %lu, edges %lu, resyncs %lu, retransmits %lu, timeouts %lu, "
+        "recovered %lu, mean %luus, longest %luus, CTS timeout %ums\n", phase,
+        statistics->downlink.recovery.stalls, statistics->downlink.recovery.edges,
+        statistics->downlink.recovery.resyncs, statistics->downlink.recovery.retransmits,
+        statistics->downlink.timeouts, recovered,
+        recovered ? statistics->downlink.recovery.time / recovered : 0,
+        statistics->downlink.recovery.longest, statistics->timeouts.ctsAssert
+    );
+}
+
+int main(void)
+{
+    Peer peer;
+    pthread_t thread;
+    struct termios tio;
+    char name[64];
+    int slave = -1;
+    LdvCtrl ctrl;
+    LdvHandle handle = 0;
+    LdvStatistics warmup;
+    LdvStatistics missed;
+    LdvStatistics deaf;
+    LdvStatistics idle;
+    LdvStatistics answered;
+
+    memset(&peer, 0, sizeof(peer));
+
+    if (openpty(&peer.master, &slave, name, NULL, NULL) == -1) {
+        perror("recovertest");
+        return EXIT_FAILURE;
+    }
+
+    tcgetattr(peer.master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(peer.master, TCSANOW, &tio);
+
+    memset(&ctrl, 0, sizeof(ctrl));
+    ctrl.device = name;
+    ctrl.bitrate = LDVCTRL_DEFAULT_BITRATE;
+    ctrl.gpio.rts = PIN_RTS;
+    ctrl.gpio.cts = PIN_CTS;
+    ctrl.gpio.backend = LdvGpioMock;
+    ctrl.recovery.stall = STALL;
+    ctrl.recovery.retries = RETRIES;
+    ctrl.adaptive.multiple = 2;
+    ctrl.adaptive.ceiling = CEILING;
+
+    Check(LdvOpen(&ctrl, &handle) == LonApiNoError, "driver opened with recovery");
+
+    if (handle) {
+        pthread_create(&thread, NULL, PeerThread, &peer);
+
+        for (int i = 0; i < WARMUP; ++i) {
+            Send(handle, &peer, 1000);
+        }
+
+        LdvGetStatistics(handle, &warmup);
+        Report("warmup", &warmup);
+        Check(
+            warmup.downlink.recovery.stalls == 0 && warmup.downlink.timeouts == 0,
+            "warmup: no stall"
+        );
+        Check(warmup.timeouts.ctsAssert <= CEILING, "warmup: adaptive handshake timeout");
+
+        peer.mode = PeerMissFirst;
+
+        for (int i = 0; i < FRAMES; ++i) {
+            Send(handle, &peer, 1000);
+        }
+
+        LdvGetStatistics(handle, &missed);
+        Report("missed", &missed);
+        Check(missed.downlink.recovery.stalls == FRAMES, "missed: one stall per frame");
+        Check(missed.downlink.recovery.resyncs == FRAMES, "missed: RTS re-asserted once per frame");
+        Check(missed.downlink.recovery.recovered == FRAMES, "missed: every stall recovered");
+        Check(missed.downlink.timeouts == 0, "missed: no timeout");
+        Check(
+            missed.downlink.recovery.longest >= STALL * 1000u
+            && missed.downlink.recovery.longest < 4 * STALL * 1000u,
+            "missed: time to recovery about one stall interval"
+        );
+
+        peer.mode = PeerDeaf;
+        Send(handle, &peer, (RETRIES + 1) * 3 * CEILING);
+
+        LdvGetStatistics(handle, &deaf);
+        Report("deaf", &deaf);
+        Check(
+            deaf.downlink.recovery.retransmits - missed.downlink.recovery.retransmits == RETRIES,
+            "deaf: frame transmitted again"
+        );
+        Check(
+            deaf.downlink.timeouts - missed.downlink.timeouts == RETRIES + 1,
+            "deaf: frame discarded after the last timeout"
+        );
+        Check(deaf.downlink.queue.allocated == 0, "deaf: frame released");
+        Check(
+            deaf.downlink.recovery.recovered == missed.downlink.recovery.recovered,
+            "deaf: no recovery counted"
+        );
+
+        peer.mode = PeerAnswer;
+        usleep(IDLE * 1000);
+
+        LdvGetStatistics(handle, &idle);
+        Report("idle", &idle);
+        Check(
+            idle.downlink.recovery.stalls == deaf.downlink.recovery.stalls
+            && idle.downlink.recovery.resyncs == deaf.downlink.recovery.resyncs,
+            "idle: no stall detected without a frame"
+        );
+
+        Send(handle, &peer, 1000);
+
+        LdvGetStatistics(handle, &answered);
+        Report("answer", &answered);
+        Check(
+            answered.downlink.recovery.recovered == idle.downlink.recovery.recovered
+            && answered.downlink.recovery.longest == idle.downlink.recovery.longest,
+            "answer: recovery statistics unchanged"
+        );
+
+        peer.stop = 1;
+        pthread_join(thread, NULL);
+
+        Check(LdvClose(handle) == LonApiNoError, "driver closed");
+    }
+
+    close(slave);
+    close(peer.master);
+
+    printf("%d failure%s\n", failures, failures == 1 ? "" : "s");
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
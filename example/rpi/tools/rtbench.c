@@ -0,0 +1,313 @@
+/*
+ * IzoT ShortStack for Raspberry Pi Handshake Latency Benchmark
+ *
+ * rtbench measures how quickly the driver responds to the Micro Server's
+ * CTS signal while other threads load the CPUs, in the style of
+ * cyclictest. It uses mock GPIO pins and a pseudo-terminal, so that no
+ * Micro Server and no GPIO hardware is required.
+ *
+ * A thread plays the part of the Micro Server. For each downlink segment,
+ * it waits for RTS, asserts CTS and measures the time until the segment's
+ * data arrives at the pseudo-terminal. This is the time the driver's I/O
+ * thread takes to wake up and write the segment. Meanwhile, load threads
+ * spin on all CPUs.
+ *
+ * The benchmark runs twice: with the driver's default thread settings, and
+ * with the real-time options of LdvCtrl.thread (SCHED_FIFO priority, CPU
+ * affinity and memory locking). For each run, it prints the minimum,
+ * median, 99th and 99.9th percentile and maximum latency in microseconds.
+ * The Micro Server thread runs with SCHED_FIFO priority 99 in both runs
+ * where permitted, so that its own wakeups do not distort the results.
+ *
+ * Real-time priority and memory locking require suitable privileges, such
+ * as running as root. The driver reports when it cannot apply an option,
+ * and the benchmark prints that report.
+ *
+ * Options:
+ * -l n   number of load threads, default: one per CPU
+ * -n n   number of segments per run, default 10000
+ * -p n   SCHED_FIFO priority of the driver's thread, default 80
+ * -c m   CPU mask of the driver's thread, default 0 (all CPUs)
+ *
+ * Build with the driver and the io utilities, for example:
+ *  gcc -std=gnu99 -O2 -DARM_NONE_EABI_GCC -I../simple -I../../../api
+ *      -I../driver -I../io -o rtbench rtbench.c ../driver/rpi.c
+ *      ../driver/ldvq.c ../driver/ldvlog.c ../io/gpio.c ../io/serial.c
+ *      -lpthread -lutil
+ *
+ * License:
+ * Use of the source code contained in this file is subject to the terms
+ * of the Echelon Example Software License Agreement which is available at
+ * www.echelon.com/license/examplesoftware/.
+ */
+#include <poll.h>
+#include <pthread.h>
+#include <pty.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ShortStackDev.h"
+#include "ShortStackApi.h"
+#include "ldv.h"
+#include "io.h"
+
+/*
+ * The mock pins used for the driver's handshake. The handshake signals
+ * are active low.
+ */
+#define PIN_RTS     10
+#define PIN_CTS     9
+
+#define MAX_LOADS   64
+
+static volatile int loading;
+
+static uint64_t Now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+/*
+ * Trace() prints the driver's reports, such as a failure to apply a
+ * real-time option.
+ */
+static int Trace(const char* fmt, ...)
+{
+    va_list args;
+    int result;
+
+    va_start(args, fmt);
+    printf("  driver: ");
+    result = vprintf(fmt, args);
+    va_end(args);
+
+    return result;
+}
+
+static void* LoadThread(void* arg)
+{
+    volatile unsigned long spins = 0;
+
+    (void) arg;
+
+    while (loading) {
+        ++spins;
+    }
+
+    return NULL;
+}
+
+/*
+ * Peer describes the Micro Server thread and its results.
+ */
+typedef struct {
+    int master;
+    unsigned count;
+    volatile unsigned done;
+    volatile int stop;
+    uint32_t* samples;
+} Peer;
+
+/*
+ * AwaitRts() waits until RTS has the given level, or the peer is stopped.
+ * The thread sleeps between polls, because with SCHED_FIFO, yielding would
+ * not let the driver's thread run.
+ */
+static void AwaitRts(Peer* peer, int level)
+{
+    while (GpioMockGet(PIN_RTS) != level && !peer->stop) {
+        usleep(20);
+    }
+}
+
+static void* PeerThread(void* arg)
+{
+    Peer* peer = (Peer*) arg;
+    struct sched_param parameters = { 99 };
+    struct pollfd entry = { peer->master, POLLIN, 0 };
+    uint8_t data[64];
+
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+
+    while (peer->done < peer->count && !peer->stop) {
+        uint64_t asserted = 0;
+
+        AwaitRts(peer, 0);
+
+        if (!peer->stop) {
+            asserted = Now();
+            GpioMockSet(PIN_CTS, 0);
+
+            if (poll(&entry, 1, 1000) == 1 && read(peer->master, data, sizeof(data)) > 0) {
+                peer->samples[peer->done] = (uint32_t) ((Now() - asserted) / 1000u);
+                __atomic_store_n(&peer->done, peer->done + 1, __ATOMIC_RELEASE);
+            }
+
+            AwaitRts(peer, 1);
+            GpioMockSet(PIN_CTS, 1);
+        }
+    }
+
+    return NULL;
+}
+
+static int Ascending(const void* a, const void* b)
+{
+    const uint32_t x = *(const uint32_t*) a;
+    const uint32_t y = *(const uint32_t*) b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Run() opens the driver with the given thread settings, sends 'count'
+ * single-segment frames one at a time, and prints the latency
+ * distribution.
+ */
+static void Run(const char* name, unsigned count, int priority, unsigned long cpus, int lock)
+{
+    Peer peer;
+    pthread_t thread;
+    struct termios tio;
+    char device[64];
+    int slave = -1;
+    LdvCtrl ctrl;
+    LdvHandle handle = 0;
+
+    printf("%s:\n", name);
+    memset(&peer, 0, sizeof(peer));
+    peer.count = count;
+    peer.samples = calloc(count, sizeof(uint32_t));
+
+    if (peer.samples == NULL || openpty(&peer.master, &slave, device, NULL, NULL) == -1) {
+        perror("rtbench");
+        free(peer.samples);
+        return;
+    }
+
+    tcgetattr(peer.master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(peer.master, TCSANOW, &tio);
+
+    memset(&ctrl, 0, sizeof(ctrl));
+    ctrl.device = device;
+    ctrl.bitrate = LDVCTRL_DEFAULT_BITRATE;
+    ctrl.gpio.rts = PIN_RTS;
+    ctrl.gpio.cts = PIN_CTS;
+    ctrl.gpio.backend = LdvGpioMock;
+    ctrl.trace = Trace;
+    ctrl.frameLog.records = 64;     /* keep frames out of the trace */
+    ctrl.thread.priority = priority;
+    ctrl.thread.cpus = cpus;
+    ctrl.thread.lock = lock;
+
+    if (LdvOpen(&ctrl, &handle) != LonApiNoError) {
+        printf("  can't open the driver\n");
+    } else {
+        pthread_create(&thread, NULL, PeerThread, &peer);
+
+        for (unsigned i = 0; i < count; ++i) {
+            LonSmipMsg* frame = NULL;
+            const uint64_t deadline = Now() + 2000000000u;
+
+            if (LdvAllocateMsgWait(handle, &frame) != LonApiNoError) {
+                break;
+            }
+
+            frame->Header.Length = 0;
+            frame->Header.Command = 0x12;
+            LdvPutMsg(handle, frame);
+
+            while (__atomic_load_n(&peer.done, __ATOMIC_ACQUIRE) <= i && Now() < deadline) {
+                usleep(100);
+            }
+        }
+
+        peer.stop = 1;
+        pthread_join(thread, NULL);
+        LdvClose(handle);
+
+        if (peer.done) {
+            qsort(peer.samples, peer.done, sizeof(uint32_t), Ascending);
+            printf(
+                "  %u segments, latency (us): min %u, median %u, 99%% %u, 99.9%% %u, max %u\n",
+                peer.done, peer.samples[0], peer.samples[peer.done / 2],
+                peer.samples[peer.done - 1 - peer.done / 100],
+                peer.samples[peer.done - 1 - peer.done / 1000],
+                peer.samples[peer.done - 1]
+            );
+        }
+
+        if (peer.done < count) {
+            printf("  only %u of %u segments completed\n", peer.done, count);
+        }
+    }
+
+    close(slave);
+    close(peer.master);
+    free(peer.samples);
+}
+
+int main(int argc, char* argv[])
+{
+    pthread_t loads[MAX_LOADS];
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned count = 10000;
+    int priority = 80;
+    unsigned long mask = 0;
+    int threads = cpus > 0 ? (int) cpus : 1;
+    int option;
+
+    while ((option = getopt(argc, argv, "l:n:p:c:")) != -1) {
+        if (option == 'l') {
+            threads = atoi(optarg);
+        } else if (option == 'n') {
+            count = (unsigned) strtoul(optarg, NULL, 0);
+        } else if (option == 'p') {
+            priority = atoi(optarg);
+        } else if (option == 'c') {
+            mask = strtoul(optarg, NULL, 0);
+        } else {
+            fprintf(
+                stderr, "Usage: %s [-l loads] [-n segments] [-p priority] [-c cpumask]\n",
+                argv[0]
+            );
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (threads > MAX_LOADS) {
+        threads = MAX_LOADS;
+    }
+
+    if (!count) {
+        count = 1;
+    }
+
+    loading = 1;
+
+    for (int i = 0; i < threads; ++i) {
+        pthread_create(&loads[i], NULL, LoadThread, NULL);
+    }
+
+    printf("%d load threads\n", threads);
+    Run("default", count, 0, 0, 0);
+    Run("realtime", count, priority, mask, 1);
+
+    loading = 0;
+
+    for (int i = 0; i < threads; ++i) {
+        pthread_join(loads[i], NULL);
+    }
+
+    return EXIT_SUCCESS;
+}
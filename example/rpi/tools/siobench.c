@@ -0,0 +1,314 @@
+/*
+ * IzoT ShortStack for Raspberry Pi SIO Benchmark
+ *
+ * siobench measures the CPU time the driver's serial I/O (SIO) thread
+ * spends per event, over a pseudo-terminal. No Micro Server and no GPIO
+ * hardware is required.
+ *
+ * The first measurement compares the two ways of waiting for an event
+ * with the descriptors the SIO thread watches: a serial port, a control
+ * pipe and a CTS edge descriptor. The "select" loop locks and unlocks the
+ * suspend mutex, rebuilds three fd_sets and calls select() for every event,
+ * as the SIO thread did before it used epoll. The "epoll" loop waits with
+ * epoll_wait() on an interest set registered once. Each loop reads one
+ * byte per event, and the CPU time of the waiting thread is reported per
+ * event, in nanoseconds.
+ *
+ * The second measurement runs the driver itself, with mock GPIO pins, and
+ * passes uplink frames from the pseudo-terminal to the application one at
+ * a time. It reports the CPU time of the SIO thread per frame: the process
+ * CPU time less that of the two benchmark threads. The driver runs once
+ * with default settings, and once with LdvCtrl.latency.lowLatency.
+ *
+ * Build with the driver and the io utilities, for example:
+ *  gcc -std=gnu99 -O2 -DARM_NONE_EABI_GCC -DLON_DRIVER_STATISTICS=1
+ *      -DLON_DRIVER_EVENTS=1 -I../simple -I../../../api -I../driver -I../io
+ *      -o siobench siobench.c ../driver/rpi.c ../driver/ldvq.c
+ *      ../driver/ldvlog.c ../io/gpio.c ../io/serial.c -lpthread -lutil
+ *
+ * License:
+ * Use of the source code contained in this file is subject to the terms
+ * of the Echelon Example Software License Agreement which is available at
+ * www.echelon.com/license/examplesoftware/.
+ */
+#include <pthread.h>
+#include <pty.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/select.h>
+
+#include "ShortStackDev.h"
+#include "ShortStackApi.h"
+#include "ldv.h"
+
+#define EVENTS      100000      /* events per wait loop */
+#define FRAMES      20000       /* uplink frames per driver run */
+
+/*
+ * The mock pins used by the driver.
+ */
+#define PIN_RTS     10
+#define PIN_CTS     9
+
+static uint64_t Clock(clockid_t clock)
+{
+    struct timespec now;
+
+    clock_gettime(clock, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+/*
+ * Feeder describes the thread which plays the Micro Server: it writes one
+ * unit of data to the pseudo-terminal master, and waits until the other
+ * side has counted it as 'taken' before it writes the next, or 'stop' is
+ * set. 'cpu' reports the feeder's own CPU time.
+ */
+typedef struct {
+    int master;
+    const void* data;
+    size_t size;
+    unsigned count;
+    volatile unsigned taken;
+    volatile int stop;
+    uint64_t cpu;
+} Feeder;
+
+static void* FeederThread(void* arg)
+{
+    Feeder* feeder = (Feeder*) arg;
+
+    for (unsigned i = 0; i < feeder->count && !feeder->stop; ++i) {
+        if (write(feeder->master, feeder->data, feeder->size) != (ssize_t) feeder->size) {
+            break;
+        }
+
+        while (__atomic_load_n(&feeder->taken, __ATOMIC_ACQUIRE) <= i && !feeder->stop) {
+            sched_yield();
+        }
+    }
+
+    feeder->cpu = Clock(CLOCK_THREAD_CPUTIME_ID);
+    return NULL;
+}
+
+static int Max(int a, int b)
+{
+    return a > b ? a : b;
+}
+
+/*
+ * Descriptors is the set of descriptors watched by both wait loops.
+ */
+typedef struct {
+    int sio;
+    int control[2];
+    int cts;
+    pthread_mutex_t mutex;
+} Descriptors;
+
+static void SelectLoop(Descriptors* fds, Feeder* feeder)
+{
+    const int nfds = Max(Max(fds->sio, fds->control[0]), fds->cts);
+    fd_set read_fds, write_fds, interrupt_fds;
+    struct timeval timeout;
+    uint8_t data;
+
+    while (feeder->taken < feeder->count) {
+        pthread_mutex_lock(&fds->mutex);
+        pthread_mutex_unlock(&fds->mutex);
+
+        FD_ZERO(&read_fds);
+        FD_ZERO(&write_fds);
+        FD_ZERO(&interrupt_fds);
+        FD_SET(fds->sio, &read_fds);
+        FD_SET(fds->control[0], &read_fds);
+        FD_SET(fds->cts, &interrupt_fds);
+        timeout.tv_sec = 0;
+        timeout.tv_usec = 10000;
+
+        if (select(nfds + 1, &read_fds, &write_fds, &interrupt_fds, &timeout) > 0) {
+            if (FD_ISSET(fds->sio, &read_fds) && read(fds->sio, &data, 1) == 1) {
+                __atomic_store_n(&feeder->taken, feeder->taken + 1, __ATOMIC_RELEASE);
+            }
+        }
+    }
+}
+
+static void EpollLoop(Descriptors* fds, Feeder* feeder)
+{
+    const int epoll = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event events[3];
+    uint8_t data;
+
+    events[0].events = EPOLLIN;
+    events[0].data.fd = fds->sio;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, fds->sio, &events[0]);
+    events[0].events = EPOLLIN;
+    events[0].data.fd = fds->control[0];
+    epoll_ctl(epoll, EPOLL_CTL_ADD, fds->control[0], &events[0]);
+    events[0].events = EPOLLPRI;
+    events[0].data.fd = fds->cts;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, fds->cts, &events[0]);
+
+    while (feeder->taken < feeder->count) {
+        const int ready = epoll_wait(epoll, events, 3, 10);
+
+        for (int i = 0; i < ready; ++i) {
+            if (events[i].data.fd == fds->sio && read(fds->sio, &data, 1) == 1) {
+                __atomic_store_n(&feeder->taken, feeder->taken + 1, __ATOMIC_RELEASE);
+            }
+        }
+    }
+
+    close(epoll);
+}
+
+/*
+ * Wait() runs one wait loop against a feeder, and prints the loop's CPU
+ * time per event.
+ */
+static void Wait(const char* name, void (*loop)(Descriptors*, Feeder*))
+{
+    static const uint8_t byte = 0x55;
+    Descriptors fds;
+    Feeder feeder;
+    pthread_t thread;
+    struct termios tio;
+    uint64_t cpu = 0;
+    uint64_t wall = 0;
+
+    memset(&feeder, 0, sizeof(feeder));
+    feeder.data = &byte;
+    feeder.size = 1;
+    feeder.count = EVENTS;
+
+    if (openpty(&feeder.master, &fds.sio, NULL, NULL, NULL) == -1 || pipe(fds.control) == -1) {
+        perror("siobench");
+        return;
+    }
+
+    tcgetattr(fds.sio, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(fds.sio, TCSANOW, &tio);
+    fds.cts = eventfd(0, EFD_NONBLOCK);
+    pthread_mutex_init(&fds.mutex, NULL);
+
+    pthread_create(&thread, NULL, FeederThread, &feeder);
+    cpu = Clock(CLOCK_THREAD_CPUTIME_ID);
+    wall = Clock(CLOCK_MONOTONIC);
+    loop(&fds, &feeder);
+    cpu = Clock(CLOCK_THREAD_CPUTIME_ID) - cpu;
+    wall = Clock(CLOCK_MONOTONIC) - wall;
+    pthread_join(thread, NULL);
+
+    printf(
+        "%-10s %8llu ns CPU per event, %8llu ns per event\n", name,
+        (unsigned long long) (cpu / EVENTS), (unsigned long long) (wall / EVENTS)
+    );
+
+    pthread_mutex_destroy(&fds.mutex);
+    close(fds.cts);
+    close(fds.control[0]);
+    close(fds.control[1]);
+    close(fds.sio);
+    close(feeder.master);
+}
+
+/*
+ * Drive() runs the driver against a feeder, and prints the SIO thread's
+ * CPU time per uplink frame.
+ */
+static void Drive(const char* name, int lowLatency)
+{
+    static const uint8_t frame[] = { 4, 0x50, 1, 2, 3, 4 };
+    Feeder feeder;
+    pthread_t thread;
+    struct termios tio;
+    char device[64];
+    int slave = -1;
+    LdvCtrl ctrl;
+    LdvHandle handle = 0;
+    uint64_t process = 0;
+    uint64_t self = 0;
+
+    memset(&feeder, 0, sizeof(feeder));
+    feeder.data = frame;
+    feeder.size = sizeof(frame);
+    feeder.count = FRAMES;
+
+    if (openpty(&feeder.master, &slave, device, NULL, NULL) == -1) {
+        perror("siobench");
+        return;
+    }
+
+    tcgetattr(feeder.master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(feeder.master, TCSANOW, &tio);
+
+    memset(&ctrl, 0, sizeof(ctrl));
+    ctrl.device = device;
+    ctrl.bitrate = LDVCTRL_DEFAULT_BITRATE;
+    ctrl.gpio.rts = PIN_RTS;
+    ctrl.gpio.cts = PIN_CTS;
+    ctrl.gpio.backend = LdvGpioMock;
+    ctrl.latency.lowLatency = lowLatency;
+
+    if (LdvOpen(&ctrl, &handle) != LonApiNoError) {
+        printf("%-10s can't open the driver\n", name);
+    } else {
+        process = Clock(CLOCK_PROCESS_CPUTIME_ID);
+        self = Clock(CLOCK_THREAD_CPUTIME_ID);
+        pthread_create(&thread, NULL, FeederThread, &feeder);
+
+        while (feeder.taken < FRAMES) {
+            LonSmipMsg* message = NULL;
+
+            if (LdvWaitForEvent(handle, 1000) != LonApiNoError) {
+                break;
+            }
+
+            while (LdvGetMsg(handle, &message) == LonApiNoError) {
+                LdvReleaseMsg(handle, message);
+                __atomic_store_n(&feeder.taken, feeder.taken + 1, __ATOMIC_RELEASE);
+            }
+        }
+
+        self = Clock(CLOCK_THREAD_CPUTIME_ID) - self;
+        feeder.stop = 1;
+        pthread_join(thread, NULL);
+        process = Clock(CLOCK_PROCESS_CPUTIME_ID) - process;
+
+        if (feeder.taken < FRAMES) {
+            printf("%-10s stalled after %u frames\n", name, feeder.taken);
+        } else {
+            printf(
+                "%-10s %8llu ns SIO thread CPU per frame\n", name,
+                (unsigned long long) ((process - self - feeder.cpu) / FRAMES)
+            );
+        }
+
+        LdvClose(handle);
+    }
+
+    close(slave);
+    close(feeder.master);
+}
+
+int main(void)
+{
+    Wait("select", SelectLoop);
+    Wait("epoll", EpollLoop);
+
+    Drive("driver", 0);
+    Drive("lowlatency", 1);
+
+    return EXIT_SUCCESS;
+}
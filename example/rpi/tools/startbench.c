@@ -0,0 +1,191 @@
+/*
+ * IzoT ShortStack for Raspberry Pi Start-up Benchmark
+ *
+ * startbench measures the driver's cold-start time, as reported by
+ * LdvStatistics.startup. It uses mock GPIO pins and a pseudo-terminal, so
+ * that no Micro Server and no GPIO hardware is required.
+ *
+ * Each run opens the driver on a new pseudo-terminal, then plays the part
+ * of the Micro Server and writes a reset notification, the first uplink
+ * frame a Micro Server sends. Once the driver has received the frame, the
+ * run reads the driver's statistics and closes the driver. The 'open'
+ * time is the time spent in LdvOpen(); the 'ready' time runs from the call
+ * to LdvOpen() until the reset notification was received, and so includes
+ * the time the driver takes to receive its first frame.
+ *
+ * For each time, startbench prints the minimum, median and maximum over
+ * all runs in microseconds.
+ *
+ * Options:
+ * -n n   number of runs, default 100
+ *
+ * Build with the driver and the io utilities, for example:
+ *  gcc -std=gnu99 -O2 -DARM_NONE_EABI_GCC -DLON_DRIVER_STATISTICS=1
+ *      -I../simple -I../../../api -I../driver -I../io -o startbench
+ *      startbench.c ../driver/rpi.c ../driver/ldvq.c ../driver/ldvlog.c
+ *      ../io/gpio.c ../io/serial.c -lpthread -lutil
+ *
+ * License:
+ * Use of the source code contained in this file is subject to the terms
+ * of the Echelon Example Software License Agreement which is available at
+ * www.echelon.com/license/examplesoftware/.
+ */
+#include <pty.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ShortStackDev.h"
+#include "ShortStackApi.h"
+#include "ldv.h"
+
+/*
+ * The mock pins used by the driver.
+ */
+#define PIN_RTS     10
+#define PIN_CTS     9
+
+#define TIMEOUT     1000000     /* us to wait for the reset notification */
+
+static uint64_t Now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000u + (uint64_t) now.tv_nsec / 1000u;
+}
+
+static int Ascending(const void* a, const void* b)
+{
+    const unsigned long x = *(const unsigned long*) a;
+    const unsigned long y = *(const unsigned long*) b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Run() opens the driver, sends a reset notification, and reports the
+ * driver's start-up times in 'opened' and 'ready'. It returns zero on
+ * success.
+ */
+static int Run(unsigned long* opened, unsigned long* ready)
+{
+    const uint8_t reset[2] = { 0, LonNiReset };
+    struct termios tio;
+    char name[64];
+    int master = -1;
+    int slave = -1;
+    int result = -1;
+    LdvCtrl ctrl;
+    LdvHandle handle = 0;
+    LdvStatistics statistics;
+
+    if (openpty(&master, &slave, name, NULL, NULL) == -1) {
+        perror("startbench");
+        return result;
+    }
+
+    tcgetattr(master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(master, TCSANOW, &tio);
+
+    memset(&ctrl, 0, sizeof(ctrl));
+    ctrl.device = name;
+    ctrl.bitrate = LDVCTRL_DEFAULT_BITRATE;
+    ctrl.gpio.rts = PIN_RTS;
+    ctrl.gpio.cts = PIN_CTS;
+    ctrl.gpio.backend = LdvGpioMock;
+
+    if (LdvOpen(&ctrl, &handle) != LonApiNoError) {
+        printf("can't open the driver\n");
+    } else {
+        const uint64_t deadline = Now() + TIMEOUT;
+        LonSmipMsg* frame = NULL;
+
+        if (write(master, reset, sizeof(reset)) == (ssize_t) sizeof(reset)) {
+            while (LdvGetMsg(handle, &frame) != LonApiNoError && Now() < deadline) {
+                usleep(10);
+            }
+        }
+
+        LdvGetStatistics(handle, &statistics);
+
+        if (frame) {
+            LdvReleaseMsg(handle, frame);
+            *opened = statistics.startup.open;
+            *ready = statistics.startup.ready;
+            result = 0;
+        } else {
+            printf("no reset notification received\n");
+        }
+
+        LdvClose(handle);
+    }
+
+    close(slave);
+    close(master);
+
+    return result;
+}
+
+static void Report(const char* name, unsigned long* samples, unsigned count)
+{
+    qsort(samples, count, sizeof(unsigned long), Ascending);
+    printf(
+        "%-5s (us): min %lu, median %lu, max %lu\n", name,
+        samples[0], samples[count / 2], samples[count - 1]
+    );
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned count = 100;
+    unsigned done = 0;
+    unsigned long* opened = NULL;
+    unsigned long* ready = NULL;
+    int option;
+
+    while ((option = getopt(argc, argv, "n:")) != -1) {
+        if (option == 'n') {
+            count = (unsigned) strtoul(optarg, NULL, 0);
+        } else {
+            fprintf(stderr, "Usage: %s [-n runs]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!count) {
+        count = 1;
+    }
+
+    opened = calloc(count, sizeof(unsigned long));
+    ready = calloc(count, sizeof(unsigned long));
+
+    if (opened == NULL || ready == NULL) {
+        perror("startbench");
+        free(opened);
+        free(ready);
+        return EXIT_FAILURE;
+    }
+
+    for (unsigned i = 0; i < count; ++i) {
+        if (Run(&opened[done], &ready[done]) == 0) {
+            done += 1;
+        }
+    }
+
+    printf("%u of %u runs completed\n", done, count);
+
+    if (done) {
+        Report("open", opened, done);
+        Report("ready", ready, done);
+    }
+
+    free(opened);
+    free(ready);
+
+    return done == count ? EXIT_SUCCESS : EXIT_FAILURE;
+}